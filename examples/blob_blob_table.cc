@@ -6,24 +6,9 @@ extern "C" {
 #include "blob_blob_table.h"
 }
 
-// The hashtable uses the generic std::hash template wrapper as the hash
-// function and std::equal_to as the equality function for key hashing and
-// comparison. Since neither of these templates are specialized for our custom
-// key_blob type, we must create our own specializations.
-
-#include <cstring>
-#include <functional>
-
-namespace std {
-template <> struct hash<key_blob> {
-  size_t operator()(const key_blob &kb) const { return *(size_t *)kb.blob; }
-};
-
-template <> struct equal_to<key_blob> {
-  bool operator()(const key_blob &lhs, const key_blob &rhs) const {
-    return memcmp(lhs.blob, rhs.blob, sizeof(lhs.blob)) == 0;
-  }
-};
-}
+// std::hash and std::equal_to aren't specialized for our custom key_blob
+// type, so the table hashes and compares key_blobs as raw bytes. To use other
+// functions instead, define CUCKOO_HASH_FN and CUCKOO_EQ_FN in
+// `blob_blob_table.h`.
 
 #include <libcuckoo-c/cuckoo_table_template.cc>
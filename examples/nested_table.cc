@@ -1,6 +1,8 @@
 /* We demonstrate how to nest hash tables within one another, to store
  * unstructured data, kind of like JSON. There's still the limitation that it's
- * statically typed. */
+ * statically typed. Each inner table only holds a few properties, so we create
+ * them with SMALL_TABLE_SIZE rather than the default size, which reserves
+ * space for hundreds of thousands of elements. */
 
 #include <iostream>
 #include <memory>
@@ -15,14 +17,16 @@ typedef libcuckoo::cuckoohash_map<std::string, std::unique_ptr<InnerTable>> Oute
 int main() {
   OuterTable tbl;
 
-  tbl.insert("bob", std::unique_ptr<InnerTable>(new InnerTable));
+  tbl.insert("bob", std::unique_ptr<InnerTable>(
+                     new InnerTable(libcuckoo::SMALL_TABLE_SIZE)));
   tbl.update_fn("bob", [](std::unique_ptr<InnerTable> &innerTbl) {
     innerTbl->insert("nickname", "jimmy");
     innerTbl->insert("pet", "dog");
     innerTbl->insert("food", "bagels");
   });
 
-  tbl.insert("jack", std::unique_ptr<InnerTable>(new InnerTable));
+  tbl.insert("jack", std::unique_ptr<InnerTable>(
+                     new InnerTable(libcuckoo::SMALL_TABLE_SIZE)));
   tbl.update_fn("jack", [](std::unique_ptr<InnerTable> &innerTbl) {
     innerTbl->insert("friend", "bob");
     innerTbl->insert("activity", "sleeping");
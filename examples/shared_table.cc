@@ -0,0 +1,89 @@
+/* An example of sharing one table between several processes. The first
+ * process to run creates a shared memory region, builds the table in it, and
+ * exits, leaving the table in place. Each later run opens the region and
+ * looks keys up in the table without loading it again, in several worker
+ * processes at once. Run it with "remove" to delete the region. */
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <libcuckoo/cuckoohash_map.hh>
+#include <libcuckoo/cuckoohash_shared.hh>
+
+typedef libcuckoo::cuckoohash_map<
+    uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+    libcuckoo::shared_allocator<std::pair<const uint64_t, uint64_t>>>
+    Table;
+
+const char *region_name = "/libcuckoo_shared_table_example";
+const size_t region_size = size_t(1) << 30;
+const uint64_t num_keys = 1000000;
+const int num_workers = 4;
+
+void build(libcuckoo::shared_region &region) {
+  Table *table = region.construct<Table>(num_keys, Table::hasher(),
+                                         Table::key_equal(),
+                                         Table::allocator_type(region));
+  for (uint64_t i = 0; i < num_keys; i++) {
+    table->insert(i, i * i);
+  }
+  std::cout << "built a table of " << table->size() << " keys, using "
+            << region.allocated() << " bytes of the region" << std::endl;
+}
+
+// Each worker looks up its share of the keys
+int work(const Table &table, int worker) {
+  uint64_t found = 0;
+  for (uint64_t i = worker; i < num_keys; i += num_workers) {
+    uint64_t value;
+    if (table.find(i, value) && value == i * i) {
+      found++;
+    }
+  }
+  std::cout << "worker " << worker << " found " << found << " keys"
+            << std::endl;
+  return found == (num_keys - worker + num_workers - 1) / num_workers ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && std::string(argv[1]) == "remove") {
+    libcuckoo::shared_region::remove(region_name);
+    return 0;
+  }
+  try {
+    try {
+      libcuckoo::shared_region region =
+          libcuckoo::shared_region::create(region_name, region_size);
+      build(region);
+      std::cout << "run again to look keys up in it" << std::endl;
+      return 0;
+    } catch (const std::system_error &e) {
+      if (e.code() != std::errc::file_exists) {
+        throw;
+      }
+    }
+    libcuckoo::shared_region region =
+        libcuckoo::shared_region::open(region_name);
+    const Table *table = region.root<Table>();
+    for (int worker = 0; worker < num_workers; worker++) {
+      if (fork() == 0) {
+        _exit(work(*table, worker));
+      }
+    }
+    int failures = 0;
+    for (int worker = 0; worker < num_workers; worker++) {
+      int status;
+      wait(&status);
+      failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    return failures == 0 ? 0 : 1;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -7,23 +7,212 @@
 //
 // Then include this template file
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <libcuckoo/cuckoohash_map.hh>
 
+// Shared by every table instantiated in the same translation unit
+#ifndef LIBCUCKOO_C_DEFAULT_HASH
+#define LIBCUCKOO_C_DEFAULT_HASH
+namespace libcuckoo_c {
+
+// True if std::hash has been specialized for Key, which it is for all scalar
+// types. Unspecialized std::hash can't be constructed.
+template <class Key>
+using has_std_hash = std::is_default_constructible<std::hash<Key>>;
+
+template <class Key> struct bytes_hasher {
+  size_t operator()(const Key &key) const {
+    return libcuckoo::bytes_hash(&key, sizeof(Key));
+  }
+};
+
+template <class Key> struct bytes_equal {
+  bool operator()(const Key &lhs, const Key &rhs) const {
+    return std::memcmp(&lhs, &rhs, sizeof(Key)) == 0;
+  }
+};
+
+// Keys use std::hash and std::equal_to if std::hash supports them, and
+// otherwise are hashed and compared as raw bytes
+template <class Key>
+using default_hash = typename std::conditional<has_std_hash<Key>::value,
+                                               std::hash<Key>,
+                                               bytes_hasher<Key>>::type;
+
+template <class Key>
+using default_equal = typename std::conditional<has_std_hash<Key>::value,
+                                                std::equal_to<Key>,
+                                                bytes_equal<Key>>::type;
+
+// Returns the errno value that reports the exception being handled
+inline int current_exception_errno() {
+  try {
+    throw;
+  } catch (std::bad_alloc &) {
+    return ENOMEM;
+  } catch (std::length_error &) {
+    return ENOMEM;
+  } catch (std::system_error &e) {
+    return e.code().default_error_condition().value();
+  } catch (...) {
+    return ECANCELED;
+  }
+}
+
+// A set of threads that split the records of each block they're given
+// between them, and wait for the next block once they're done. They're
+// started once and reused for every block of a file.
+class block_workers {
+public:
+  // Called with a block, and the range of its records a thread should handle.
+  // It must not throw.
+  using block_fn = std::function<void(const char *, size_t, size_t)>;
+
+  // Starts `num_threads` threads. If one can't be started, stops the ones
+  // that were and throws std::system_error.
+  block_workers(size_t num_threads, block_fn fn) : fn_(std::move(fn)) {
+    try {
+      threads_.reserve(num_threads);
+      for (size_t i = 0; i < num_threads; ++i) {
+        threads_.emplace_back(&block_workers::run, this, i, num_threads);
+      }
+    } catch (...) {
+      stop();
+      throw;
+    }
+  }
+
+  ~block_workers() { stop(); }
+
+  // Hands the `count` records of `block` to the threads
+  void start(const char *block, size_t count) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    block_ = block;
+    count_ = count;
+    busy_ = threads_.size();
+    ++generation_;
+    work_cv_.notify_all();
+  }
+
+  // Waits until the threads are done with the block from start
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return busy_ == 0; });
+  }
+
+private:
+  void run(size_t index, size_t num_threads) {
+    size_t seen = 0;
+    for (;;) {
+      const char *block;
+      size_t count;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cv_.wait(lock,
+                      [&]() { return stopping_ || generation_ != seen; });
+        if (stopping_) {
+          return;
+        }
+        seen = generation_;
+        block = block_;
+        count = count_;
+      }
+      fn_(block, count * index / num_threads,
+          count * (index + 1) / num_threads);
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (--busy_ == 0) {
+        done_cv_.notify_one();
+      }
+    }
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      stopping_ = true;
+    }
+    work_cv_.notify_all();
+    for (std::thread &thread : threads_) {
+      thread.join();
+    }
+    threads_.clear();
+  }
+
+  block_fn fn_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  const char *block_ = nullptr;
+  size_t count_ = 0;
+  size_t busy_ = 0;
+  size_t generation_ = 0;
+  bool stopping_ = false;
+};
+
+} // namespace libcuckoo_c
+#endif // LIBCUCKOO_C_DEFAULT_HASH
+
 // Helper macros, we take care of undefining these
 #define PASTE2(a, b) a##b
 #define PASTE(a, b) PASTE2(a, b)
 #define CUCKOO(a) PASTE(CUCKOO_TABLE_NAME, a)
 
+// The number of bytes _read and _write transfer to or from the file at a
+// time. This can be defined before including this file to override it.
+#ifndef CUCKOO_IO_BLOCK_BYTES
+#define CUCKOO_IO_BLOCK_BYTES (size_t(8) << 20)
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef libcuckoo::cuckoohash_map<CUCKOO_KEY_TYPE, CUCKOO_MAPPED_TYPE> tbl_t;
+// The hash and equality functions named by CUCKOO_HASH_FN and CUCKOO_EQ_FN
+// are called directly, so they can be inlined if they're defined in the
+// interface header
+#ifdef CUCKOO_HASH_FN
+struct CUCKOO(_hasher) {
+  size_t operator()(const CUCKOO_KEY_TYPE &key) const {
+    return CUCKOO_HASH_FN(&key);
+  }
+};
+#define CUCKOO_HASHER CUCKOO(_hasher)
+#else
+#define CUCKOO_HASHER libcuckoo_c::default_hash<CUCKOO_KEY_TYPE>
+#endif
+
+#ifdef CUCKOO_EQ_FN
+struct CUCKOO(_key_equal) {
+  bool operator()(const CUCKOO_KEY_TYPE &lhs,
+                  const CUCKOO_KEY_TYPE &rhs) const {
+    return CUCKOO_EQ_FN(&lhs, &rhs);
+  }
+};
+#define CUCKOO_KEY_EQUAL CUCKOO(_key_equal)
+#else
+#define CUCKOO_KEY_EQUAL libcuckoo_c::default_equal<CUCKOO_KEY_TYPE>
+#endif
+
+typedef libcuckoo::cuckoohash_map<CUCKOO_KEY_TYPE, CUCKOO_MAPPED_TYPE,
+                                  CUCKOO_HASHER, CUCKOO_KEY_EQUAL>
+    tbl_t;
 
 struct CUCKOO_TABLE_NAME {
   tbl_t t;
@@ -50,35 +239,96 @@ CUCKOO_TABLE_NAME *CUCKOO(_init)(size_t n) {
 }
 
 CUCKOO_TABLE_NAME *CUCKOO(_read)(FILE *fp) {
+  return CUCKOO(_read_parallel)(fp, 0);
+}
+
+CUCKOO_TABLE_NAME *CUCKOO(_read_parallel)(FILE *fp, size_t num_threads) {
   size_t tbl_size;
   if (!fread(&tbl_size, sizeof(size_t), 1, fp)) {
     return NULL;
   }
+  if (num_threads == 0) {
+    num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+  const size_t record_size =
+      sizeof(CUCKOO_KEY_ALIAS) + sizeof(CUCKOO_MAPPED_ALIAS);
+  const size_t block_records =
+      std::max<size_t>(CUCKOO_IO_BLOCK_BYTES / record_size, 1);
   CUCKOO_TABLE_NAME *tbl = NULL;
+  // The errno value of the first failure, or 0
+  std::atomic<int> error(0);
+  // Inserts records [begin, end) of `block`. The records aren't necessarily
+  // aligned, so they're copied out before inserting.
+  auto insert_records = [&tbl, record_size, &error](const char *block,
+                                                    size_t begin, size_t end) {
+    CUCKOO_KEY_ALIAS key;
+    CUCKOO_MAPPED_ALIAS mapped;
+    try {
+      for (size_t i = begin; i < end; ++i) {
+        const char *record = block + i * record_size;
+        std::memcpy(&key, record, sizeof(CUCKOO_KEY_ALIAS));
+        std::memcpy(&mapped, record + sizeof(CUCKOO_KEY_ALIAS),
+                    sizeof(CUCKOO_MAPPED_ALIAS));
+        tbl->t.insert(key, mapped);
+      }
+    } catch (...) {
+      int none = 0;
+      error.compare_exchange_strong(none,
+                                    libcuckoo_c::current_exception_errno());
+    }
+  };
+
+  bool read_failed = false;
   try {
     tbl = new CUCKOO_TABLE_NAME(tbl_size);
-  } catch (std::bad_alloc &) {
-    errno = ENOMEM;
-    return NULL;
-  }
-  CUCKOO_KEY_ALIAS key;
-  CUCKOO_MAPPED_ALIAS mapped;
-  for (size_t i = 0; i < tbl_size; ++i) {
-    if (!fread(&key, sizeof(CUCKOO_KEY_ALIAS), 1, fp)) {
-      delete tbl;
-      return NULL;
+    // While the records in one block are inserted, the next block is read
+    // into the other
+    std::vector<char> blocks[2];
+    const size_t block_size = std::min(tbl_size, block_records) * record_size;
+    blocks[0].resize(block_size);
+    blocks[1].resize(block_size);
+    // A table that fits in one block isn't worth starting threads for. The
+    // workers are destroyed, and joined, before the table can be.
+    std::unique_ptr<libcuckoo_c::block_workers> workers;
+    if (num_threads > 1 && tbl_size > block_records) {
+      workers.reset(
+          new libcuckoo_c::block_workers(num_threads, insert_records));
     }
-    if (!fread(&mapped, sizeof(CUCKOO_MAPPED_ALIAS), 1, fp)) {
-      delete tbl;
-      return NULL;
-    }
-    try {
-      tbl->t.insert(key, mapped);
-    } catch (std::bad_alloc &) {
-      delete tbl;
-      errno = ENOMEM;
-      return NULL;
+
+    size_t remaining = tbl_size;
+    size_t count = std::min(remaining, block_records);
+    read_failed =
+        count > 0 && fread(blocks[0].data(), record_size, count, fp) != count;
+    size_t current = 0;
+    while (!read_failed && count > 0 && error.load() == 0) {
+      remaining -= count;
+      const size_t next_count = std::min(remaining, block_records);
+      if (workers) {
+        workers->start(blocks[current].data(), count);
+      } else {
+        insert_records(blocks[current].data(), 0, count);
+      }
+      read_failed = next_count > 0 && fread(blocks[current ^ 1].data(),
+                                            record_size, next_count,
+                                            fp) != next_count;
+      if (workers) {
+        workers->wait();
+      }
+      count = next_count;
+      current ^= 1;
     }
+  } catch (...) {
+    int none = 0;
+    error.compare_exchange_strong(none, libcuckoo_c::current_exception_errno());
+  }
+  if (error.load() != 0) {
+    delete tbl;
+    errno = error.load();
+    return NULL;
+  }
+  if (read_failed) {
+    delete tbl;
+    return NULL;
   }
   return tbl;
 }
@@ -111,6 +361,90 @@ double CUCKOO(_load_factor)(const CUCKOO_TABLE_NAME *tbl) {
   return tbl->t.load_factor();
 }
 
+// minimum_load_factor
+double CUCKOO(_minimum_load_factor)(const CUCKOO_TABLE_NAME *tbl) {
+  return tbl->t.minimum_load_factor();
+}
+
+// minimum_load_factor setter
+bool CUCKOO(_set_minimum_load_factor)(CUCKOO_TABLE_NAME *tbl, double mlf) {
+  try {
+    tbl->t.minimum_load_factor(mlf);
+  } catch (std::invalid_argument &) {
+    errno = EINVAL;
+    return false;
+  }
+  return true;
+}
+
+// maximum_hashpower
+size_t CUCKOO(_maximum_hashpower)(const CUCKOO_TABLE_NAME *tbl) {
+  return tbl->t.maximum_hashpower();
+}
+
+// maximum_hashpower setter
+bool CUCKOO(_set_maximum_hashpower)(CUCKOO_TABLE_NAME *tbl, size_t mhp) {
+  try {
+    tbl->t.maximum_hashpower(mhp);
+  } catch (std::invalid_argument &) {
+    errno = EINVAL;
+    return false;
+  }
+  return true;
+}
+
+// max_num_worker_threads
+size_t CUCKOO(_max_num_worker_threads)(const CUCKOO_TABLE_NAME *tbl) {
+  return tbl->t.max_num_worker_threads();
+}
+
+// max_num_worker_threads setter
+void CUCKOO(_set_max_num_worker_threads)(CUCKOO_TABLE_NAME *tbl,
+                                         size_t extra_threads) {
+  tbl->t.max_num_worker_threads(extra_threads);
+}
+
+#define CUCKOO_STATS CUCKOO(_stats)
+
+// get_resize_stats and get_lock_stats, along with the basic statistics
+void CUCKOO(_get_stats)(const CUCKOO_TABLE_NAME *tbl, CUCKOO_STATS *stats) {
+  stats->size = tbl->t.size();
+  stats->hashpower = tbl->t.hashpower();
+  stats->capacity = tbl->t.capacity();
+  stats->load_factor = tbl->t.load_factor();
+#if LIBCUCKOO_RESIZE_STATS
+  const tbl_t::resize_stats resize = tbl->t.get_resize_stats();
+  stats->lock_all_count = resize.lock_all_count;
+  stats->lock_all_ns = resize.lock_all_ns;
+  stats->fast_double_count = resize.fast_double_count;
+  stats->fast_double_ns = resize.fast_double_ns;
+  stats->expand_simple_count = resize.expand_simple_count;
+  stats->expand_simple_ns = resize.expand_simple_ns;
+  stats->lazy_rehash_count = resize.lazy_rehash_count;
+  stats->lazy_rehash_ns = resize.lazy_rehash_ns;
+#else
+  stats->lock_all_count = 0;
+  stats->lock_all_ns = 0;
+  stats->fast_double_count = 0;
+  stats->fast_double_ns = 0;
+  stats->expand_simple_count = 0;
+  stats->expand_simple_ns = 0;
+  stats->lazy_rehash_count = 0;
+  stats->lazy_rehash_ns = 0;
+#endif
+  const tbl_t::lock_stats locks = tbl->t.get_lock_stats();
+  stats->lock_acquisitions = locks.acquisitions;
+  stats->lock_contended = locks.contended;
+}
+
+// reset_resize_stats and reset_lock_stats
+void CUCKOO(_reset_stats)(CUCKOO_TABLE_NAME *tbl) {
+#if LIBCUCKOO_RESIZE_STATS
+  tbl->t.reset_resize_stats();
+#endif
+  tbl->t.reset_lock_stats();
+}
+
 // find_fn
 bool CUCKOO(_find_fn)(const CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
                       void (*fn)(const CUCKOO_MAPPED_ALIAS *)) {
@@ -133,6 +467,12 @@ bool CUCKOO(_upsert)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
   } catch (std::bad_alloc &) {
     errno = ENOMEM;
     return false;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+    return false;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
+    return false;
   }
 }
 
@@ -143,6 +483,51 @@ bool CUCKOO(_erase_fn)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
       *key, [&fn](CUCKOO_MAPPED_ALIAS &v) -> bool { return fn(&v); });
 }
 
+// find_fn with a context pointer
+bool CUCKOO(_find_fn_ctx)(const CUCKOO_TABLE_NAME *tbl,
+                          const CUCKOO_KEY_ALIAS *key,
+                          void (*fn)(const CUCKOO_MAPPED_ALIAS *, void *),
+                          void *ctx) {
+  return tbl->t.find_fn(
+      *key, [fn, ctx](const CUCKOO_MAPPED_ALIAS &v) { fn(&v, ctx); });
+}
+
+// update_fn with a context pointer
+bool CUCKOO(_update_fn_ctx)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
+                            void (*fn)(CUCKOO_MAPPED_ALIAS *, void *),
+                            void *ctx) {
+  return tbl->t.update_fn(*key,
+                          [fn, ctx](CUCKOO_MAPPED_ALIAS &v) { fn(&v, ctx); });
+}
+
+// upsert with a context pointer
+bool CUCKOO(_upsert_ctx)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
+                         void (*fn)(CUCKOO_MAPPED_ALIAS *, void *), void *ctx,
+                         const CUCKOO_MAPPED_ALIAS *value) {
+  try {
+    return tbl->t.upsert(
+        *key, [fn, ctx](CUCKOO_MAPPED_ALIAS &v) { fn(&v, ctx); }, *value);
+  } catch (std::bad_alloc &) {
+    errno = ENOMEM;
+    return false;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+    return false;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
+    return false;
+  }
+}
+
+// erase_fn with a context pointer
+bool CUCKOO(_erase_fn_ctx)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
+                           bool (*fn)(CUCKOO_MAPPED_ALIAS *, void *),
+                           void *ctx) {
+  return tbl->t.erase_fn(*key, [fn, ctx](CUCKOO_MAPPED_ALIAS &v) -> bool {
+    return fn(&v, ctx);
+  });
+}
+
 // find
 bool CUCKOO(_find)(const CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
                    CUCKOO_MAPPED_ALIAS *val) {
@@ -169,6 +554,12 @@ bool CUCKOO(_insert)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
   } catch (std::bad_alloc &) {
     errno = ENOMEM;
     return false;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+    return false;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
+    return false;
   }
 }
 
@@ -181,9 +572,54 @@ bool CUCKOO(_insert_or_assign)(CUCKOO_TABLE_NAME *tbl,
   } catch (std::bad_alloc &) {
     errno = ENOMEM;
     return false;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+    return false;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
+    return false;
   }
 }
 
+// find_batch
+size_t CUCKOO(_find_batch)(const CUCKOO_TABLE_NAME *tbl,
+                           const CUCKOO_KEY_ALIAS *keys, size_t n,
+                           CUCKOO_MAPPED_ALIAS *vals, bool *found) {
+  size_t num_found = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const bool key_found = tbl->t.find(keys[i], vals[i]);
+    if (found != NULL) {
+      found[i] = key_found;
+    }
+    num_found += key_found;
+  }
+  return num_found;
+}
+
+// insert_batch
+size_t CUCKOO(_insert_batch)(CUCKOO_TABLE_NAME *tbl,
+                             const CUCKOO_KEY_ALIAS *keys,
+                             const CUCKOO_MAPPED_ALIAS *vals, size_t n,
+                             bool *inserted) {
+  size_t num_inserted = 0;
+  try {
+    for (size_t i = 0; i < n; ++i) {
+      const bool key_inserted = tbl->t.insert(keys[i], vals[i]);
+      if (inserted != NULL) {
+        inserted[i] = key_inserted;
+      }
+      num_inserted += key_inserted;
+    }
+  } catch (std::bad_alloc &) {
+    errno = ENOMEM;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
+  }
+  return num_inserted;
+}
+
 // erase
 bool CUCKOO(_erase)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key) {
   return tbl->t.erase(*key);
@@ -196,6 +632,12 @@ bool CUCKOO(_rehash)(CUCKOO_TABLE_NAME *tbl, size_t n) {
   } catch (std::bad_alloc &) {
     errno = ENOMEM;
     return false;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+    return false;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
+    return false;
   }
 }
 
@@ -206,12 +648,29 @@ bool CUCKOO(_reserve)(CUCKOO_TABLE_NAME *tbl, size_t n) {
   } catch (std::bad_alloc &) {
     errno = ENOMEM;
     return false;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+    return false;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
+    return false;
   }
 }
 
 // clear
 void CUCKOO(_clear)(CUCKOO_TABLE_NAME *tbl) { tbl->t.clear(); }
 
+// for_each
+bool CUCKOO(_for_each)(CUCKOO_TABLE_NAME *tbl,
+                       void (*fn)(const CUCKOO_KEY_ALIAS *,
+                                  CUCKOO_MAPPED_ALIAS *, void *),
+                       void *ctx) {
+  return tbl->t.for_each(
+      [fn, ctx](const CUCKOO_KEY_ALIAS &k, CUCKOO_MAPPED_ALIAS &v) {
+        fn(&k, &v, ctx);
+      });
+}
+
 #define CUCKOO_LOCKED_TABLE CUCKOO(_locked_table)
 #define CUCKOO_LT(a) PASTE(CUCKOO_LOCKED_TABLE, a)
 struct CUCKOO_LOCKED_TABLE {
@@ -273,6 +732,16 @@ double CUCKOO_LT(_load_factor)(const CUCKOO_LOCKED_TABLE *ltbl) {
   return ltbl->lt.load_factor();
 }
 
+// locked_table::for_each
+void CUCKOO_LT(_for_each)(CUCKOO_LOCKED_TABLE *ltbl,
+                          void (*fn)(const CUCKOO_KEY_ALIAS *,
+                                     CUCKOO_MAPPED_ALIAS *, void *),
+                          void *ctx) {
+  for (auto &pair : ltbl->lt) {
+    fn(&pair.first, &pair.second, ctx);
+  }
+}
+
 #define CUCKOO_ITERATOR CUCKOO(_iterator)
 #define CUCKOO_IT(a) PASTE(CUCKOO_ITERATOR, a)
 struct CUCKOO_ITERATOR {
@@ -348,6 +817,12 @@ bool CUCKOO_LT(_insert)(CUCKOO_LOCKED_TABLE *ltbl, const CUCKOO_KEY_ALIAS *key,
   } catch (std::bad_alloc &) {
     errno = ENOMEM;
     return false;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+    return false;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
+    return false;
   }
   if (it != NULL) {
     it->it = ret.first;
@@ -399,6 +874,10 @@ void CUCKOO_LT(_rehash)(CUCKOO_LOCKED_TABLE *ltbl, size_t n) {
     ltbl->lt.rehash(n);
   } catch (std::bad_alloc &) {
     errno = ENOMEM;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
   }
 }
 
@@ -408,6 +887,10 @@ void CUCKOO_LT(_reserve)(CUCKOO_LOCKED_TABLE *ltbl, size_t n) {
     ltbl->lt.reserve(n);
   } catch (std::bad_alloc &) {
     errno = ENOMEM;
+  } catch (libcuckoo::load_factor_too_low &) {
+    errno = ENOSPC;
+  } catch (libcuckoo::maximum_hashpower_exceeded &) {
+    errno = ENOSPC;
   }
 }
 
@@ -417,16 +900,32 @@ bool CUCKOO_LT(_write)(const CUCKOO_LOCKED_TABLE *ltbl, FILE *fp) {
   if (!fwrite(&tbl_size, sizeof(size_t), 1, fp)) {
     return false;
   }
+  const size_t record_size =
+      sizeof(CUCKOO_KEY_ALIAS) + sizeof(CUCKOO_MAPPED_ALIAS);
+  const size_t block_records =
+      std::max<size_t>(CUCKOO_IO_BLOCK_BYTES / record_size, 1);
+  std::vector<char> block;
+  try {
+    block.resize(std::min(tbl_size, block_records) * record_size);
+  } catch (std::bad_alloc &) {
+    errno = ENOMEM;
+    return false;
+  }
+  size_t used = 0;
   for (const auto &pair : ltbl->lt) {
-    if (!fwrite(std::addressof(pair.first), sizeof(CUCKOO_KEY_ALIAS), 1, fp)) {
-      return false;
-    }
-    if (!fwrite(std::addressof(pair.second), sizeof(CUCKOO_MAPPED_ALIAS), 1,
-                fp)) {
-      return false;
+    std::memcpy(&block[used], std::addressof(pair.first),
+                sizeof(CUCKOO_KEY_ALIAS));
+    std::memcpy(&block[used + sizeof(CUCKOO_KEY_ALIAS)],
+                std::addressof(pair.second), sizeof(CUCKOO_MAPPED_ALIAS));
+    used += record_size;
+    if (used == block.size()) {
+      if (fwrite(block.data(), 1, used, fp) != used) {
+        return false;
+      }
+      used = 0;
     }
   }
-  return true;
+  return used == 0 || fwrite(block.data(), 1, used, fp) == used;
 }
 
 // iterator::copy assignment
@@ -499,9 +998,13 @@ void CUCKOO_CONST_IT(_decrement)(CUCKOO_CONST_ITERATOR *it) { --(it->it); }
 #undef CUCKOO
 #undef CUCKOO_KEY_ALIAS
 #undef CUCKOO_MAPPED_ALIAS
+#undef CUCKOO_STATS
 #undef CUCKOO_LOCKED_TABLE
 #undef CUCKOO_LT
 #undef CUCKOO_ITERATOR
 #undef CUCKOO_IT
 #undef CUCKOO_CONST_ITERATOR
 #undef CUCKOO_CONST_IT
+#undef CUCKOO_IO_BLOCK_BYTES
+#undef CUCKOO_HASHER
+#undef CUCKOO_KEY_EQUAL
@@ -10,10 +10,28 @@
 // Type of mapped value
 // #define CUCKOO_MAPPED_TYPE ___
 //
+// Optionally, you can also define the functions used to hash and compare keys:
+//
+// Name of a function `size_t fn(const CUCKOO_KEY_TYPE *key)`
+// #define CUCKOO_HASH_FN ___
+//
+// Name of a function
+// `bool fn(const CUCKOO_KEY_TYPE *lhs, const CUCKOO_KEY_TYPE *rhs)`
+// #define CUCKOO_EQ_FN ___
+//
+// The functions are called directly from the implementation, so defining them
+// as `static inline` in your header lets the compiler inline them. Otherwise,
+// keys are hashed with std::hash and compared with std::equal_to if std::hash
+// has been specialized for the key type, as it is for all arithmetic and
+// pointer types. Other keys, such as structs, are hashed and compared as raw
+// bytes, so they must not contain padding or any other bytes that can differ
+// between equal keys. If you define one function, you will usually need to
+// define the other.
+//
 // Then, include this template file, which will fill in the interface
 // definition.  If you are including multiple different table interfaces in the
-// same compilation unit, make sure to undefine the three symbols above using
-// the `#undef` macro.
+// same compilation unit, make sure to undefine the symbols above using the
+// `#undef` macro.
 //
 // EXCEPTION SAFETY NOTE:
 // Assuming no user defined data types, hash functions, or equality functions
@@ -25,6 +43,10 @@
 // rehash, reserve, locked_table::insert, locked_table::rehash,
 // locked_table::reserve) could throw. For all functions that allocate memory,
 // we catch std::bad_alloc and set errno to ENOMEM.
+//
+// If the minimum load factor or maximum hashpower have been set, the functions
+// that could trigger a resize can also fail because the table couldn't be
+// resized within those limits. In that case, they set errno to ENOSPC.
 
 // Helper macros, we take care of undefining these
 #define PASTE2(a, b) a##b
@@ -33,6 +55,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 // Abstract type of the cuckoo table
@@ -53,9 +76,20 @@ CUCKOO_TABLE_NAME *CUCKOO(_init)(size_t n);
 // Reads in a table serialized in the file `fp` and constructs a new table.
 // Uses a default hash function, equality function, and allocator. There is no
 // minimum load factor or maximum hashpower. This will only work if the table
-// types are POD, which should always be the case in a C program.
+// types are POD, which should always be the case in a C program. The file is
+// read in large blocks, and the elements of each block are inserted by one
+// thread per hardware thread while the next block is read. If the file holds
+// the same key more than once, which a file written by
+// CUCKOO_LT(_write) never does, it's unspecified which of its values is kept.
 CUCKOO_TABLE_NAME *CUCKOO(_read)(FILE *fp);
 
+// Like CUCKOO(_read), but inserts the elements with `num_threads` threads. If
+// `num_threads` is 0, uses one thread per hardware thread. The threads are
+// started once and reused for every block. If memory runs out, it sets errno
+// to ENOMEM, and if a thread can't be started, to the error that stopped it,
+// such as EAGAIN. Either way it stops the threads it started and returns NULL.
+CUCKOO_TABLE_NAME *CUCKOO(_read_parallel)(FILE *fp, size_t num_threads);
+
 // Destroys the given table
 void CUCKOO(_free)(CUCKOO_TABLE_NAME *tbl);
 
@@ -77,6 +111,63 @@ size_t CUCKOO(_capacity)(const CUCKOO_TABLE_NAME *tbl);
 // load_factor
 double CUCKOO(_load_factor)(const CUCKOO_TABLE_NAME *tbl);
 
+// minimum_load_factor. _init sets it to 0, so that automatic expansions never
+// fail.
+double CUCKOO(_minimum_load_factor)(const CUCKOO_TABLE_NAME *tbl);
+
+// minimum_load_factor setter. Returns false and sets errno to EINVAL if `mlf`
+// isn't between 0 and 1.
+bool CUCKOO(_set_minimum_load_factor)(CUCKOO_TABLE_NAME *tbl, double mlf);
+
+// maximum_hashpower. _init sets it to SIZE_MAX, which means there is no
+// maximum.
+size_t CUCKOO(_maximum_hashpower)(const CUCKOO_TABLE_NAME *tbl);
+
+// maximum_hashpower setter. Returns false and sets errno to EINVAL if the
+// table's hashpower is already larger than `mhp`.
+bool CUCKOO(_set_maximum_hashpower)(CUCKOO_TABLE_NAME *tbl, size_t mhp);
+
+// max_num_worker_threads -- the number of extra threads used to resize the
+// table, 0 by default
+size_t CUCKOO(_max_num_worker_threads)(const CUCKOO_TABLE_NAME *tbl);
+
+// max_num_worker_threads setter
+void CUCKOO(_set_max_num_worker_threads)(CUCKOO_TABLE_NAME *tbl,
+                                         size_t extra_threads);
+
+// Statistics about a table. The resize counts and times are only collected if
+// the implementation file is compiled with LIBCUCKOO_RESIZE_STATS defined to
+// 1, and the lock counts only if it's compiled with LIBCUCKOO_LOCK_STATS
+// defined to 1. Otherwise they are 0.
+#define CUCKOO_STATS CUCKOO(_stats)
+typedef struct {
+  size_t size;
+  size_t hashpower;
+  size_t capacity;
+  double load_factor;
+  // Taking all the locks of the table, for a resize or a locked table
+  size_t lock_all_count;
+  uint64_t lock_all_ns;
+  // Doubling the table, with lazy migration of its buckets
+  size_t fast_double_count;
+  uint64_t fast_double_ns;
+  // Resizing the table by inserting every element into a new table
+  size_t expand_simple_count;
+  uint64_t expand_simple_ns;
+  // Migrating the buckets of one lock after a doubling
+  size_t lazy_rehash_count;
+  uint64_t lazy_rehash_ns;
+  // Lock acquisitions, and how many of them found the lock already held
+  size_t lock_acquisitions;
+  size_t lock_contended;
+} CUCKOO_STATS;
+
+// Fills in `stats` with the table's current statistics
+void CUCKOO(_get_stats)(const CUCKOO_TABLE_NAME *tbl, CUCKOO_STATS *stats);
+
+// Resets the resize and lock statistics to 0
+void CUCKOO(_reset_stats)(CUCKOO_TABLE_NAME *tbl);
+
 // find_fn
 bool CUCKOO(_find_fn)(const CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
                       void (*fn)(const CUCKOO_MAPPED_ALIAS *));
@@ -94,6 +185,31 @@ bool CUCKOO(_upsert)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
 bool CUCKOO(_erase_fn)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
                        bool (*fn)(CUCKOO_MAPPED_ALIAS *));
 
+// The _ctx variants of the functions above pass `ctx` through to `fn` on every
+// call, so that callers can get results out of `fn` without going through
+// globals
+
+// find_fn with a context pointer
+bool CUCKOO(_find_fn_ctx)(const CUCKOO_TABLE_NAME *tbl,
+                          const CUCKOO_KEY_ALIAS *key,
+                          void (*fn)(const CUCKOO_MAPPED_ALIAS *, void *),
+                          void *ctx);
+
+// update_fn with a context pointer
+bool CUCKOO(_update_fn_ctx)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
+                            void (*fn)(CUCKOO_MAPPED_ALIAS *, void *),
+                            void *ctx);
+
+// upsert with a context pointer
+bool CUCKOO(_upsert_ctx)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
+                         void (*fn)(CUCKOO_MAPPED_ALIAS *, void *), void *ctx,
+                         const CUCKOO_MAPPED_ALIAS *val);
+
+// erase_fn with a context pointer
+bool CUCKOO(_erase_fn_ctx)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
+                           bool (*fn)(CUCKOO_MAPPED_ALIAS *, void *),
+                           void *ctx);
+
 // find
 bool CUCKOO(_find)(const CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key,
                    CUCKOO_MAPPED_ALIAS *val);
@@ -115,6 +231,24 @@ bool CUCKOO(_insert_or_assign)(CUCKOO_TABLE_NAME *tbl,
                                const CUCKOO_KEY_ALIAS *key,
                                const CUCKOO_MAPPED_ALIAS *val);
 
+// find_batch looks up the `n` keys in `keys`. For each key i that is in the
+// table, it copies the mapped value into `vals[i]` and sets `found[i]` to true.
+// For each key that isn't, `vals[i]` is left unchanged and `found[i]` is set to
+// false. `found` may be NULL. Returns the number of keys found.
+size_t CUCKOO(_find_batch)(const CUCKOO_TABLE_NAME *tbl,
+                           const CUCKOO_KEY_ALIAS *keys, size_t n,
+                           CUCKOO_MAPPED_ALIAS *vals, bool *found);
+
+// insert_batch inserts each of the `n` pairs of `keys[i]` and `vals[i]`, in
+// order, and sets `inserted[i]` to whether the key was newly inserted, as
+// insert does. `inserted` may be NULL. Returns the number of keys inserted. If
+// memory runs out or the table can't be resized, it sets errno as insert does
+// and stops, leaving the remaining entries of `inserted` unchanged.
+size_t CUCKOO(_insert_batch)(CUCKOO_TABLE_NAME *tbl,
+                             const CUCKOO_KEY_ALIAS *keys,
+                             const CUCKOO_MAPPED_ALIAS *vals, size_t n,
+                             bool *inserted);
+
 // erase
 bool CUCKOO(_erase)(CUCKOO_TABLE_NAME *tbl, const CUCKOO_KEY_ALIAS *key);
 
@@ -127,6 +261,19 @@ bool CUCKOO(_reserve)(CUCKOO_TABLE_NAME *tbl, size_t n);
 // clear
 void CUCKOO(_clear)(CUCKOO_TABLE_NAME *tbl);
 
+// for_each calls `fn` on every element with `ctx`, one lock stripe at a time,
+// so the rest of the table stays available to other threads during the scan.
+// `fn` may modify the mapped value, but must not call any other function on
+// the table. Returns true if every element that stayed in the table for the
+// whole scan was seen exactly once. Returns false if the table was resized
+// during the scan, which stops it early, or if concurrent inserts moved
+// elements between stripes, in which case some may have been missed or seen
+// twice.
+bool CUCKOO(_for_each)(CUCKOO_TABLE_NAME *tbl,
+                       void (*fn)(const CUCKOO_KEY_ALIAS *,
+                                  CUCKOO_MAPPED_ALIAS *, void *),
+                       void *ctx);
+
 // Abstract type of the locked table
 #define CUCKOO_LOCKED_TABLE CUCKOO(_locked_table)
 #define CUCKOO_LT(a) PASTE(CUCKOO_LOCKED_TABLE, a)
@@ -163,6 +310,14 @@ size_t CUCKOO_LT(_capacity)(const CUCKOO_LOCKED_TABLE *ltbl);
 // locked_table::load_factor
 double CUCKOO_LT(_load_factor)(const CUCKOO_LOCKED_TABLE *ltbl);
 
+// locked_table::for_each calls `fn` on every element with `ctx`. Unlike
+// stepping through iterators, it makes one call into the table for the whole
+// scan and allocates nothing. `fn` may modify the mapped value.
+void CUCKOO_LT(_for_each)(CUCKOO_LOCKED_TABLE *ltbl,
+                          void (*fn)(const CUCKOO_KEY_ALIAS *,
+                                     CUCKOO_MAPPED_ALIAS *, void *),
+                          void *ctx);
+
 // Abstract type of the iterators
 #define CUCKOO_ITERATOR CUCKOO(_iterator)
 #define CUCKOO_IT(a) PASTE(CUCKOO_ITERATOR, a)
@@ -230,9 +385,9 @@ void CUCKOO_LT(_rehash)(CUCKOO_LOCKED_TABLE *ltbl, size_t n);
 // locked_table::reserve
 void CUCKOO_LT(_reserve)(CUCKOO_LOCKED_TABLE *ltbl, size_t n);
 
-// locked_table::write will serialize the table to the file `fp`. This will
-// only work if the table types are POD, which should always be the case in a C
-// program.
+// locked_table::write will serialize the table to the file `fp`, writing it
+// in large blocks. This will only work if the table types are POD, which
+// should always be the case in a C program.
 bool CUCKOO_LT(_write)(const CUCKOO_LOCKED_TABLE *ltbl, FILE *fp);
 
 // iterator::copy assignment
@@ -277,6 +432,7 @@ void CUCKOO_CONST_IT(_decrement)(CUCKOO_CONST_ITERATOR *it);
 #undef CUCKOO
 #undef CUCKOO_KEY_ALIAS
 #undef CUCKOO_MAPPED_ALIAS
+#undef CUCKOO_STATS
 #undef CUCKOO_LOCKED_TABLE
 #undef CUCKOO_LT
 #undef CUCKOO_ITERATOR
@@ -20,14 +20,20 @@ namespace libcuckoo {
  * slots have live data and which do not. It also stores a partial hash for
  * each live key. It is sized by powers of two.
  *
+ * If @p EmptyKey reserves a key value, empty slots hold that key instead, and
+ * no occupancy flags or partial keys are stored. Partial keys wider than a
+ * byte hold the occupancy flag in their top bit, which must be left clear.
+ *
  * @tparam Key type of keys in the table
  * @tparam T type of values in the table
  * @tparam Allocator type of key-value pair allocator
  * @tparam Partial type of partial keys
  * @tparam SLOT_PER_BUCKET number of slots for each bucket in the table
+ * @tparam EmptyKey no_empty_key, or an empty_key giving the key that marks
+ * empty slots
  */
 template <class Key, class T, class Allocator, class Partial,
-          std::size_t SLOT_PER_BUCKET>
+          std::size_t SLOT_PER_BUCKET, class EmptyKey = no_empty_key>
 class bucket_container {
 public:
   using key_type = Key;
@@ -47,6 +53,67 @@ public:
   using pointer = typename traits_::pointer;
   using const_pointer = typename traits_::const_pointer;
 
+  // Whether empty slots are marked by a reserved key
+  static constexpr bool has_empty_key() {
+    return !std::is_same<EmptyKey, no_empty_key>::value;
+  }
+
+  // Whether each slot's occupied flag is kept in the top bit of its partial
+  // key, rather than in a separate array. Partial keys wider than a byte have
+  // bits to spare, so they must leave the top bit clear.
+  static constexpr bool packs_occupied() { return sizeof(partial_t) > 1; }
+
+private:
+  // The per-slot metadata stored in a bucket alongside its keys and values.
+  // With an empty key, there is none, and the bucket's empty base takes up no
+  // space.
+  template <class EK, bool PACKED, class Dummy = void> struct slot_metadata {};
+
+  template <class Dummy> struct slot_metadata<no_empty_key, false, Dummy> {
+    slot_metadata() noexcept : occupied_() {}
+
+    partial_t meta_partial(size_type ind) const { return partials_[ind]; }
+    void set_meta_partial(size_type ind, partial_t p) { partials_[ind] = p; }
+
+    bool meta_occupied(size_type ind) const { return occupied_[ind]; }
+    void set_meta_occupied(size_type ind, bool val) { occupied_[ind] = val; }
+
+    std::array<partial_t, SLOT_PER_BUCKET> partials_;
+    std::array<bool, SLOT_PER_BUCKET> occupied_;
+  };
+
+  template <class Dummy> struct slot_metadata<no_empty_key, true, Dummy> {
+    slot_metadata() noexcept : partials_() {}
+
+    static constexpr partial_t occupied_bit() {
+      return static_cast<partial_t>(partial_t(1)
+                                    << (8 * sizeof(partial_t) - 1));
+    }
+
+    partial_t meta_partial(size_type ind) const {
+      return static_cast<partial_t>(partials_[ind] & ~occupied_bit());
+    }
+    void set_meta_partial(size_type ind, partial_t p) {
+      assert((p & occupied_bit()) == 0);
+      partials_[ind] =
+          static_cast<partial_t>((partials_[ind] & occupied_bit()) | p);
+    }
+
+    bool meta_occupied(size_type ind) const {
+      return (partials_[ind] & occupied_bit()) != 0;
+    }
+    void set_meta_occupied(size_type ind, bool val) {
+      partials_[ind] = static_cast<partial_t>(
+          val ? partials_[ind] | occupied_bit()
+              : partials_[ind] & ~occupied_bit());
+    }
+
+    std::array<partial_t, SLOT_PER_BUCKET> partials_;
+  };
+
+  using slot_metadata_type = slot_metadata<EmptyKey, packs_occupied()>;
+
+public:
   /*
    * The bucket type holds SLOT_PER_BUCKET key-value pairs, along with their
    * partial keys and occupancy info. It uses aligned_storage arrays to store
@@ -55,9 +122,16 @@ public:
    * It is the user's responsibility to confirm whether the data they are
    * accessing is live or not.
    */
-  class bucket {
+  class bucket : private slot_metadata_type {
   public:
-    bucket() noexcept : occupied_() {}
+    bucket() noexcept {
+      // Without an empty key, the occupancy flags are already cleared
+      if (has_empty_key()) {
+        for (size_type i = 0; i < SLOT_PER_BUCKET; ++i) {
+          set_occupied(i, false);
+        }
+      }
+    }
 
     const value_type &kvpair(size_type ind) const {
       return *static_cast<const value_type *>(
@@ -79,17 +153,62 @@ public:
     }
     mapped_type &mapped(size_type ind) { return storage_kvpair(ind).second; }
 
-    partial_t partial(size_type ind) const { return partials_[ind]; }
-    partial_t &partial(size_type ind) { return partials_[ind]; }
+    // With an empty key, partial keys aren't stored, and this returns 0
+    partial_t partial(size_type ind) const {
+      return partial(ind, std::integral_constant<bool, has_empty_key()>());
+    }
 
-    bool occupied(size_type ind) const { return occupied_[ind]; }
-    bool &occupied(size_type ind) { return occupied_[ind]; }
+    bool occupied(size_type ind) const {
+      return occupied(ind, std::integral_constant<bool, has_empty_key()>());
+    }
 
   private:
     friend class bucket_container;
 
     using storage_value_type = std::pair<Key, T>;
 
+    // `true` here means there is an empty key
+    partial_t partial(size_type, std::true_type) const { return 0; }
+    partial_t partial(size_type ind, std::false_type) const {
+      return this->meta_partial(ind);
+    }
+
+    void set_partial(size_type, partial_t, std::true_type) {}
+    void set_partial(size_type ind, partial_t p, std::false_type) {
+      this->set_meta_partial(ind, p);
+    }
+
+    void set_partial(size_type ind, partial_t p) {
+      set_partial(ind, p, std::integral_constant<bool, has_empty_key()>());
+    }
+
+    // The key storage of an empty slot holds the empty key, which is never
+    // the key of a live slot
+    bool occupied(size_type ind, std::true_type) const {
+      return storage_kvpair(ind).first != EmptyKey::value;
+    }
+    bool occupied(size_type ind, std::false_type) const {
+      return this->meta_occupied(ind);
+    }
+
+    // Marking a slot occupied is a no-op with an empty key, since
+    // constructing its key does that. Marking it empty writes the empty key
+    // over the slot's key, so it must only be done to a slot without live
+    // data.
+    void set_occupied(size_type ind, bool val, std::true_type) {
+      if (!val) {
+        ::new (static_cast<void *>(std::addressof(storage_kvpair(ind).first)))
+            Key(EmptyKey::value);
+      }
+    }
+    void set_occupied(size_type ind, bool val, std::false_type) {
+      this->set_meta_occupied(ind, val);
+    }
+
+    void set_occupied(size_type ind, bool val) {
+      set_occupied(ind, val, std::integral_constant<bool, has_empty_key()>());
+    }
+
     const storage_value_type &storage_kvpair(size_type ind) const {
       return *static_cast<const storage_value_type *>(
           static_cast<const void *>(&values_[ind]));
@@ -103,8 +222,6 @@ public:
                                              alignof(storage_value_type)>::type,
                SLOT_PER_BUCKET>
         values_;
-    std::array<partial_t, SLOT_PER_BUCKET> partials_;
-    std::array<bool, SLOT_PER_BUCKET> occupied_;
   };
 
   bucket_container(size_type hp, const allocator_type &allocator)
@@ -121,6 +238,12 @@ public:
     }
   }
 
+  // Constructs a container with no allocated buckets, in the same state that
+  // clear_and_deallocate leaves it in
+  explicit bucket_container(const allocator_type &allocator)
+      : allocator_(allocator), bucket_allocator_(allocator), hashpower_(0),
+        buckets_(nullptr) {}
+
   ~bucket_container() noexcept { destroy_buckets(); }
 
   bucket_container(const bucket_container &bc)
@@ -202,21 +325,28 @@ public:
              Args &&... args) {
     bucket &b = buckets_[ind];
     assert(!b.occupied(slot));
-    b.partial(slot) = p;
-    traits_::construct(allocator_, std::addressof(b.storage_kvpair(slot)),
-                       std::piecewise_construct,
-                       std::forward_as_tuple(std::forward<K>(k)),
-                       std::forward_as_tuple(std::forward<Args>(args)...));
+    b.set_partial(slot, p);
+    try {
+      traits_::construct(allocator_, std::addressof(b.storage_kvpair(slot)),
+                         std::piecewise_construct,
+                         std::forward_as_tuple(std::forward<K>(k)),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+    } catch (...) {
+      // With an empty key, the key may have been constructed before the
+      // value threw, so the slot has to be marked empty again
+      b.set_occupied(slot, false);
+      throw;
+    }
     // This must occur last, to enforce a strong exception guarantee
-    b.occupied(slot) = true;
+    b.set_occupied(slot, true);
   }
 
   // Destroys live data in a bucket
   void eraseKV(size_type ind, size_type slot) {
     bucket &b = buckets_[ind];
     assert(b.occupied(slot));
-    b.occupied(slot) = false;
     traits_::destroy(allocator_, std::addressof(b.storage_kvpair(slot)));
+    b.set_occupied(slot, false);
   }
 
   // Destroys all the live data in the buckets. Does not deallocate the bucket
@@ -321,6 +451,11 @@ private:
                                 const bucket_container &>::type src,
       std::integral_constant<bool, B> move) {
     assert(dst_hp >= src.hashpower());
+    // A deallocated source (such as a table's old buckets once they have been
+    // fully rehashed) has no data to read, so the result is deallocated too
+    if (src.buckets_ == nullptr) {
+      return nullptr;
+    }
     bucket_container dst(dst_hp, get_allocator());
     // Move/copy all occupied slots of the source buckets
     for (size_t i = 0; i < src.size(); ++i) {
@@ -361,8 +496,8 @@ private:
                                      std::is_trivial<ThisT>::value,
                                  std::ostream &>::type
   operator<<(std::ostream &os,
-             const bucket_container<ThisKey, ThisT, Allocator,
-                                              Partial, SLOT_PER_BUCKET> &bc) {
+             const bucket_container<ThisKey, ThisT, Allocator, Partial,
+                                    SLOT_PER_BUCKET, EmptyKey> &bc) {
     size_type hp = bc.hashpower();
     os.write(reinterpret_cast<const char *>(&hp), sizeof(size_type));
     os.write(reinterpret_cast<const char *>(bc.buckets_),
@@ -375,8 +510,8 @@ private:
                                      std::is_trivial<ThisT>::value,
                                  std::istream &>::type
   operator>>(std::istream &is,
-             bucket_container<ThisKey, ThisT, Allocator,
-                                        Partial, SLOT_PER_BUCKET> &bc) {
+             bucket_container<ThisKey, ThisT, Allocator, Partial,
+                              SLOT_PER_BUCKET, EmptyKey> &bc) {
     size_type hp;
     is.read(reinterpret_cast<char *>(&hp), sizeof(size_type));
     bucket_container new_bc(hp, bc.get_allocator());
@@ -0,0 +1,333 @@
+/** \file */
+
+#ifndef _CUCKOOHASH_ARENA_HH
+#define _CUCKOOHASH_ARENA_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "cuckoohash_util.hh"
+
+namespace libcuckoo {
+
+/**
+ * Counts of the memory that arena_allocator has taken from the system
+ * allocator, across all threads, since the program started.
+ */
+struct arena_stats {
+  //! The number of chunks allocated to carve blocks from
+  std::size_t chunks;
+  //! The total size of those chunks, in bytes
+  std::size_t chunk_bytes;
+  //! The number of allocations too large for a block, which are passed
+  //! through to the system allocator
+  std::size_t large_allocations;
+};
+
+namespace arena_detail {
+
+// Blocks come in multiples of SIZE_STEP bytes up to MAX_STEPPED, and then in
+// powers of two up to MAX_BLOCK, and are carved from chunks of CHUNK_SIZE
+// bytes. A thread keeps up to 2 * BATCH_BYTES of free blocks of each size
+// before returning BATCH_BYTES of them to the shared pool.
+constexpr std::size_t SIZE_STEP = 16;
+constexpr std::size_t MAX_STEPPED = 512;
+constexpr std::size_t NUM_STEPPED = MAX_STEPPED / SIZE_STEP;
+constexpr std::size_t MAX_BLOCK = 4096;
+constexpr std::size_t NUM_CLASSES = NUM_STEPPED + 3;
+constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+constexpr std::size_t BATCH_BYTES = 16 * 1024;
+
+struct free_block {
+  free_block *next;
+};
+
+// A list of free blocks of one size, with its length
+struct free_list {
+  free_block *head = nullptr;
+  std::size_t count = 0;
+
+  void push(free_block *b) {
+    b->next = head;
+    head = b;
+    ++count;
+  }
+
+  free_block *pop() {
+    free_block *b = head;
+    head = b->next;
+    --count;
+    return b;
+  }
+};
+
+inline std::size_t size_class(std::size_t bytes) {
+  if (bytes <= MAX_STEPPED) {
+    return bytes == 0 ? 0 : (bytes - 1) / SIZE_STEP;
+  }
+  std::size_t cls = NUM_STEPPED;
+  while ((MAX_STEPPED << (cls - NUM_STEPPED + 1)) < bytes) {
+    ++cls;
+  }
+  return cls;
+}
+
+inline std::size_t block_size(std::size_t cls) {
+  return cls < NUM_STEPPED ? (cls + 1) * SIZE_STEP
+                           : MAX_STEPPED << (cls - NUM_STEPPED + 1);
+}
+
+inline std::size_t batch_count(std::size_t cls) {
+  return BATCH_BYTES / block_size(cls);
+}
+
+// Free blocks that no thread holds, and the chunks they were carved from.
+// The pool is never destroyed, since strings in static objects may be freed
+// after every other static has been, so its chunks last for the life of the
+// program.
+class pool {
+public:
+  static pool &instance() {
+    static pool *p = new pool;
+    return *p;
+  }
+
+  // Fills `list` with a batch of free blocks of class `cls`
+  void refill(free_list &list, std::size_t cls) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      free_list &shared = lists_[cls];
+      for (std::size_t i = batch_count(cls); i > 0 && shared.count > 0; --i) {
+        list.push(shared.pop());
+      }
+    }
+    if (list.count > 0) {
+      return;
+    }
+    char *chunk = static_cast<char *>(::operator new(CHUNK_SIZE));
+    chunks_.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t size = block_size(cls);
+    for (std::size_t i = CHUNK_SIZE / size; i > 0; --i) {
+      list.push(reinterpret_cast<free_block *>(chunk + (i - 1) * size));
+    }
+    // Keep a batch of the chunk's blocks, and share the rest
+    give(list, cls, list.count - batch_count(cls));
+  }
+
+  // Moves `n` blocks of class `cls` from `list` to the pool
+  void give(free_list &list, std::size_t cls, std::size_t n) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    free_list &shared = lists_[cls];
+    for (; n > 0 && list.count > 0; --n) {
+      shared.push(list.pop());
+    }
+  }
+
+  void count_large() { large_.fetch_add(1, std::memory_order_relaxed); }
+
+  arena_stats stats() const {
+    const std::size_t chunks = chunks_.load(std::memory_order_relaxed);
+    return arena_stats{chunks, chunks * CHUNK_SIZE,
+                       large_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  pool() : chunks_(0), large_(0) {}
+
+  std::mutex mutex_;
+  free_list lists_[NUM_CLASSES];
+  std::atomic<std::size_t> chunks_;
+  std::atomic<std::size_t> large_;
+};
+
+// Each thread's free blocks, which it allocates from and frees to without
+// synchronization. When the thread exits, they go back to the pool.
+class thread_cache {
+public:
+  ~thread_cache() {
+    for (std::size_t cls = 0; cls < NUM_CLASSES; ++cls) {
+      pool::instance().give(lists_[cls], cls, lists_[cls].count);
+    }
+    destroyed() = true;
+  }
+
+  void *allocate(std::size_t cls) {
+    free_list &list = lists_[cls];
+    if (list.count == 0) {
+      pool::instance().refill(list, cls);
+    }
+    return list.pop();
+  }
+
+  void deallocate(void *p, std::size_t cls) {
+    free_list &list = lists_[cls];
+    list.push(static_cast<free_block *>(p));
+    if (list.count >= 2 * batch_count(cls)) {
+      pool::instance().give(list, cls, batch_count(cls));
+    }
+  }
+
+  // Returns this thread's cache, or nullptr once it has been destroyed, which
+  // happens when a thread's thread_local objects are destroyed before some
+  // object that frees arena memory
+  static thread_cache *get() {
+    if (destroyed()) {
+      return nullptr;
+    }
+    static thread_local thread_cache cache;
+    return &cache;
+  }
+
+private:
+  static bool &destroyed() {
+    static thread_local bool flag = false;
+    return flag;
+  }
+
+  free_list lists_[NUM_CLASSES];
+};
+
+inline void *allocate(std::size_t bytes) {
+  if (bytes > MAX_BLOCK) {
+    pool::instance().count_large();
+    return ::operator new(bytes);
+  }
+  const std::size_t cls = size_class(bytes);
+  thread_cache *cache = thread_cache::get();
+  if (cache != nullptr) {
+    return cache->allocate(cls);
+  }
+  free_list list;
+  pool::instance().refill(list, cls);
+  void *p = list.pop();
+  pool::instance().give(list, cls, list.count);
+  return p;
+}
+
+inline void deallocate(void *p, std::size_t bytes) {
+  if (bytes > MAX_BLOCK) {
+    ::operator delete(p);
+    return;
+  }
+  const std::size_t cls = size_class(bytes);
+  thread_cache *cache = thread_cache::get();
+  if (cache != nullptr) {
+    cache->deallocate(p, cls);
+    return;
+  }
+  free_list list;
+  list.push(static_cast<free_block *>(p));
+  pool::instance().give(list, cls, 1);
+}
+
+} // namespace arena_detail
+
+/**
+ * A stateless allocator that serves small allocations from per-thread arenas,
+ * for the key and value types of tables whose keys and values allocate, such
+ * as strings. Each insert into a table of @c std::string keys and values
+ * allocates twice, and each erase frees twice, while holding the locks of the
+ * buckets involved. With this allocator those calls take a block from, or
+ * return it to, the calling thread's own free list, and only reach the system
+ * allocator to get a new 64 KiB chunk when the arenas run out.
+ *
+ * Allocations of up to 512 bytes are rounded up to a multiple of 16 bytes, and
+ * those of up to 4 KiB to a power of two. Larger ones are passed through to
+ * the system allocator. A block may
+ * be freed by any thread, and is kept by that thread for reuse. Each thread
+ * returns its free blocks to a shared pool when it has too many of one size,
+ * and when it exits. Chunks are reused, but never returned to the system.
+ *
+ * Moving a key or value, as the table does when it resizes, moves its
+ * pointer, so resizing neither allocates nor copies from the arenas.
+ *
+ * @tparam T the type of object allocated. Its alignment must be no greater
+ * than 16.
+ */
+template <class T> class arena_allocator {
+public:
+  static_assert(alignof(T) <= arena_detail::SIZE_STEP,
+                "arena_allocator only supports alignments of up to 16");
+
+  //! The type of object allocated
+  using value_type = T;
+
+  arena_allocator() noexcept {}
+
+  /**
+   * Converting constructor, needed to rebind the allocator
+   */
+  template <class U> arena_allocator(const arena_allocator<U> &) noexcept {}
+
+  /**
+   * Allocates uninitialized space for @p n objects
+   *
+   * @param n the number of objects to allocate space for
+   * @return a pointer to the space
+   * @throw std::bad_alloc if the system allocator fails
+   */
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(arena_detail::allocate(n * sizeof(T)));
+  }
+
+  /**
+   * Frees space returned by @ref allocate
+   *
+   * @param p the pointer returned by @ref allocate
+   * @param n the number of objects passed to @ref allocate
+   */
+  void deallocate(T *p, std::size_t n) noexcept {
+    arena_detail::deallocate(p, n * sizeof(T));
+  }
+
+  /**
+   * Returns the memory the arenas have taken from the system allocator, and
+   * the number of allocations passed through to it.
+   *
+   * @return the statistics, summed over all threads
+   */
+  static arena_stats stats() { return arena_detail::pool::instance().stats(); }
+};
+
+template <class T, class U>
+bool operator==(const arena_allocator<T> &, const arena_allocator<U> &) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(const arena_allocator<T> &, const arena_allocator<U> &) {
+  return false;
+}
+
+/**
+ * A string whose characters are allocated from the arenas of @ref
+ * arena_allocator
+ */
+using arena_string =
+    std::basic_string<char, std::char_traits<char>, arena_allocator<char>>;
+
+/**
+ * A hash function for @ref arena_string, which @c std::hash is not
+ * specialized for. It hashes strings of @c char with any allocator, giving
+ * equal strings the same hash whatever their allocators.
+ */
+struct arena_string_hash {
+  /**
+   * @param s the string to hash
+   * @return the hash of the characters of @p s
+   */
+  template <class Alloc>
+  std::size_t
+  operator()(const std::basic_string<char, std::char_traits<char>, Alloc> &s)
+      const {
+    return bytes_hash(s.data(), s.size());
+  }
+};
+
+} // namespace libcuckoo
+
+#endif // _CUCKOOHASH_ARENA_HH
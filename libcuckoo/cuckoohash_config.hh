@@ -15,6 +15,14 @@ constexpr size_t DEFAULT_SLOT_PER_BUCKET = 4;
 constexpr size_t DEFAULT_SIZE =
     (1U << 16) * DEFAULT_SLOT_PER_BUCKET;
 
+//! A size for tables that are expected to hold only a few elements, such as
+//! the inner tables of a nested map. It fits in a single bucket, which is
+//! guarded by a single lock, and the table grows as needed like any other.
+//! The bucket and its lock are allocated apart from the table object, unless
+//! the table's INLINE_SIZE is at least this size, in which case the elements
+//! are stored in the table object until they outgrow it.
+constexpr size_t SMALL_TABLE_SIZE = DEFAULT_SLOT_PER_BUCKET;
+
 //! The default minimum load factor that the table allows for automatic
 //! expansion. It must be a number between 0.0 and 1.0. The table will throw
 //! load_factor_too_low if the load factor falls below this value
@@ -30,6 +38,24 @@ constexpr size_t NO_MAXIMUM_HASHPOWER =
 //! set LIBCUCKOO_DEBUG to 1 to enable debug output
 #define LIBCUCKOO_DEBUG 0
 
+//! define LIBCUCKOO_RESIZE_STATS to 1 before including the table to record
+//! how much time is spent in each phase of resizing, see
+//! cuckoohash_map::get_resize_stats. It adds the counters to every table, so
+//! it must be set the same way in every translation unit that includes the
+//! table, or the program will have conflicting definitions of it
+#ifndef LIBCUCKOO_RESIZE_STATS
+#define LIBCUCKOO_RESIZE_STATS 0
+#endif
+
+//! define LIBCUCKOO_LOCK_STATS to 1 before including the table to count how
+//! often its locks are acquired, and how often they were already held, see
+//! cuckoohash_map::get_lock_stats. It adds the counts to every lock, so like
+//! LIBCUCKOO_RESIZE_STATS it must be set the same way in every translation
+//! unit that includes the table
+#ifndef LIBCUCKOO_LOCK_STATS
+#define LIBCUCKOO_LOCK_STATS 0
+#endif
+
 }  // namespace libcuckoo
 
 #endif // _CUCKOOHASH_CONFIG_HH
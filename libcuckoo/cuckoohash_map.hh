@@ -8,6 +8,7 @@
 #include <atomic>
 #include <bitset>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
@@ -27,6 +28,7 @@
 #include "cuckoohash_config.hh"
 #include "cuckoohash_util.hh"
 #include "bucket_container.hh"
+#include "inline_container.hh"
 
 namespace libcuckoo {
 
@@ -41,19 +43,43 @@ namespace libcuckoo {
  * because the table relies on types that are over-aligned to optimize
  * concurrent cache usage.
  * @tparam SLOT_PER_BUCKET number of slots for each bucket in the table
+ * @tparam EmptyKey no_empty_key, or an empty_key that reserves a key value to
+ * mark empty slots, which shrinks the buckets of tables with integral keys
+ * @tparam INLINE_SIZE the number of elements a table created for at most that
+ * many can store inside the table object, before it allocates any buckets or
+ * locks. 0, the default, disables inline storage.
  */
 template <class Key, class T, class Hash = std::hash<Key>,
           class KeyEqual = std::equal_to<Key>,
           class Allocator = std::allocator<std::pair<const Key, T>>,
-          std::size_t SLOT_PER_BUCKET = DEFAULT_SLOT_PER_BUCKET>
+          std::size_t SLOT_PER_BUCKET = DEFAULT_SLOT_PER_BUCKET,
+          class EmptyKey = no_empty_key, std::size_t INLINE_SIZE = 0>
 class cuckoohash_map {
 private:
-  // Type of the partial key
-  using partial_t = uint8_t;
+  // true if the key is small and simple, which means using partial keys for
+  // lookup would probably slow us down. Buckets with an empty key don't store
+  // partial keys, so they can't be used for lookup either.
+  static constexpr bool kIsSimple =
+      !std::is_same<EmptyKey, no_empty_key>::value ||
+      (std::is_pod<Key>::value && sizeof(Key) <= 8);
+
+  // Type of the partial key. Keys that aren't simple and own data outside the
+  // bucket, like strings, may have to read it whenever their partial keys
+  // match, so they get a wider partial key that matches by chance far less
+  // often. The buckets keep each slot's occupied flag in its top bit, so it
+  // takes up no more space than a byte-wide partial key and a separate flag.
+  // Trivial keys keep byte-wide partial keys, so that tables written with
+  // locked_table's operator<< keep their layout and bucket placement.
+  using partial_t =
+      typename std::conditional<kIsSimple || std::is_trivial<Key>::value,
+                                uint8_t, uint16_t>::type;
 
   // The type of the buckets container
-  using buckets_t =
-      bucket_container<Key, T, Allocator, partial_t, SLOT_PER_BUCKET>;
+  using buckets_t = bucket_container<Key, T, Allocator, partial_t,
+                                     SLOT_PER_BUCKET, EmptyKey>;
+
+  // The type of the container of elements stored inline
+  using inline_t = inline_container<Key, T, Allocator, INLINE_SIZE>;
 
 public:
   /** @name Type Declarations */
@@ -94,7 +120,13 @@ public:
   /**@{*/
 
   /**
-   * Creates a new cuckohash_map instance
+   * Creates a new cuckohash_map instance. The table starts with one lock per
+   * bucket, up to the maximum number of locks, and adds locks as it grows, so
+   * a table created with a small @p n, such as @ref SMALL_TABLE_SIZE, is cheap
+   * to create and hold in memory. This suits tables stored in large numbers,
+   * like the inner tables of a nested map. If @p n is at most @c INLINE_SIZE,
+   * the table allocates nothing at all, and stores its elements inline until
+   * it needs room for more of them.
    *
    * @param n the number of elements to reserve space for initially
    * @param hf hash function instance to use
@@ -104,17 +136,8 @@ public:
   cuckoohash_map(size_type n = DEFAULT_SIZE, const Hash &hf = Hash(),
                  const KeyEqual &equal = KeyEqual(),
                  const Allocator &alloc = Allocator())
-      : hash_fn_(hf), eq_fn_(equal),
-        buckets_(reserve_calc(n), alloc),
-        old_buckets_(0, alloc),
-        all_locks_(get_allocator()),
-        num_remaining_lazy_rehash_locks_(0),
-        minimum_load_factor_(DEFAULT_MINIMUM_LOAD_FACTOR),
-        maximum_hashpower_(NO_MAXIMUM_HASHPOWER),
-        max_num_worker_threads_(0) {
-    all_locks_.emplace_back(std::min(bucket_count(), size_type(kMaxNumLocks)),
-                            spinlock(), get_allocator());
-  }
+      : cuckoohash_map(n, hf, equal, alloc,
+                       INLINE_SIZE > 0 && n <= INLINE_SIZE) {}
 
   /**
    * Constructs the map with the contents of the range @c [first, last].  If
@@ -159,6 +182,7 @@ public:
         buckets_(other.buckets_, alloc),
         old_buckets_(other.old_buckets_, alloc),
         all_locks_(alloc),
+        inline_(other.inline_, alloc),
         num_remaining_lazy_rehash_locks_(
             other.num_remaining_lazy_rehash_locks_),
         minimum_load_factor_(other.minimum_load_factor_),
@@ -191,6 +215,7 @@ public:
         buckets_(std::move(other.buckets_), alloc),
         old_buckets_(std::move(other.old_buckets_), alloc),
         all_locks_(alloc),
+        inline_(std::move(other.inline_), alloc),
         num_remaining_lazy_rehash_locks_(
             other.num_remaining_lazy_rehash_locks_),
         minimum_load_factor_(other.minimum_load_factor_),
@@ -228,6 +253,7 @@ public:
     std::swap(eq_fn_, other.eq_fn_);
     buckets_.swap(other.buckets_);
     all_locks_.swap(other.all_locks_);
+    inline_.swap(other.inline_);
     other.minimum_load_factor_.store(
         minimum_load_factor_.exchange(other.minimum_load_factor(),
                                       std::memory_order_release),
@@ -306,18 +332,19 @@ public:
 
   /**
    * Returns the hashpower of the table, which is log<SUB>2</SUB>(@ref
-   * bucket_count()).
+   * bucket_count()), or 0 while the table stores its elements inline.
    *
    * @return the hashpower
    */
   size_type hashpower() const { return buckets_.hashpower(); }
 
   /**
-   * Returns the number of buckets in the table.
+   * Returns the number of buckets in the table, which is 0 while the table
+   * stores its elements inline.
    *
    * @return the bucket count
    */
-  size_type bucket_count() const { return buckets_.size(); }
+  size_type bucket_count() const { return is_inline() ? 0 : buckets_.size(); }
 
   /**
    * Returns whether the table is empty or not.
@@ -332,6 +359,9 @@ public:
    * @return number of elements in the table
    */
   size_type size() const {
+    if (is_inline()) {
+      return inline_.size();
+    }
     if (all_locks_.size() == 0) {
       return 0;
     }
@@ -344,11 +374,14 @@ public:
   }
 
   /** Returns the current capacity of the table, that is, @ref bucket_count()
-   * &times; @ref slot_per_bucket().
+   * &times; @ref slot_per_bucket(), or @c INLINE_SIZE while the table stores
+   * its elements inline.
    *
    * @return capacity of table
    */
-  size_type capacity() const { return bucket_count() * slot_per_bucket(); }
+  size_type capacity() const {
+    return is_inline() ? INLINE_SIZE : bucket_count() * slot_per_bucket();
+  }
 
   /**
    * Returns the percentage the table is filled, that is, @ref size() &divide;
@@ -441,6 +474,105 @@ public:
     return max_num_worker_threads_.load(std::memory_order_acquire);
   }
 
+#if LIBCUCKOO_RESIZE_STATS
+  /**
+   * How many times each phase of resizing the table has run, and the total
+   * time spent in it, in nanoseconds. Times are summed over all threads, so
+   * phases that run concurrently can add up to more than the wall-clock time.
+   */
+  struct resize_stats {
+    //! Taking all the locks of the table, for a resize, a locked_table, or
+    //! any other operation that needs exclusive access
+    size_type lock_all_count;
+    uint64_t lock_all_ns;
+    //! Doubling the table with lazy migration, including taking all the locks
+    size_type fast_double_count;
+    uint64_t fast_double_ns;
+    //! Resizing the table by inserting every element into a new table,
+    //! including taking all the locks
+    size_type expand_simple_count;
+    uint64_t expand_simple_ns;
+    //! Migrating the buckets of one lock into the new bucket array, done
+    //! lazily by other operations after a doubling
+    size_type lazy_rehash_count;
+    uint64_t lazy_rehash_ns;
+  };
+
+  /**
+   * Returns the statistics collected about resizing the table. Only available
+   * if @ref LIBCUCKOO_RESIZE_STATS is defined to 1 before the table is
+   * included, since timing the phases slows them down slightly, and the
+   * counters take up space in every table.
+   *
+   * @return the resize statistics
+   */
+  resize_stats get_resize_stats() const {
+    resize_stats stats;
+    stats.lock_all_count = resize_phases_.lock_all.count.load();
+    stats.lock_all_ns = resize_phases_.lock_all.ns.load();
+    stats.fast_double_count = resize_phases_.fast_double.count.load();
+    stats.fast_double_ns = resize_phases_.fast_double.ns.load();
+    stats.expand_simple_count = resize_phases_.expand_simple.count.load();
+    stats.expand_simple_ns = resize_phases_.expand_simple.ns.load();
+    stats.lazy_rehash_count = resize_phases_.lazy_rehash.count.load();
+    stats.lazy_rehash_ns = resize_phases_.lazy_rehash.ns.load();
+    return stats;
+  }
+
+  /**
+   * Resets all the resize statistics to 0.
+   */
+  void reset_resize_stats() { resize_phases_ = resize_phase_counters(); }
+#endif // LIBCUCKOO_RESIZE_STATS
+
+  /**
+   * How often the table's locks have been acquired by operations that wait
+   * for them, and how often they had to wait because another thread held
+   * the lock. A high ratio of contended to total acquisitions means threads
+   * are spinning on each other, which a more even key distribution or fewer
+   * writers to the same keys would reduce.
+   */
+  struct lock_stats {
+    //! Lock acquisitions, summed over all the locks
+    size_type acquisitions;
+    //! Acquisitions that found the lock already held
+    size_type contended;
+  };
+
+  /**
+   * Returns the lock statistics, summed over all the locks. They are only
+   * collected if @ref LIBCUCKOO_LOCK_STATS is defined to 1 before the table
+   * is included, since counting slows down every lock acquisition slightly.
+   * Otherwise all the statistics are 0. The counts are read without taking
+   * the locks, so they may miss acquisitions that are in progress. The lock
+   * of a table that stores its elements inline isn't counted.
+   *
+   * @return the lock statistics
+   */
+  lock_stats get_lock_stats() const {
+    lock_stats stats = {0, 0};
+    if (is_inline()) {
+      return stats;
+    }
+    for (const spinlock &lock : get_current_locks()) {
+      stats.acquisitions += lock.acquisitions();
+      stats.contended += lock.contended();
+    }
+    return stats;
+  }
+
+  /**
+   * Resets all the lock statistics to 0.
+   */
+  void reset_lock_stats() {
+    if (is_inline()) {
+      return;
+    }
+    for (spinlock &lock : get_current_locks()) {
+      lock.reset_stats();
+    }
+  }
+
   /**@}*/
 
   /** @name Table Operations
@@ -463,6 +595,14 @@ public:
    * @return true if the key was found and functor invoked, false otherwise
    */
   template <typename K, typename F> bool find_fn(const K &key, F fn) const {
+    if (const InlineManager inline_manager = lock_inline()) {
+      const size_type i = inline_.find(key, eq_fn_);
+      if (i == inline_.size()) {
+        return false;
+      }
+      fn(inline_.mapped(i));
+      return true;
+    }
     const hash_value hv = hashed_key(key);
     const auto b = snapshot_and_lock_two<normal_mode>(hv);
     const table_position pos = cuckoo_find(key, hv.partial, b.i1, b.i2);
@@ -486,6 +626,14 @@ public:
    * @return true if the key was found and functor invoked, false otherwise
    */
   template <typename K, typename F> bool update_fn(const K &key, F fn) {
+    if (const InlineManager inline_manager = lock_inline()) {
+      const size_type i = inline_.find(key, eq_fn_);
+      if (i == inline_.size()) {
+        return false;
+      }
+      fn(inline_.mapped(i));
+      return true;
+    }
     const hash_value hv = hashed_key(key);
     const auto b = snapshot_and_lock_two<normal_mode>(hv);
     const table_position pos = cuckoo_find(key, hv.partial, b.i1, b.i2);
@@ -510,6 +658,16 @@ public:
    * @return true if @p key was found and @p fn invoked, false otherwise
    */
   template <typename K, typename F> bool erase_fn(const K &key, F fn) {
+    if (const InlineManager inline_manager = lock_inline()) {
+      const size_type i = inline_.find(key, eq_fn_);
+      if (i == inline_.size()) {
+        return false;
+      }
+      if (fn(inline_.mapped(i))) {
+        inline_.erase(i);
+      }
+      return true;
+    }
     const hash_value hv = hashed_key(key);
     const auto b = snapshot_and_lock_two<normal_mode>(hv);
     const table_position pos = cuckoo_find(key, hv.partial, b.i1, b.i2);
@@ -546,6 +704,24 @@ public:
    */
   template <typename K, typename F, typename... Args>
   bool uprase_fn(K &&key, F fn, Args &&... val) {
+    if (const InlineManager inline_manager = lock_inline()) {
+      if (is_empty_key(key, EmptyKey())) {
+        throw empty_key_inserted();
+      }
+      const size_type i = inline_.find(key, eq_fn_);
+      if (i != inline_.size()) {
+        if (fn(inline_.mapped(i))) {
+          inline_.erase(i);
+        }
+        return false;
+      } else if (i < INLINE_SIZE) {
+        inline_.emplace(std::forward<K>(key), std::forward<Args>(val)...);
+        return true;
+      }
+      // There's no room left, so we move the elements into buckets, and
+      // insert the key there once we've let go of the inline lock
+      promote_inline(promoted_hashpower());
+    }
     hash_value hv = hashed_key(key);
     auto b = snapshot_and_lock_two<normal_mode>(hv);
     table_position pos = cuckoo_insert_loop<normal_mode>(hv, b, key);
@@ -594,6 +770,13 @@ public:
    * @throw std::out_of_range if the key is not found
    */
   template <typename K> mapped_type find(const K &key) const {
+    if (const InlineManager inline_manager = lock_inline()) {
+      const size_type i = inline_.find(key, eq_fn_);
+      if (i == inline_.size()) {
+        throw std::out_of_range("key not found in table");
+      }
+      return inline_.mapped(i);
+    }
     const hash_value hv = hashed_key(key);
     const auto b = snapshot_and_lock_two<normal_mode>(hv);
     const table_position pos = cuckoo_find(key, hv.partial, b.i1, b.i2);
@@ -654,46 +837,172 @@ public:
    * Resizes the table to the given hashpower. If this hashpower is not larger
    * than the current hashpower, then it decreases the hashpower to the
    * maximum of the specified value and the smallest hashpower that can hold
-   * all the elements currently in the table.
+   * all the elements currently in the table. A table that stores its
+   * elements inline moves them into buckets of the given hashpower.
    *
    * @param n the hashpower to set for the table
    * @return true if the table changed size, false otherwise
    */
-  bool rehash(size_type n) { return cuckoo_rehash<normal_mode>(n); }
+  bool rehash(size_type n) {
+    if (leave_inline(n)) {
+      return true;
+    }
+    return cuckoo_rehash<normal_mode>(n);
+  }
 
   /**
    * Reserve enough space in the table for the given number of elements. If
    * the table can already hold that many elements, the function will shrink
    * the table to the smallest hashpower that can hold the maximum of the
-   * specified amount and the current table size.
+   * specified amount and the current table size. A table that stores its
+   * elements inline keeps them there if @p n of them fit, and otherwise moves
+   * them into buckets with room for @p n elements.
    *
    * @param n the number of elements to reserve space for
    * @return true if the size of the table changed, false otherwise
    */
-  bool reserve(size_type n) { return cuckoo_reserve<normal_mode>(n); }
+  bool reserve(size_type n) {
+    if (n <= INLINE_SIZE && is_inline()) {
+      return false;
+    }
+    if (leave_inline(reserve_calc(n))) {
+      return true;
+    }
+    return cuckoo_reserve<normal_mode>(n);
+  }
+
+  /**
+   * Invokes @p fn on every element in the table, without locking the whole
+   * table. The table is scanned one lock stripe at a time, so other threads
+   * can keep operating on the rest of the table, and only block when they
+   * need the stripe being scanned. Elements inserted or erased concurrently
+   * may or may not be seen.
+   *
+   * Concurrent inserts can move elements along cuckoo paths, from a stripe
+   * that hasn't been scanned yet to one that has, or the other way around, so
+   * the scan may miss such an element or see it twice. If the scan returns
+   * true, no element moved between stripes during it, and every element that
+   * stayed in the table for the whole scan was seen exactly once. Otherwise
+   * the scan was only best-effort, and may be retried, for example once
+   * writers are quiet. Moves are counted in the locks of the stripes
+   * involved, which the move already holds, so writers don't share a
+   * counter.
+   *
+   * A resize needs every lock, so it can only happen between stripes. If the
+   * table is resized during the scan, the scan stops, since the remaining
+   * stripes no longer hold the elements they did when it started.
+   *
+   * A table that stores its elements inline is scanned all at once, under its
+   * single lock, and the scan always returns true.
+   *
+   * @tparam F type of the functor. It should implement the method
+   * <tt>void operator()(const key_type&, mapped_type&)</tt>. It may modify
+   * the mapped value, but must not call any other function of the table.
+   * @param fn the functor to invoke on each element
+   * @return true if every stripe was scanned and no element moved between
+   * stripes, false if the table was resized or elements were moved during the
+   * scan
+   */
+  template <typename F> bool for_each(F fn) {
+    if (const InlineManager inline_manager = lock_inline()) {
+      for (size_type i = 0; i < inline_.size(); ++i) {
+        fn(inline_.key(i), inline_.mapped(i));
+      }
+      return true;
+    }
+    // A move between stripes is counted in both of them, under both of their
+    // locks. An element can only be missed or seen twice if it moved into or
+    // out of a stripe after that stripe was scanned, which the stripe's count
+    // shows, and the move is visible by the time a later stripe's lock has
+    // been taken. So we add up each stripe's count as we scan it, and compare
+    // with the total once we're done. The counts only grow, and a resize
+    // leaves the scanned lock array as it was.
+    const size_type hp = hashpower();
+    const locks_t &locks = get_current_locks();
+    const size_type num_stripes = locks.size();
+    size_type scanned_moves = 0;
+    for (size_type l = 0; l < num_stripes; ++l) {
+      LockManager lock_manager;
+      try {
+        lock_manager = lock_one(hp, l, normal_mode());
+      } catch (hashpower_changed &) {
+        return false;
+      }
+      scanned_moves += locks[l].moves();
+      for (size_type i = l; i < hashsize(hp); i += kMaxNumLocks) {
+        bucket &b = buckets_[i];
+        for (size_type slot = 0; slot < slot_per_bucket(); ++slot) {
+          if (b.occupied(slot)) {
+            fn(b.key(slot), b.mapped(slot));
+          }
+        }
+      }
+    }
+    size_type moves = 0;
+    for (const spinlock &lock : locks) {
+      moves += lock.moves();
+    }
+    return moves == scanned_moves;
+  }
 
   /**
    * Removes all elements in the table, calling their destructors.
    */
   void clear() {
+    if (const InlineManager inline_manager = lock_inline()) {
+      inline_.clear();
+      return;
+    }
     auto all_locks_manager = lock_all(normal_mode());
     cuckoo_clear();
   }
 
   /**
    * Construct a @ref locked_table object that owns all the locks in the
-   * table.
+   * table. The locked table works on buckets, so a table that stores its
+   * elements inline moves them into buckets first, for good. Use @ref
+   * for_each to visit the elements of a small table without doing so.
    *
    * @return a \ref locked_table instance
    */
-  locked_table lock_table() { return locked_table(*this); }
+  locked_table lock_table() {
+    leave_inline(promoted_hashpower());
+    return locked_table(*this);
+  }
 
   /**@}*/
 
 private:
   // Constructor helpers
 
+  // Creates a table that stores its elements inline if `store_inline` is
+  // true, and in buckets with room for `n` elements otherwise. Tables that are
+  // built up internally use buckets however small they are, so that their
+  // buckets can be taken over.
+  cuckoohash_map(size_type n, const Hash &hf, const KeyEqual &equal,
+                 const Allocator &alloc, bool store_inline)
+      : hash_fn_(hf), eq_fn_(equal),
+        buckets_(store_inline ? buckets_t(alloc)
+                              : buckets_t(reserve_calc(n), alloc)),
+        old_buckets_(alloc),
+        all_locks_(get_allocator()),
+        inline_(alloc, store_inline),
+        num_remaining_lazy_rehash_locks_(0),
+        minimum_load_factor_(DEFAULT_MINIMUM_LOAD_FACTOR),
+        maximum_hashpower_(NO_MAXIMUM_HASHPOWER),
+        max_num_worker_threads_(0) {
+    if (!store_inline) {
+      all_locks_.emplace_back(
+          std::min(bucket_count(), size_type(kMaxNumLocks)), spinlock(),
+          get_allocator());
+    }
+  }
+
   void add_locks_from_other(const cuckoohash_map &other) {
+    // A table that stores its elements inline has no locks yet
+    if (other.all_locks_.empty()) {
+      return;
+    }
     locks_t &other_locks = other.get_current_locks();
     all_locks_.emplace_back(other_locks.size(), spinlock(), get_allocator());
     std::copy(other_locks.begin(), other_locks.end(),
@@ -702,10 +1011,16 @@ private:
 
   // Hashing types and functions
 
-  // true if the key is small and simple, which means using partial keys for
-  // lookup would probably slow us down
-  static constexpr bool is_simple() {
-    return std::is_pod<key_type>::value && sizeof(key_type) <= 8;
+  // true if the key is small and simple, see kIsSimple
+  static constexpr bool is_simple() { return kIsSimple; }
+
+  // true if `key` is the key reserved to mark empty slots
+  template <typename K> bool is_empty_key(const K &, no_empty_key) const {
+    return false;
+  }
+  template <typename K, typename EK>
+  bool is_empty_key(const K &key, EK) const {
+    return key_eq()(static_cast<key_type>(EK::value), key);
   }
 
   // Whether or not the data is nothrow-move-constructible.
@@ -753,6 +1068,10 @@ private:
                                  static_cast<uint32_t>(hash_64bit >> 32));
     const uint16_t hash_16bit = (static_cast<uint16_t>(hash_32bit) ^
                                  static_cast<uint16_t>(hash_32bit >> 16));
+    if (sizeof(partial_t) == sizeof(uint16_t)) {
+      // The top bit is reserved for the bucket's occupied flag
+      return static_cast<partial_t>(hash_16bit & 0x7fff);
+    }
     const uint8_t hash_8bit = (static_cast<uint8_t>(hash_16bit) ^
                                static_cast<uint8_t>(hash_16bit >> 8));
     return hash_8bit;
@@ -772,8 +1091,14 @@ private:
   static inline size_type alt_index(const size_type hp, const partial_t partial,
                                     const size_type index) {
     // ensure tag is nonzero for the multiply. 0xc6a4a7935bd1e995 is the
-    // hash constant from 64-bit MurmurHash2
-    const size_type nonzero_tag = static_cast<size_type>(partial) + 1;
+    // hash constant from 64-bit MurmurHash2. Adding one to a 15-bit partial
+    // key can give a multiple of the table size, which would make the
+    // alternate bucket the same as the first, so wider partial keys are
+    // made odd instead. Byte-wide partial keys keep the original formula,
+    // which bucket placement in saved tables depends on.
+    const size_type nonzero_tag =
+        sizeof(partial_t) == 1 ? static_cast<size_type>(partial) + 1
+                               : (static_cast<size_type>(partial) << 1) | 1;
     return (index ^ (nonzero_tag * 0xc6a4a7935bd1e995)) & hashmask(hp);
   }
 
@@ -800,23 +1125,44 @@ private:
   LIBCUCKOO_SQUELCH_PADDING_WARNING
   class LIBCUCKOO_ALIGNAS(64) spinlock {
   public:
-    spinlock() : elem_counter_(0), is_migrated_(true) { lock_.clear(); }
+    spinlock() : elem_counter_(0), is_migrated_(true), moves_(0) {
+      lock_.clear();
+    }
 
     spinlock(const spinlock &other) noexcept
         : elem_counter_(other.elem_counter()),
-          is_migrated_(other.is_migrated()) {
+          is_migrated_(other.is_migrated()), moves_(other.moves()) {
       lock_.clear();
+      copy_stats(other);
     }
 
     spinlock &operator=(const spinlock &other) noexcept {
       elem_counter() = other.elem_counter();
       is_migrated() = other.is_migrated();
+      moves_.store(other.moves(), std::memory_order_relaxed);
+      copy_stats(other);
       return *this;
     }
 
     void lock() noexcept {
+#if LIBCUCKOO_LOCK_STATS
+      const bool contended = lock_.test_and_set(std::memory_order_acq_rel);
+      if (contended) {
+        while (lock_.test_and_set(std::memory_order_acq_rel))
+          ;
+      }
+      // Only the lock holder updates the counts, so they don't need to be
+      // atomic increments
+      acquisitions_.store(acquisitions_.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+      if (contended) {
+        contended_.store(contended_.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+      }
+#else
       while (lock_.test_and_set(std::memory_order_acq_rel))
         ;
+#endif
     }
 
     void unlock() noexcept { lock_.clear(std::memory_order_release); }
@@ -831,10 +1177,54 @@ private:
     bool &is_migrated() noexcept { return is_migrated_; }
     bool is_migrated() const noexcept { return is_migrated_; }
 
+    // The number of elements moved into or out of this lock's stripe along
+    // cuckoo paths. It's only incremented by the lock holder, but for_each
+    // reads it without the lock.
+    size_type moves() const noexcept {
+      return moves_.load(std::memory_order_relaxed);
+    }
+    void count_move() noexcept {
+      moves_.store(moves_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+    }
+
+#if LIBCUCKOO_LOCK_STATS
+    size_type acquisitions() const noexcept {
+      return acquisitions_.load(std::memory_order_relaxed);
+    }
+    size_type contended() const noexcept {
+      return contended_.load(std::memory_order_relaxed);
+    }
+    void reset_stats() noexcept {
+      acquisitions_.store(0, std::memory_order_relaxed);
+      contended_.store(0, std::memory_order_relaxed);
+    }
+#else
+    size_type acquisitions() const noexcept { return 0; }
+    size_type contended() const noexcept { return 0; }
+    void reset_stats() noexcept {}
+#endif
+
   private:
+#if LIBCUCKOO_LOCK_STATS
+    void copy_stats(const spinlock &other) noexcept {
+      acquisitions_.store(other.acquisitions(), std::memory_order_relaxed);
+      contended_.store(other.contended(), std::memory_order_relaxed);
+    }
+#else
+    void copy_stats(const spinlock &) noexcept {}
+#endif
+
     std::atomic_flag lock_;
     counter_type elem_counter_;
     bool is_migrated_;
+    std::atomic<size_type> moves_;
+#if LIBCUCKOO_LOCK_STATS
+    // The number of times the lock was acquired with lock(), and the number of
+    // those times it was already held by another thread
+    std::atomic<size_type> acquisitions_{0};
+    std::atomic<size_type> contended_{0};
+#endif
   };
 
   template <typename U>
@@ -940,6 +1330,10 @@ private:
     assert(locks.size() == kMaxNumLocks);
     assert(old_buckets_.hashpower() + 1 == buckets_.hashpower());
     assert(old_buckets_.size() >= kMaxNumLocks);
+    // Only time lazy migrations, since the others are part of a resize
+#if LIBCUCKOO_RESIZE_STATS
+    resize_phase_timer timer(resize_phases_.lazy_rehash, IS_LAZY);
+#endif
     // Iterate through all buckets in old_buckets that are controlled by this
     // lock, and move them into the current buckets array.
     for (size_type bucket_ind = l; bucket_ind < old_buckets_.size();
@@ -1072,6 +1466,9 @@ private:
   }
 
   AllLocksManager lock_all(normal_mode) {
+#if LIBCUCKOO_RESIZE_STATS
+    resize_phase_timer timer(resize_phases_.lock_all);
+#endif
     // all_locks_ should never decrease in size, so if it is non-empty now, it
     // will remain non-empty
     assert(!all_locks_.empty());
@@ -1168,9 +1565,14 @@ private:
    * In either case, the locks will still be held after the function ends.
    * @throw load_factor_too_low if expansion is necessary, but the
    * load factor of the table is below the threshold
+   * @throw empty_key_inserted if the key is the one reserved to mark empty
+   * slots
    */
   template <typename TABLE_MODE, typename K>
   table_position cuckoo_insert_loop(hash_value hv, TwoBuckets &b, K &key) {
+    if (is_empty_key(key, EmptyKey())) {
+      throw empty_key_inserted();
+    }
     table_position pos;
     while (true) {
       const size_type hp = hashpower();
@@ -1233,6 +1635,14 @@ private:
       return table_position{b.i2, static_cast<size_type>(res2), ok};
     }
 
+    // A table with a single bucket has nowhere to move elements to, so
+    // cuckooing can't free up a slot. Small tables hit this on every resize
+    // while they grow, so we skip the search.
+    if (hashpower() == 0) {
+      b.unlock();
+      return table_position{0, 0, failure_table_full};
+    }
+
     // We are unlucky, so let's perform cuckoo hashing.
     size_type insert_bucket = 0;
     size_type insert_slot = 0;
@@ -1446,6 +1856,19 @@ private:
     return x.depth;
   }
 
+  // Counts a move between two buckets in both of their lock stripes, for
+  // for_each. Must be called with both buckets locked. A move within one
+  // stripe can't hide an element from a scan, so it isn't counted.
+  void count_move(size_type from, size_type to) {
+    const size_type from_lock = lock_ind(from);
+    const size_type to_lock = lock_ind(to);
+    if (from_lock != to_lock) {
+      locks_t &locks = get_current_locks();
+      locks[from_lock].count_move();
+      locks[to_lock].count_move();
+    }
+  }
+
   // cuckoopath_move moves keys along the given cuckoo path in order to make
   // an empty slot in one of the buckets in cuckoo_insert. Before the start of
   // this function, the two insert-locked buckets were unlocked in run_cuckoo.
@@ -1513,6 +1936,7 @@ private:
       buckets_.setKV(to.bucket, ts, fb.partial(fs), fb.movable_key(fs),
                      std::move(fb.mapped(fs)));
       buckets_.eraseKV(from.bucket, fs);
+      count_move(from.bucket, to.bucket);
       if (depth == 1) {
         // Hold onto the locks contained in twob
         b = std::move(twob);
@@ -1634,7 +2058,11 @@ private:
         // If x has less than the maximum number of path components,
         // create a new b_slot item, that represents the bucket we would
         // have come from if we kicked out the item at this slot.
-        const partial_t partial = b.partial(slot);
+        // Buckets with an empty key don't store partial keys, so we have to
+        // hash the key again
+        const partial_t partial = buckets_t::has_empty_key()
+                                      ? hashed_key(b.key(slot)).partial
+                                      : b.partial(slot);
         if (x.depth < MAX_BFS_PATH_LEN - 1) {
           assert(!q.full());
           b_slot y(alt_index(hp, partial, x.bucket),
@@ -1659,6 +2087,9 @@ private:
                           " pair is not nothrow move constructible");
       return cuckoo_expand_simple<TABLE_MODE, AUTO_RESIZE>(current_hp + 1);
     }
+#if LIBCUCKOO_RESIZE_STATS
+    resize_phase_timer timer(resize_phases_.fast_double);
+#endif
     const size_type new_hp = current_hp + 1;
     auto all_locks_manager = lock_all(TABLE_MODE());
     cuckoo_status st = check_resize_validity<AUTO_RESIZE>(current_hp, new_hp);
@@ -1839,6 +2270,9 @@ private:
   // maximum hashpower, and we have an actual limit.
   template <typename TABLE_MODE, typename AUTO_RESIZE>
   cuckoo_status cuckoo_expand_simple(size_type new_hp) {
+#if LIBCUCKOO_RESIZE_STATS
+    resize_phase_timer timer(resize_phases_.expand_simple);
+#endif
     auto all_locks_manager = lock_all(TABLE_MODE());
     const size_type hp = hashpower();
     cuckoo_status st = check_resize_validity<AUTO_RESIZE>(hp, new_hp);
@@ -1853,7 +2287,7 @@ private:
     // from buckets_ and old_buckets_. Allow this map to spawn extra threads if
     // it needs to resize during the resize.
     cuckoohash_map new_map(hashsize(new_hp) * slot_per_bucket(),
-                           hash_function(), key_eq(), get_allocator());
+                           hash_function(), key_eq(), get_allocator(), false);
     new_map.max_num_worker_threads(max_num_worker_threads());
 
     parallel_exec(
@@ -1975,6 +2409,96 @@ private:
     }
   }
 
+  // Inline storage functions
+
+  // true if the table stores its elements inline. Once they have been moved
+  // into buckets, the table uses those for good, so a false result can be
+  // relied on without taking any locks.
+  bool is_inline() const { return INLINE_SIZE > 0 && inline_.active(); }
+
+  struct InlineUnlocker {
+    void operator()(inline_t *ic) const { ic->unlock(); }
+  };
+
+  using InlineManager = std::unique_ptr<inline_t, InlineUnlocker>;
+
+  // Takes the lock on the inline storage, if the table stores its elements
+  // there. Returns an empty manager, without the lock, if the elements are in
+  // buckets, which they may have been moved into while we waited for the
+  // lock.
+  InlineManager lock_inline() const {
+    if (!is_inline()) {
+      return InlineManager();
+    }
+    inline_.lock();
+    if (!inline_.active()) {
+      inline_.unlock();
+      return InlineManager();
+    }
+    return InlineManager(&inline_);
+  }
+
+  // The hashpower of the buckets that the elements stored inline are moved
+  // into when there's no room left for more, which fit twice as many
+  static size_type promoted_hashpower() {
+    return reserve_calc(2 * INLINE_SIZE);
+  }
+
+  // If the table stores its elements inline, moves them into buckets with
+  // hashpower `hp`, and returns true
+  bool leave_inline(size_type hp) {
+    if (const InlineManager inline_manager = lock_inline()) {
+      promote_inline(hp);
+      return true;
+    }
+    return false;
+  }
+
+  // Moves the elements stored inline into buckets with hashpower `hp`, or
+  // more if they don't fit, and switches the table over to those buckets and
+  // their locks. The inline lock must be held, and the elements still stored
+  // there. The buckets are built up in a separate table, which resizes as it
+  // would if the elements were inserted into this one. If that throws, such
+  // as when the maximum hashpower is exceeded, the elements are moved back
+  // and the table is left as it was.
+  void promote_inline(size_type hp) {
+    hp = std::min(hp, maximum_hashpower());
+    cuckoohash_map new_map(hashsize(hp) * slot_per_bucket(), hash_function(),
+                           key_eq(), get_allocator(), false);
+    new_map.minimum_load_factor(minimum_load_factor());
+    new_map.maximum_hashpower(maximum_hashpower());
+    new_map.max_num_worker_threads(max_num_worker_threads());
+    try {
+      // The last element is only dropped once it has been inserted, so the
+      // one whose insert threw is still stored inline
+      while (inline_.size() > 0) {
+        const size_type last = inline_.size() - 1;
+        new_map.insert(inline_.movable_key(last),
+                       std::move(inline_.mapped(last)));
+        inline_.pop_back();
+      }
+    } catch (...) {
+      // Moving the elements can't throw, since inline storage requires them
+      // to be nothrow move constructible
+      new_map.rehash_with_workers();
+      for (size_type i = 0; i < new_map.bucket_count(); ++i) {
+        bucket &b = new_map.buckets_[i];
+        for (size_type slot = 0; slot < slot_per_bucket(); ++slot) {
+          if (b.occupied(slot)) {
+            inline_.emplace(b.movable_key(slot), std::move(b.mapped(slot)));
+          }
+        }
+      }
+      throw;
+    }
+    new_map.rehash_with_workers();
+    // Nobody else looks at the buckets or locks until they see the inline
+    // storage deactivated
+    buckets_.swap(new_map.buckets_);
+    all_locks_.swap(new_map.all_locks_);
+    inline_.deactivate();
+  }
+
   // Rehashing functions
 
   template <typename TABLE_MODE> bool cuckoo_rehash(size_type n) {
@@ -2010,6 +2534,9 @@ private:
   // This class is a friend for unit testing
   friend class UnitTestInternalAccess;
 
+  // This class is a friend for benchmarking internal functions
+  friend class MicroBenchmarkInternalAccess;
+
   static constexpr size_type kMaxNumLocks = 1UL << 16;
 
   locks_t &get_current_locks() const { return all_locks_.back(); }
@@ -2067,13 +2594,20 @@ private:
   // done looking at the memory. The back lock container in this list is
   // designated the "current" one, and is used by all operations taking locks.
   // This container can be modified if either it is empty (which should only
-  // occur during construction), or if the modifying thread has taken all the
-  // locks on the existing "current" container. In the latter case, a
-  // modification must take place before a modification to the hashpower, so
-  // that other threads can detect the change and adjust appropriately. Marked
-  // mutable so that const methods can access and take locks.
+  // occur during construction, or while the table stores its elements
+  // inline), or if the modifying thread has taken all the locks on the
+  // existing "current" container. In the latter case, a modification must
+  // take place before a modification to the hashpower, so that other threads
+  // can detect the change and adjust appropriately. Marked mutable so that
+  // const methods can access and take locks.
   mutable all_locks_t all_locks_;
 
+  // The elements of a table created for at most INLINE_SIZE of them, until
+  // it needs room for more, along with the lock that guards them. While they
+  // are stored here, buckets_ and all_locks_ are empty. Marked mutable so that
+  // const methods can take the lock.
+  mutable inline_t inline_;
+
   // A small wrapper around std::atomic to make it copyable for constructors.
   template <typename AtomicT>
   class CopyableAtomic : public std::atomic<AtomicT> {
@@ -2113,6 +2647,51 @@ private:
   // operations.
   CopyableAtomic<size_type> max_num_worker_threads_;
 
+#if LIBCUCKOO_RESIZE_STATS
+  // The number of times a phase of resizing has run, and the total time spent
+  // in it
+  struct resize_phase_counter {
+    resize_phase_counter() : count(0), ns(0) {}
+    CopyableAtomic<size_type> count;
+    CopyableAtomic<uint64_t> ns;
+  };
+
+  struct resize_phase_counters {
+    resize_phase_counter lock_all;
+    resize_phase_counter fast_double;
+    resize_phase_counter expand_simple;
+    resize_phase_counter lazy_rehash;
+  };
+
+  // Adds the time from its construction to its destruction to a counter, if
+  // `enabled` is true
+  class resize_phase_timer {
+  public:
+    resize_phase_timer(resize_phase_counter &counter, bool enabled = true)
+        : counter_(enabled ? &counter : nullptr),
+          start_(std::chrono::steady_clock::now()) {}
+
+    ~resize_phase_timer() {
+      if (counter_ != nullptr) {
+        counter_->count.fetch_add(1, std::memory_order_relaxed);
+        counter_->ns.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_)
+                .count(),
+            std::memory_order_relaxed);
+      }
+    }
+
+  private:
+    resize_phase_counter *counter_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  // Statistics about resizing. Marked mutable so that they can be updated
+  // while lazily rehashing.
+  mutable resize_phase_counters resize_phases_;
+#endif // LIBCUCKOO_RESIZE_STATS
+
 public:
   /**
    * An ownership wrapper around a @ref cuckoohash_map table instance. When
@@ -2732,11 +3311,11 @@ public:
  * @param lhs the map on the right side to swap
  */
 template <class Key, class T, class Hash, class KeyEqual, class Allocator,
-          std::size_t SLOT_PER_BUCKET>
-void swap(
-    cuckoohash_map<Key, T, Hash, KeyEqual, Allocator, SLOT_PER_BUCKET> &lhs,
-    cuckoohash_map<Key, T, Hash, KeyEqual, Allocator, SLOT_PER_BUCKET>
-        &rhs) noexcept {
+          std::size_t SLOT_PER_BUCKET, class EmptyKey, std::size_t INLINE_SIZE>
+void swap(cuckoohash_map<Key, T, Hash, KeyEqual, Allocator, SLOT_PER_BUCKET,
+                         EmptyKey, INLINE_SIZE> &lhs,
+          cuckoohash_map<Key, T, Hash, KeyEqual, Allocator, SLOT_PER_BUCKET,
+                         EmptyKey, INLINE_SIZE> &rhs) noexcept {
   lhs.swap(rhs);
 }
 
@@ -0,0 +1,449 @@
+/** \file */
+
+#ifndef _CUCKOOHASH_SHARED_HH
+#define _CUCKOOHASH_SHARED_HH
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace libcuckoo {
+
+//! The default address that shared regions are mapped at. On 64-bit Linux it
+//! lies between where the heap and other mappings are usually placed, so it
+//! is usually free in every process.
+constexpr std::uintptr_t DEFAULT_SHARED_ADDRESS =
+    static_cast<std::uintptr_t>(sizeof(void *) == 8 ? 0x600000000000ULL
+                                                    : 0x60000000ULL);
+
+namespace shared_detail {
+
+constexpr uint64_t MAGIC = 0x6c6962637563636bULL;
+// Blocks are aligned to BLOCK_ALIGN, and preceded by a header of the same
+// size holding their size. Freed blocks of up to MAX_SMALL bytes are kept in
+// a list for their exact size, and larger ones in a single list that is
+// searched for the first block that is large enough.
+constexpr std::size_t BLOCK_ALIGN = 16;
+constexpr std::size_t MAX_SMALL = 4096;
+constexpr std::size_t NUM_SMALL = MAX_SMALL / BLOCK_ALIGN;
+
+struct free_block {
+  free_block *next;
+};
+
+// The first members of region_header, which a process reads to find out
+// where to map the region
+struct region_prefix {
+  uint64_t magic;
+  void *address;
+  std::size_t size;
+};
+
+// Lives at the start of the region. Since every process maps the region at
+// the same address, the region holds plain pointers into itself.
+struct region_header {
+  uint64_t magic;
+  void *address;
+  std::size_t size;
+  // Guards everything below, for every process
+  std::atomic_flag lock;
+  // The offset of the first byte not yet handed out
+  std::size_t used;
+  // The number of bytes in blocks that are allocated and not freed
+  std::size_t allocated;
+  free_block *small[NUM_SMALL];
+  free_block *large;
+  // The object constructed with shared_region::construct, or nullptr
+  std::atomic<void *> root;
+
+  void lock_region() {
+    while (lock.test_and_set(std::memory_order_acq_rel))
+      ;
+  }
+
+  void unlock_region() { lock.clear(std::memory_order_release); }
+};
+
+inline std::size_t round_up(std::size_t n, std::size_t align) {
+  return (n + align - 1) / align * align;
+}
+
+inline std::size_t &block_size(void *p) {
+  return *reinterpret_cast<std::size_t *>(static_cast<char *>(p) -
+                                          BLOCK_ALIGN);
+}
+
+inline void *allocate(region_header *h, std::size_t bytes, std::size_t align) {
+  const std::size_t size = round_up(bytes == 0 ? 1 : bytes, BLOCK_ALIGN);
+  align = align < BLOCK_ALIGN ? BLOCK_ALIGN : align;
+  h->lock_region();
+  void *p = nullptr;
+  if (size <= MAX_SMALL && align == BLOCK_ALIGN) {
+    free_block *&head = h->small[size / BLOCK_ALIGN - 1];
+    if (head != nullptr) {
+      p = head;
+      head = head->next;
+    }
+  } else {
+    for (free_block **b = &h->large; *b != nullptr; b = &(*b)->next) {
+      if (block_size(*b) >= size &&
+          reinterpret_cast<std::uintptr_t>(*b) % align == 0) {
+        p = *b;
+        *b = (*b)->next;
+        break;
+      }
+    }
+  }
+  if (p == nullptr) {
+    const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(h->address);
+    const std::uintptr_t start = round_up(base + h->used + BLOCK_ALIGN, align);
+    const std::size_t end = start + size - base;
+    if (end > h->size) {
+      h->unlock_region();
+      throw std::bad_alloc();
+    }
+    h->used = end;
+    p = reinterpret_cast<void *>(start);
+    block_size(p) = size;
+  }
+  h->allocated += block_size(p);
+  h->unlock_region();
+  return p;
+}
+
+inline void deallocate(region_header *h, void *p) {
+  free_block *b = static_cast<free_block *>(p);
+  const std::size_t size = block_size(p);
+  h->lock_region();
+  h->allocated -= size;
+  free_block *&head =
+      size <= MAX_SMALL ? h->small[size / BLOCK_ALIGN - 1] : h->large;
+  b->next = head;
+  head = b;
+  h->unlock_region();
+}
+
+inline std::system_error os_error(const std::string &what) {
+  return std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace shared_detail
+
+/**
+ * A region of POSIX shared memory that several processes map at the same
+ * address, so that a table placed in it, along with its buckets and locks,
+ * can be used by all of them. Since the table's locks are atomics in the
+ * region, processes insert, find and erase concurrently just as threads do.
+ * The region outlives the processes using it until it is removed, so a
+ * restarted process can open it and find the table as it was left.
+ *
+ * A table in the region must allocate from it, by using a @ref
+ * shared_allocator, and its keys and values must either be trivially
+ * copyable or allocate from the region too. Every process must use the same
+ * table type, compiled from the same code, so that they agree on its layout
+ * and hash function. A process that dies while holding a lock on the table
+ * leaves it locked.
+ *
+ * Memory freed in the region, such as the buckets a table discards when it
+ * grows, is kept for reuse by allocations of the same size, or for blocks of
+ * over 4 KiB, of any size that fits. Freed blocks are never coalesced or
+ * split, so tables should be created with the capacity they will need.
+ */
+class shared_region {
+public:
+  /**
+   * Creates a new shared memory object and maps it. It fails if an object
+   * with the same name exists.
+   *
+   * @param name the name of the object, as passed to @c shm_open, such as
+   * "/my_table"
+   * @param size the size of the region in bytes. Pages are only allocated as
+   * they are used.
+   * @param address the address to map the region at in every process
+   * @return the mapped region
+   * @throw std::system_error if the object can't be created or mapped at
+   * @p address
+   */
+  static shared_region create(const std::string &name, std::size_t size,
+                              std::uintptr_t address = DEFAULT_SHARED_ADDRESS) {
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      throw shared_detail::os_error("shm_open " + name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      const std::system_error error = shared_detail::os_error("ftruncate");
+      close(fd);
+      shm_unlink(name.c_str());
+      throw error;
+    }
+    shared_region region;
+    try {
+      region.map(fd, size, reinterpret_cast<void *>(address));
+    } catch (...) {
+      close(fd);
+      shm_unlink(name.c_str());
+      throw;
+    }
+    close(fd);
+    shared_detail::region_header *h = new (region.header_)
+        shared_detail::region_header;
+    h->address = region.header_;
+    h->size = size;
+    h->lock.clear();
+    h->used = shared_detail::round_up(sizeof(*h), shared_detail::BLOCK_ALIGN);
+    h->allocated = 0;
+    for (shared_detail::free_block *&head : h->small) {
+      head = nullptr;
+    }
+    h->large = nullptr;
+    h->root.store(nullptr, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    h->magic = shared_detail::MAGIC;
+    return region;
+  }
+
+  /**
+   * Maps an existing shared memory object, created with @ref create, at the
+   * address it was created with
+   *
+   * @param name the name the object was created with
+   * @return the mapped region
+   * @throw std::system_error if the object doesn't exist, isn't a region, or
+   * can't be mapped at its address
+   */
+  static shared_region open(const std::string &name) {
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+      throw shared_detail::os_error("shm_open " + name);
+    }
+    shared_detail::region_prefix h;
+    const ssize_t n = pread(fd, &h, sizeof(h), 0);
+    if (n != static_cast<ssize_t>(sizeof(h)) ||
+        h.magic != shared_detail::MAGIC) {
+      close(fd);
+      throw std::system_error(EINVAL, std::generic_category(),
+                              name + " is not a shared region");
+    }
+    shared_region region;
+    try {
+      region.map(fd, h.size, h.address);
+    } catch (...) {
+      close(fd);
+      throw;
+    }
+    close(fd);
+    return region;
+  }
+
+  /**
+   * Removes a shared memory object. Processes that have it mapped can still
+   * use it, and its memory is freed once they all unmap it.
+   *
+   * @param name the name the object was created with
+   * @return true if the object was removed, false if it didn't exist
+   */
+  static bool remove(const std::string &name) {
+    return shm_unlink(name.c_str()) == 0;
+  }
+
+  shared_region(shared_region &&other) noexcept
+      : header_(other.header_), size_(other.size_) {
+    other.header_ = nullptr;
+    other.size_ = 0;
+  }
+
+  shared_region &operator=(shared_region &&other) noexcept {
+    std::swap(header_, other.header_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  shared_region(const shared_region &) = delete;
+  shared_region &operator=(const shared_region &) = delete;
+
+  /**
+   * Unmaps the region, leaving its contents in place for other processes
+   */
+  ~shared_region() {
+    if (header_ != nullptr) {
+      munmap(header_, size_);
+    }
+  }
+
+  /**
+   * @return the address the region is mapped at
+   */
+  void *address() const { return header_; }
+
+  /**
+   * @return the size of the region in bytes
+   */
+  std::size_t size() const { return size_; }
+
+  /**
+   * @return the number of bytes in blocks allocated from the region and not
+   * yet freed
+   */
+  std::size_t allocated() const {
+    header_->lock_region();
+    const std::size_t allocated = header_->allocated;
+    header_->unlock_region();
+    return allocated;
+  }
+
+  /**
+   * Constructs the region's root object, the one that processes find with
+   * @ref root, such as a table. A table's allocator must be a @ref
+   * shared_allocator for this region, passed among @p args.
+   *
+   * @tparam T the type of the object
+   * @param args the arguments to construct it with
+   * @return a pointer to the object
+   * @throw std::bad_alloc if the region is full
+   * @throw std::logic_error if the region already has a root object
+   */
+  template <class T, class... Args> T *construct(Args &&... args) {
+    if (header_->root.load(std::memory_order_acquire) != nullptr) {
+      throw std::logic_error("Shared region already has a root object");
+    }
+    void *p = shared_detail::allocate(header_, sizeof(T), alignof(T));
+    T *object;
+    try {
+      object = new (p) T(std::forward<Args>(args)...);
+    } catch (...) {
+      shared_detail::deallocate(header_, p);
+      throw;
+    }
+    header_->root.store(object, std::memory_order_release);
+    return object;
+  }
+
+  /**
+   * @tparam T the type the root object was constructed with
+   * @return the root object, or nullptr if it hasn't been constructed
+   */
+  template <class T> T *root() const {
+    return static_cast<T *>(header_->root.load(std::memory_order_acquire));
+  }
+
+  /**
+   * Destroys the root object. No other process may be using it.
+   *
+   * @tparam T the type the root object was constructed with
+   */
+  template <class T> void destroy() {
+    T *object = root<T>();
+    if (object != nullptr) {
+      header_->root.store(nullptr, std::memory_order_release);
+      object->~T();
+      shared_detail::deallocate(header_, object);
+    }
+  }
+
+private:
+  template <class T> friend class shared_allocator;
+
+  shared_region() : header_(nullptr), size_(0) {}
+
+  void map(int fd, std::size_t size, void *address) {
+#ifdef MAP_FIXED_NOREPLACE
+    const int flags = MAP_SHARED | MAP_FIXED_NOREPLACE;
+#else
+    const int flags = MAP_SHARED;
+#endif
+    void *p = mmap(address, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (p == MAP_FAILED) {
+      throw shared_detail::os_error("mmap");
+    }
+    // Without MAP_FIXED_NOREPLACE, the address is only a hint
+    if (p != address) {
+      munmap(p, size);
+      throw std::system_error(EEXIST, std::generic_category(),
+                              "mmap at the region's address");
+    }
+    header_ = static_cast<shared_detail::region_header *>(p);
+    size_ = size;
+  }
+
+  shared_detail::region_header *header_;
+  std::size_t size_;
+};
+
+/**
+ * An allocator that allocates from a @ref shared_region, for a table in the
+ * region and for keys and values that allocate. It holds a plain pointer to
+ * the region, which is valid in every process that maps it.
+ *
+ * @tparam T the type of object allocated
+ */
+template <class T> class shared_allocator {
+public:
+  //! The type of object allocated
+  using value_type = T;
+
+  /**
+   * Constructs an allocator for a region
+   *
+   * @param region the region to allocate from
+   */
+  explicit shared_allocator(const shared_region &region) noexcept
+      : header_(region.header_) {}
+
+  /**
+   * Converting constructor, needed to rebind the allocator
+   */
+  template <class U>
+  shared_allocator(const shared_allocator<U> &other) noexcept
+      : header_(other.header_) {}
+
+  /**
+   * Allocates uninitialized space for @p n objects
+   *
+   * @param n the number of objects to allocate space for
+   * @return a pointer to the space
+   * @throw std::bad_alloc if the region is full
+   */
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(
+        shared_detail::allocate(header_, n * sizeof(T), alignof(T)));
+  }
+
+  /**
+   * Frees space returned by @ref allocate
+   *
+   * @param p the pointer returned by @ref allocate
+   */
+  void deallocate(T *p, std::size_t) noexcept {
+    shared_detail::deallocate(header_, p);
+  }
+
+  template <class U>
+  bool operator==(const shared_allocator<U> &other) const noexcept {
+    return header_ == other.header_;
+  }
+
+  template <class U>
+  bool operator!=(const shared_allocator<U> &other) const noexcept {
+    return header_ != other.header_;
+  }
+
+private:
+  template <class U> friend class shared_allocator;
+
+  shared_detail::region_header *header_;
+};
+
+} // namespace libcuckoo
+
+#endif // _CUCKOOHASH_SHARED_HH
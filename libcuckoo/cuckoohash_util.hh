@@ -4,6 +4,8 @@
 #define _CUCKOOHASH_UTIL_HH
 
 #include "cuckoohash_config.hh" // for LIBCUCKOO_DEBUG
+#include <cstdint>
+#include <cstring>
 #include <exception>
 #include <thread>
 #include <utility>
@@ -65,6 +67,77 @@ namespace libcuckoo {
 #define LIBCUCKOO_SQUELCH_DEADCODE_WARNING_END
 #endif
 
+/**
+ * Hashes @p len bytes at @p data, eight at a time. This is the hash used for
+ * keys that are hashed as raw bytes, such as the keys of C tables with no
+ * @c std::hash and the characters of @ref arena_string.
+ *
+ * @param data the bytes to hash
+ * @param len the number of bytes
+ * @return the hash of the bytes
+ */
+inline size_t bytes_hash(const void *data, size_t len) {
+  // Finalizes a 64-bit word so that every input bit affects every output bit
+  auto mix = [](uint64_t h) {
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93ULL;
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93ULL;
+    h ^= h >> 32;
+    return h;
+  };
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  uint64_t h = len * 0x9e3779b97f4a7c15ULL;
+  uint64_t word;
+  for (; len >= sizeof(word); len -= sizeof(word), p += sizeof(word)) {
+    std::memcpy(&word, p, sizeof(word));
+    h = (h ^ mix(word)) * 0x9e3779b97f4a7c15ULL;
+  }
+  if (len > 0) {
+    word = 0;
+    std::memcpy(&word, p, len);
+    h = (h ^ mix(word)) * 0x9e3779b97f4a7c15ULL;
+  }
+  return static_cast<size_t>(mix(h));
+}
+
+/**
+ * The default for the @c EmptyKey parameter of cuckoohash_map, which reserves
+ * no key value. Each bucket keeps track of which of its slots are occupied,
+ * along with a partial key for each slot.
+ */
+struct no_empty_key {};
+
+/**
+ * A value for the @c EmptyKey parameter of cuckoohash_map, which reserves the
+ * key @p EMPTY to mark empty slots, so that it can never be inserted into the
+ * table. The buckets then store nothing but keys and values, which makes them
+ * smaller and leaves lookups less to read. For example, each bucket of a
+ * table with 64-bit keys and values takes up 64 bytes instead of 72. This is
+ * only possible for keys of integral, enumeration or pointer type.
+ *
+ * @tparam Key type of keys in the table
+ * @tparam EMPTY the key value that marks empty slots
+ */
+template <class Key, Key EMPTY> struct empty_key {
+  //! The key value that marks empty slots
+  static constexpr Key value = EMPTY;
+};
+
+/**
+ * Thrown when inserting the key that a table reserves to mark empty slots,
+ * set with the @c EmptyKey parameter of cuckoohash_map.
+ */
+class empty_key_inserted : public std::exception {
+public:
+  /**
+   * @return a descriptive error message
+   */
+  virtual const char *what() const noexcept override {
+    return "Inserted the key reserved to mark empty slots";
+  }
+};
+
 /**
  * Thrown when an automatic expansion is triggered, but the load factor of the
  * table is below a minimum threshold, which can be set by the \ref
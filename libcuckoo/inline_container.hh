@@ -0,0 +1,259 @@
+#ifndef INLINE_CONTAINER_H
+#define INLINE_CONTAINER_H
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace libcuckoo {
+
+/**
+ * inline_container stores the key-value pairs of a small table inside the
+ * table object itself, so that the table allocates no buckets or locks until
+ * it outgrows it. It holds up to @p N pairs, packed at the front of its
+ * storage in no particular order, which are searched linearly. A single lock,
+ * taken with lock() and released with unlock(), guards them, and must be held
+ * to access them. The container also records whether the table still stores
+ * its elements in it, see active().
+ *
+ * @tparam Key type of keys in the table
+ * @tparam T type of values in the table
+ * @tparam Allocator type of key-value pair allocator
+ * @tparam N the maximum number of key-value pairs
+ */
+template <class Key, class T, class Allocator, std::size_t N>
+class inline_container {
+public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<const Key, T>;
+
+private:
+  using traits_ = typename std::allocator_traits<
+      Allocator>::template rebind_traits<value_type>;
+
+  // Like the buckets, we store pairs with a non-const key, so that the key can
+  // be moved out when the pairs are moved into buckets
+  using storage_value_type = std::pair<Key, T>;
+
+public:
+  using allocator_type = typename traits_::allocator_type;
+  using size_type = typename traits_::size_type;
+
+  // Pairs are moved around when others are erased, and when the table moves
+  // them into buckets, which must not fail halfway through
+  static_assert(N == 0 || (std::is_nothrow_move_constructible<Key>::value &&
+                           std::is_nothrow_move_constructible<T>::value),
+                "inline_container requires key and value to be nothrow move "
+                "constructible");
+
+  inline_container(const allocator_type &allocator, bool active)
+      : allocator_(allocator), active_(active), size_(0) {
+    lock_.clear();
+  }
+
+  ~inline_container() noexcept { clear(); }
+
+  inline_container(const inline_container &ic)
+      : inline_container(
+            traits_::select_on_container_copy_construction(ic.allocator_),
+            ic.active()) {
+    copy_from(ic);
+  }
+
+  inline_container(const inline_container &ic, const allocator_type &a)
+      : inline_container(a, ic.active()) {
+    copy_from(ic);
+  }
+
+  inline_container(inline_container &&ic) noexcept
+      : inline_container(ic.allocator_, ic.active()) {
+    move_from(ic);
+  }
+
+  inline_container(inline_container &&ic, const allocator_type &a) noexcept
+      : inline_container(a, ic.active()) {
+    move_from(ic);
+  }
+
+  inline_container &operator=(const inline_container &ic) {
+    if (this != &ic) {
+      clear();
+      copy_allocator(
+          ic.allocator_,
+          typename traits_::propagate_on_container_copy_assignment());
+      active_.store(ic.active(), std::memory_order_release);
+      copy_from(ic);
+    }
+    return *this;
+  }
+
+  inline_container &operator=(inline_container &&ic) noexcept {
+    if (this != &ic) {
+      clear();
+      copy_allocator(
+          ic.allocator_,
+          typename traits_::propagate_on_container_move_assignment());
+      active_.store(ic.active(), std::memory_order_release);
+      move_from(ic);
+    }
+    return *this;
+  }
+
+  // Each container keeps its own allocator unless the assignments propagate
+  // it, and the pairs are moved over one at a time
+  void swap(inline_container &ic) noexcept {
+    inline_container tmp(std::move(ic));
+    ic = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+  void lock() const noexcept {
+    while (lock_.test_and_set(std::memory_order_acq_rel))
+      ;
+  }
+
+  void unlock() const noexcept { lock_.clear(std::memory_order_release); }
+
+  // Whether the table stores its elements here. It's read without the lock,
+  // so that operations on a table that has moved its elements into buckets
+  // don't have to take it.
+  bool active() const noexcept {
+    return active_.load(std::memory_order_acquire);
+  }
+
+  // Marks the elements as moved into buckets. Anything the table did to set up
+  // the buckets beforehand is visible to threads that then see it inactive.
+  void deactivate() noexcept {
+    active_.store(false, std::memory_order_release);
+  }
+
+  // The number of pairs. It's only changed with the lock held, but can be read
+  // without it, like the element counters of the table's locks.
+  size_type size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  static constexpr size_type capacity() { return N; }
+
+  const key_type &key(size_type ind) const { return storage_kvpair(ind).first; }
+  key_type &&movable_key(size_type ind) {
+    return std::move(storage_kvpair(ind).first);
+  }
+
+  const mapped_type &mapped(size_type ind) const {
+    return storage_kvpair(ind).second;
+  }
+  mapped_type &mapped(size_type ind) { return storage_kvpair(ind).second; }
+
+  // Returns the index of the pair whose key compares equal to `key`, or size()
+  // if there is none
+  template <typename K, typename KeyEqual>
+  size_type find(const K &key, const KeyEqual &eq) const {
+    const size_type n = size();
+    for (size_type i = 0; i < n; ++i) {
+      if (eq(this->key(i), key)) {
+        return i;
+      }
+    }
+    return n;
+  }
+
+  // Constructs a pair after the last one. There must be room for it. If the
+  // constructor throws, the container is left as it was.
+  template <typename K, typename... Args> void emplace(K &&k, Args &&... args) {
+    const size_type ind = size();
+    assert(ind < N);
+    traits_::construct(allocator_, std::addressof(storage_kvpair(ind)),
+                       std::piecewise_construct,
+                       std::forward_as_tuple(std::forward<K>(k)),
+                       std::forward_as_tuple(std::forward<Args>(args)...));
+    size_.store(ind + 1, std::memory_order_relaxed);
+  }
+
+  // Destroys a pair, moving the last pair into its place
+  void erase(size_type ind) noexcept {
+    const size_type last = size() - 1;
+    assert(ind <= last);
+    traits_::destroy(allocator_, std::addressof(storage_kvpair(ind)));
+    if (ind != last) {
+      traits_::construct(allocator_, std::addressof(storage_kvpair(ind)),
+                         std::move(storage_kvpair(last)));
+      traits_::destroy(allocator_, std::addressof(storage_kvpair(last)));
+    }
+    size_.store(last, std::memory_order_relaxed);
+  }
+
+  // Destroys the last pair
+  void pop_back() noexcept {
+    const size_type last = size() - 1;
+    traits_::destroy(allocator_, std::addressof(storage_kvpair(last)));
+    size_.store(last, std::memory_order_relaxed);
+  }
+
+  // Destroys all the pairs
+  void clear() noexcept {
+    static_assert(
+        std::is_nothrow_destructible<key_type>::value &&
+            std::is_nothrow_destructible<mapped_type>::value,
+        "inline_container requires key and value to be nothrow "
+        "destructible");
+    while (size() > 0) {
+      pop_back();
+    }
+  }
+
+private:
+  // true here means the allocator from `src` is propagated
+  void copy_allocator(const allocator_type &src, std::true_type) {
+    allocator_ = src;
+  }
+
+  void copy_allocator(const allocator_type &, std::false_type) {}
+
+  // Copies the pairs of `ic` into this container, which must be empty
+  void copy_from(const inline_container &ic) {
+    for (size_type i = 0; i < ic.size(); ++i) {
+      emplace(ic.key(i), ic.mapped(i));
+    }
+  }
+
+  // Moves the pairs of `ic` into this container, which must be empty, and
+  // leaves `ic` empty
+  void move_from(inline_container &ic) noexcept {
+    for (size_type i = 0; i < ic.size(); ++i) {
+      emplace(ic.movable_key(i), std::move(ic.mapped(i)));
+    }
+    ic.clear();
+  }
+
+  const storage_value_type &storage_kvpair(size_type ind) const {
+    return *static_cast<const storage_value_type *>(
+        static_cast<const void *>(&values_[ind]));
+  }
+  storage_value_type &storage_kvpair(size_type ind) {
+    return *static_cast<storage_value_type *>(
+        static_cast<void *>(&values_[ind]));
+  }
+
+  // This allocator is only used to construct and destroy pairs
+  allocator_type allocator_;
+  // Guards the pairs. Marked mutable so that const operations of the table
+  // can take it.
+  mutable std::atomic_flag lock_;
+  std::atomic<bool> active_;
+  std::atomic<size_type> size_;
+  std::array<typename std::aligned_storage<sizeof(storage_value_type),
+                                           alignof(storage_value_type)>::type,
+             N>
+      values_;
+};
+
+}  // namespace libcuckoo
+
+#endif // INLINE_CONTAINER_H
@@ -0,0 +1,262 @@
+/* Times the operations that act on a whole table at once: acquiring a
+ * locked_table, iterating over it, writing a snapshot of it to a stream and
+ * loading one back, resizing it with rehash and reserve, and copying it. These
+ * bound how long maintenance jobs hold up the table, and aren't covered by
+ * the point-operation benchmarks. */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libcuckoo/cuckoohash_map.hh>
+#include <pcg/pcg_random.hpp>
+#include <test_util.hh>
+
+#include "micro_benchmark_util.hh"
+
+using Table = libcuckoo::cuckoohash_map<uint64_t, uint64_t>;
+
+// The number of bytes of keys and values in each element, used to compute
+// bandwidth
+constexpr size_t ELEMENT_BYTES = sizeof(uint64_t) + sizeof(uint64_t);
+
+// The number of times each benchmark is timed
+size_t g_repetitions = 10;
+// The percentage of slots filled in each table
+size_t g_load_factor = 90;
+// The seed for the random number generator, or 0 for a random seed
+size_t g_seed = 0;
+// The hashpowers of the benchmarked tables
+std::string g_hashpowers = "16,20,24";
+// The thread counts to benchmark with
+std::string g_threads = "1,2,4";
+// Only benchmarks whose name contains this string are run
+std::string g_filter = "";
+
+void print_header() {
+  std::printf("%-16s %9s %10s %7s %10s %10s %12s %8s\n", "benchmark",
+              "hashpower", "elements", "threads", "min ms", "median ms",
+              "Mitems/s", "GB/s");
+}
+
+// Prints a result. If `per_element` is true, the benchmark's operations are
+// the table's elements, and the rate at which they were processed is printed
+// too. Otherwise the benchmark timed a single operation on the whole table.
+void print_result(const MicroBenchmarkResult &result, size_t hashpower,
+                  size_t elements, size_t threads, bool per_element = true) {
+  if (result.name.empty()) {
+    return;
+  }
+  const size_t ops = per_element ? elements : 1;
+  const double min_ms = result.min_ns * ops / 1e6;
+  const double median_ms = result.median_ns * ops / 1e6;
+  std::printf("%-16s %9zu %10zu %7zu %10.3f %10.3f", result.name.c_str(),
+              hashpower, elements, threads, min_ms, median_ms);
+  if (per_element) {
+    std::printf(" %12.2f %8.3f\n", elements / median_ms / 1e3,
+                elements * ELEMENT_BYTES / median_ms / 1e6);
+  } else {
+    std::printf(" %12s %8s\n", "-", "-");
+  }
+  std::fflush(stdout);
+}
+
+// Looks up random keys in the table until stopped, to simulate the traffic a
+// maintenance operation has to wait for
+class BackgroundReaders {
+public:
+  BackgroundReaders(Table &table, const std::vector<uint64_t> &keys,
+                    size_t num_threads)
+      : done_(false) {
+    for (size_t i = 0; i < num_threads; ++i) {
+      threads_.emplace_back([this, &table, &keys, i]() {
+        pcg64_oneseq_once_insecure rng(g_seed + i);
+        std::uniform_int_distribution<size_t> index(0, keys.size() - 1);
+        uint64_t value;
+        while (!done_.load(std::memory_order_relaxed)) {
+          table.find(keys[index(rng)], value);
+        }
+      });
+    }
+  }
+
+  ~BackgroundReaders() {
+    done_.store(true, std::memory_order_relaxed);
+    for (std::thread &t : threads_) {
+      t.join();
+    }
+  }
+
+private:
+  std::atomic<bool> done_;
+  std::vector<std::thread> threads_;
+};
+
+// Benchmarks that don't use extra threads
+void benchmark_single_threaded(MicroBenchmarkRunner &runner, Table &table,
+                               size_t hashpower) {
+  const size_t elements = table.size();
+  std::unique_ptr<Table::locked_table> locked;
+  auto lock = [&]() {
+    locked.reset(new Table::locked_table(table.lock_table()));
+  };
+  auto unlock = [&]() { locked.reset(); };
+
+  print_result(runner.run("iterate", "", elements, lock,
+                          [&]() {
+                            uint64_t sum = 0;
+                            for (const auto &kv : *locked) {
+                              sum += kv.first ^ kv.second;
+                            }
+                            do_not_optimize(sum);
+                          },
+                          unlock),
+               hashpower, elements, 1);
+
+  // Snapshots go through locked_table's operator<< and operator>>, which
+  // write and read the bucket array in one block
+  std::stringstream snapshot;
+  print_result(runner.run("snapshot_write", "", elements,
+                          [&]() {
+                            lock();
+                            snapshot.str(std::string());
+                            snapshot.clear();
+                          },
+                          [&]() { snapshot << *locked; }, unlock),
+               hashpower, elements, 1);
+
+  // Loads a snapshot into a new table, as a restore from a snapshot would
+  if (runner.enabled("snapshot_read") && snapshot.str().empty()) {
+    auto lt = table.lock_table();
+    snapshot << lt;
+  }
+  std::unique_ptr<Table> loaded;
+  std::unique_ptr<Table::locked_table> loaded_locked;
+  print_result(runner.run("snapshot_read", "", elements,
+                          [&]() {
+                            loaded.reset(
+                                new Table(libcuckoo::SMALL_TABLE_SIZE));
+                            loaded_locked.reset(new Table::locked_table(
+                                loaded->lock_table()));
+                            snapshot.clear();
+                            snapshot.seekg(0);
+                          },
+                          [&]() { snapshot >> *loaded_locked; },
+                          [&]() {
+                            ASSERT_EQ(loaded_locked->size(), elements);
+                            loaded_locked.reset();
+                            loaded.reset();
+                          }),
+               hashpower, elements, 1);
+
+  std::unique_ptr<Table> copy;
+  print_result(runner.run("copy", "", elements, []() {},
+                          [&]() { copy.reset(new Table(table)); },
+                          [&]() { copy.reset(); }),
+               hashpower, elements, 1);
+}
+
+// Benchmarks whose behavior depends on the number of threads: acquiring the
+// locked_table while other threads are reading, and resizing with worker
+// threads
+void benchmark_multi_threaded(MicroBenchmarkRunner &runner, Table &table,
+                              const std::vector<uint64_t> &keys,
+                              size_t hashpower, size_t threads) {
+  const size_t elements = table.size();
+  {
+    // Acquiring the locked_table is a single operation rather than one per
+    // element, so only its time is reported
+    BackgroundReaders readers(table, keys, threads - 1);
+    std::unique_ptr<Table::locked_table> locked;
+    print_result(
+        runner.run("lock_table", "", 1, []() {},
+                   [&]() {
+                     locked.reset(new Table::locked_table(table.lock_table()));
+                   },
+                   [&]() { locked.reset(); }),
+        hashpower, elements, threads, false);
+  }
+
+  std::unique_ptr<Table> copy;
+  auto make_copy = [&]() {
+    copy.reset(new Table(table));
+    copy->max_num_worker_threads(threads - 1);
+  };
+  auto destroy_copy = [&]() { copy.reset(); };
+  print_result(runner.run("rehash", "", elements, make_copy,
+                          [&]() { copy->rehash(hashpower + 1); },
+                          destroy_copy),
+               hashpower, elements, threads);
+  print_result(runner.run("reserve", "", elements, make_copy,
+                          [&]() { copy->reserve(2 * copy->capacity()); },
+                          destroy_copy),
+               hashpower, elements, threads);
+}
+
+int main(int argc, char **argv) {
+  try {
+    const char *args[] = {"--repetitions", "--load-factor", "--seed"};
+    size_t *arg_vars[] = {&g_repetitions, &g_load_factor, &g_seed};
+    const char *arg_descriptions[] = {
+        "Number of timed repetitions of each benchmark",
+        "Percentage of slots filled in each table",
+        "Seed for the random number generator, or 0 for a random seed"};
+    const char *str_args[] = {"--hashpowers", "--threads", "--filter"};
+    std::string *str_arg_vars[] = {&g_hashpowers, &g_threads, &g_filter};
+    const char *str_arg_descriptions[] = {
+        "Comma-separated hashpowers of the benchmarked tables",
+        "Comma-separated thread counts to benchmark with",
+        "Only run benchmarks whose name contains this string"};
+    parse_flags(argc, argv, "Times operations on entire tables", args,
+                arg_vars, arg_descriptions, sizeof(args) / sizeof(const char *),
+                nullptr, nullptr, nullptr, 0, str_args, str_arg_vars,
+                str_arg_descriptions, sizeof(str_args) / sizeof(const char *));
+    if (g_load_factor == 0 || g_load_factor > 95) {
+      throw std::runtime_error("Load factor must be between 1 and 95\n");
+    }
+    const std::vector<size_t> hashpowers = parse_counts(g_hashpowers);
+    const std::vector<size_t> thread_counts = parse_counts(g_threads);
+    for (size_t threads : thread_counts) {
+      if (threads == 0) {
+        throw std::runtime_error("Thread counts must be positive\n");
+      }
+    }
+
+    if (g_seed == 0) {
+      g_seed = std::random_device()();
+    }
+    pcg64_oneseq_once_insecure rng(g_seed);
+    MicroBenchmarkRunner runner(g_repetitions, g_filter, false);
+    std::cout << "seed: " << g_seed << ", load factor: " << g_load_factor
+              << "%" << std::endl;
+    print_header();
+    for (size_t hashpower : hashpowers) {
+      const size_t slots = (size_t(1) << hashpower) * Table::slot_per_bucket();
+      Table table(slots);
+      std::vector<uint64_t> keys;
+      keys.reserve(slots * g_load_factor / 100);
+      while (keys.size() < slots * g_load_factor / 100) {
+        const uint64_t key = rng();
+        if (table.insert(key, key)) {
+          keys.push_back(key);
+        }
+      }
+      benchmark_single_threaded(runner, table, hashpower);
+      for (size_t threads : thread_counts) {
+        benchmark_multi_threaded(runner, table, keys, hashpower, threads);
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    std::exit(1);
+  }
+  return main_return_value;
+}
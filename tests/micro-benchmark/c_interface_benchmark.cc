@@ -0,0 +1,366 @@
+/* Measures the overhead of the C interface over the C++ table. The same keys
+ * are looked up in, and inserted into, a C++ table and a C table of the same
+ * types and size, and the difference in time per operation is the cost of
+ * calling through the C interface: an out-of-line call into another
+ * translation unit, passing keys and values by pointer, and, for the _fn
+ * variants, a call through a function pointer. The batch functions show how
+ * much of that is recovered by making one call for many keys. It also times
+ * saving and loading the C table, and reports their throughput in MB/s. */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <libcuckoo/cuckoohash_map.hh>
+#include <pcg/pcg_random.hpp>
+#include <test_util.hh>
+
+#include "micro_benchmark_util.hh"
+
+extern "C" {
+#include "u64_u64_table.h"
+}
+
+using Table = libcuckoo::cuckoohash_map<uint64_t, uint64_t>;
+
+// The number of times each benchmark is timed
+size_t g_repetitions = 10;
+// The number of operations timed in each repetition
+size_t g_ops = 1UL << 20;
+// The percentage of slots filled in each table
+size_t g_load_factor = 90;
+// The number of keys passed to each call of the batch functions
+size_t g_batch = 64;
+// The seed for the random number generator, or 0 for a random seed
+size_t g_seed = 0;
+// The hashpowers of the benchmarked tables
+std::string g_hashpowers = "12,22";
+// The thread counts to load tables with, where 0 is one per hardware thread
+std::string g_read_threads = "1,0";
+// Only benchmarks whose name contains this string are run
+std::string g_filter = "";
+
+void c_find_fn(const uint64_t *value, void *ctx) {
+  *static_cast<uint64_t *>(ctx) += *value;
+}
+
+// Holds a C++ table and a C table with the same contents
+class TablePair {
+public:
+  TablePair(size_t hashpower, pcg64_oneseq_once_insecure &rng)
+      : slots_((size_t(1) << hashpower) * Table::slot_per_bucket()),
+        cpp_(slots_), c_(u64_u64_table_init(slots_)) {
+    if (c_ == NULL) {
+      throw std::runtime_error("Failed to allocate the C table\n");
+    }
+    const size_t elems = slots_ * g_load_factor / 100;
+    keys_.reserve(elems);
+    while (keys_.size() < elems) {
+      const uint64_t key = rng();
+      if (cpp_.insert(key, key)) {
+        ASSERT_TRUE(u64_u64_table_insert(c_, &key, &key));
+        keys_.push_back(key);
+      }
+    }
+  }
+
+  ~TablePair() { u64_u64_table_free(c_); }
+
+  size_t slots() const { return slots_; }
+
+  size_t elements() const { return keys_.size(); }
+
+  Table &cpp() { return cpp_; }
+
+  u64_u64_table *c() { return c_; }
+
+  // Returns `n` random keys that are in the tables
+  std::vector<uint64_t> hits(size_t n, pcg64_oneseq_once_insecure &rng) const {
+    std::vector<uint64_t> result(n);
+    std::uniform_int_distribution<size_t> index(0, keys_.size() - 1);
+    for (uint64_t &key : result) {
+      key = keys_[index(rng)];
+    }
+    return result;
+  }
+
+  // Returns `n` distinct random keys that aren't in the tables
+  std::vector<uint64_t> misses(size_t n,
+                               pcg64_oneseq_once_insecure &rng) const {
+    std::vector<uint64_t> result;
+    result.reserve(n);
+    Table seen(n);
+    while (result.size() < n) {
+      const uint64_t key = rng();
+      if (!cpp_.contains(key) && seen.insert(key, key)) {
+        result.push_back(key);
+      }
+    }
+    return result;
+  }
+
+private:
+  const size_t slots_;
+  Table cpp_;
+  u64_u64_table *c_;
+  std::vector<uint64_t> keys_;
+};
+
+void benchmark_lookups(MicroBenchmarkRunner &runner, const std::string &size,
+                       TablePair &tables, pcg64_oneseq_once_insecure &rng) {
+  Table &cpp = tables.cpp();
+  u64_u64_table *c = tables.c();
+  // Cycle through enough keys to touch every bucket several times
+  const size_t n = std::min(g_ops, std::max<size_t>(4096, 2 * tables.slots()));
+  const std::vector<uint64_t> hits = tables.hits(n, rng);
+  const std::vector<uint64_t> misses = tables.misses(n, rng);
+
+  auto cpp_find = [&](const std::vector<uint64_t> &keys, bool expected) {
+    return [&cpp, &keys, n, expected]() {
+      size_t found = 0;
+      uint64_t value;
+      for (size_t i = 0; i < g_ops; ++i) {
+        found += cpp.find(keys[i % n], value);
+      }
+      ASSERT_EQ(found, expected ? g_ops : 0);
+    };
+  };
+  auto c_find = [&](const std::vector<uint64_t> &keys, bool expected) {
+    return [c, &keys, n, expected]() {
+      size_t found = 0;
+      uint64_t value;
+      for (size_t i = 0; i < g_ops; ++i) {
+        found += u64_u64_table_find(c, &keys[i % n], &value);
+      }
+      ASSERT_EQ(found, expected ? g_ops : 0);
+    };
+  };
+  runner.run("cpp_find_hit", size, g_ops, cpp_find(hits, true));
+  runner.run("c_find_hit", size, g_ops, c_find(hits, true));
+  runner.run("cpp_find_miss", size, g_ops, cpp_find(misses, false));
+  runner.run("c_find_miss", size, g_ops, c_find(misses, false));
+
+  runner.run("cpp_find_fn_hit", size, g_ops, [&]() {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < g_ops; ++i) {
+      cpp.find_fn(hits[i % n], [&sum](const uint64_t &v) { sum += v; });
+    }
+    do_not_optimize(sum);
+  });
+  runner.run("c_find_fn_ctx_hit", size, g_ops, [&]() {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < g_ops; ++i) {
+      u64_u64_table_find_fn_ctx(c, &hits[i % n], c_find_fn, &sum);
+    }
+    do_not_optimize(sum);
+  });
+
+  // Batches never wrap around the end of the key array
+  const size_t batch = std::min(g_batch, n);
+  const size_t batch_ops = g_ops / batch * batch;
+  std::vector<uint64_t> values(batch);
+  runner.run("c_find_batch_hit", size, batch_ops, [&]() {
+    size_t found = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < batch_ops; i += batch) {
+      if (start + batch > n) {
+        start = 0;
+      }
+      found += u64_u64_table_find_batch(c, &hits[start], batch, values.data(),
+                                        NULL);
+      start += batch;
+    }
+    ASSERT_EQ(found, batch_ops);
+  });
+}
+
+void benchmark_inserts(MicroBenchmarkRunner &runner, const std::string &size,
+                       TablePair &tables, pcg64_oneseq_once_insecure &rng) {
+  Table &cpp = tables.cpp();
+  u64_u64_table *c = tables.c();
+  // Inserting raises the load factor by one percentage point, so that the
+  // table doesn't fill up, and each repetition erases the keys it inserted
+  const size_t n = std::max<size_t>(tables.slots() / 100, 1);
+  const std::vector<uint64_t> keys = tables.misses(n, rng);
+  const size_t batch = std::min(g_batch, n);
+
+  runner.run("cpp_insert", size, n, []() {},
+             [&]() {
+               for (size_t i = 0; i < n; ++i) {
+                 cpp.insert(keys[i], keys[i]);
+               }
+             },
+             [&]() {
+               for (uint64_t key : keys) {
+                 ASSERT_TRUE(cpp.erase(key));
+               }
+             });
+  runner.run("c_insert", size, n, []() {},
+             [&]() {
+               for (size_t i = 0; i < n; ++i) {
+                 u64_u64_table_insert(c, &keys[i], &keys[i]);
+               }
+             },
+             [&]() {
+               for (const uint64_t &key : keys) {
+                 ASSERT_TRUE(u64_u64_table_erase(c, &key));
+               }
+             });
+  runner.run("c_insert_batch", size, n, []() {},
+             [&]() {
+               for (size_t i = 0; i < n; i += batch) {
+                 const size_t count = std::min(batch, n - i);
+                 u64_u64_table_insert_batch(c, &keys[i], &keys[i], count,
+                                            NULL);
+               }
+             },
+             [&]() {
+               for (const uint64_t &key : keys) {
+                 ASSERT_TRUE(u64_u64_table_erase(c, &key));
+               }
+             });
+}
+
+// The number of bytes each element takes up in a file written by the C table
+constexpr size_t RECORD_BYTES = sizeof(uint64_t) + sizeof(uint64_t);
+
+void benchmark_files(MicroBenchmarkRunner &runner, const std::string &size,
+                     TablePair &tables,
+                     const std::vector<size_t> &read_threads) {
+  u64_u64_table *c = tables.c();
+  const size_t n = tables.elements();
+  FILE *fp = std::tmpfile();
+  if (fp == NULL) {
+    throw std::runtime_error("Failed to create a temporary file\n");
+  }
+  runner.run("c_write", size, n, [&]() { std::rewind(fp); },
+             [&]() {
+               u64_u64_table_locked_table *ltbl = u64_u64_table_lock_table(c);
+               ASSERT_TRUE(u64_u64_table_locked_table_write(ltbl, fp));
+               std::fflush(fp);
+               u64_u64_table_locked_table_free(ltbl);
+             },
+             []() {});
+  for (size_t threads : read_threads) {
+    u64_u64_table *loaded = NULL;
+    runner.run("c_read_threads=" + std::to_string(threads), size, n,
+               [&]() { std::rewind(fp); },
+               [&]() { loaded = u64_u64_table_read_parallel(fp, threads); },
+               [&]() {
+                 ASSERT_TRUE(loaded != NULL);
+                 ASSERT_EQ(u64_u64_table_size(loaded), n);
+                 u64_u64_table_free(loaded);
+               });
+  }
+  std::fclose(fp);
+}
+
+// Prints the rate at which the file benchmarks moved data, in MB/s of the
+// file
+void print_file_throughput(const std::vector<MicroBenchmarkResult> &results) {
+  std::printf("%-28s %10s %14s\n", "file throughput", "size", "MB/s");
+  for (const MicroBenchmarkResult &result : results) {
+    if (result.name.compare(0, 7, "c_read_") != 0 && result.name != "c_write") {
+      continue;
+    }
+    std::printf("%-28s %10s %14.1f\n", result.name.c_str(),
+                result.size.c_str(), RECORD_BYTES / result.median_ns * 1e3);
+  }
+}
+
+// Prints how much slower each C benchmark was than the C++ benchmark it's
+// compared against, by median time per operation
+void print_overheads(const std::vector<MicroBenchmarkResult> &results) {
+  const char *pairs[][2] = {
+      {"c_find_hit", "cpp_find_hit"},
+      {"c_find_miss", "cpp_find_miss"},
+      {"c_find_fn_ctx_hit", "cpp_find_fn_hit"},
+      {"c_find_batch_hit", "cpp_find_hit"},
+      {"c_insert", "cpp_insert"},
+      {"c_insert_batch", "cpp_insert"},
+  };
+  std::map<std::string, const MicroBenchmarkResult *> by_name;
+  for (const MicroBenchmarkResult &result : results) {
+    by_name[result.name + "/" + result.size] = &result;
+  }
+  std::printf("%-28s %10s %16s %14s\n", "overhead", "size", "vs",
+              "ns/op");
+  for (const MicroBenchmarkResult &result : results) {
+    for (const auto &pair : pairs) {
+      if (result.name != pair[0]) {
+        continue;
+      }
+      const auto base = by_name.find(std::string(pair[1]) + "/" + result.size);
+      if (base == by_name.end()) {
+        continue;
+      }
+      std::printf("%-28s %10s %16s %+14.2f\n", result.name.c_str(),
+                  result.size.c_str(), pair[1],
+                  result.median_ns - base->second->median_ns);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  try {
+    const char *args[] = {"--repetitions", "--ops", "--load-factor", "--batch",
+                          "--seed"};
+    size_t *arg_vars[] = {&g_repetitions, &g_ops, &g_load_factor, &g_batch,
+                          &g_seed};
+    const char *arg_descriptions[] = {
+        "Number of timed repetitions of each benchmark",
+        "Number of operations timed in each repetition",
+        "Percentage of slots filled in each table",
+        "Number of keys passed to each call of the batch functions",
+        "Seed for the random number generator, or 0 for a random seed"};
+    const char *str_args[] = {"--hashpowers", "--read-threads", "--filter"};
+    std::string *str_arg_vars[] = {&g_hashpowers, &g_read_threads, &g_filter};
+    const char *str_arg_descriptions[] = {
+        "Comma-separated hashpowers of the benchmarked tables",
+        "Comma-separated thread counts to load tables with, where 0 is one per "
+        "hardware thread",
+        "Only run benchmarks whose name contains this string"};
+    parse_flags(argc, argv,
+                "Compares the C interface against the C++ table it wraps",
+                args, arg_vars, arg_descriptions,
+                sizeof(args) / sizeof(const char *), nullptr, nullptr, nullptr,
+                0, str_args, str_arg_vars, str_arg_descriptions,
+                sizeof(str_args) / sizeof(const char *));
+    if (g_load_factor == 0 || g_load_factor > 95) {
+      throw std::runtime_error("Load factor must be between 1 and 95\n");
+    }
+    if (g_ops == 0 || g_batch == 0) {
+      throw std::runtime_error("Operations and batch size must be positive\n");
+    }
+    const std::vector<size_t> hashpowers = parse_counts(g_hashpowers);
+    const std::vector<size_t> read_threads = parse_counts(g_read_threads);
+
+    if (g_seed == 0) {
+      g_seed = std::random_device()();
+    }
+    pcg64_oneseq_once_insecure rng(g_seed);
+    MicroBenchmarkRunner runner(g_repetitions, g_filter);
+    std::cout << "seed: " << g_seed << ", load factor: " << g_load_factor
+              << "%, batch: " << g_batch << std::endl;
+    runner.print_header();
+    for (size_t hashpower : hashpowers) {
+      TablePair tables(hashpower, rng);
+      const std::string size = "hp=" + std::to_string(hashpower);
+      benchmark_lookups(runner, size, tables, rng);
+      benchmark_inserts(runner, size, tables, rng);
+      benchmark_files(runner, size, tables, read_threads);
+    }
+    print_overheads(runner.results());
+    print_file_throughput(runner.results());
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    std::exit(1);
+  }
+  return main_return_value;
+}
@@ -0,0 +1,392 @@
+/* Times the individual functions on the table's hot paths: hashing keys to
+ * buckets, searching buckets, searching for cuckoo paths, migrating buckets
+ * during a resize, and taking bucket locks, along with the public lookup and
+ * insert operations built on them. Tables are sized to fit in each level of
+ * the memory hierarchy, so that changes to these functions show up even when
+ * they're hidden by memory latency in end-to-end benchmarks. The lifecycle of
+ * small tables is timed separately. */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <libcuckoo/cuckoohash_map.hh>
+#include <pcg/pcg_random.hpp>
+#include <test_util.hh>
+
+#include "micro_benchmark_access.hh"
+#include "micro_benchmark_util.hh"
+
+using Table = libcuckoo::cuckoohash_map<uint64_t, uint64_t>;
+// A table that reserves a key to mark empty slots, so its buckets store no
+// occupancy flags or partial keys
+using EmptyKeyTable = libcuckoo::cuckoohash_map<
+    uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+    std::allocator<std::pair<const uint64_t, uint64_t>>,
+    libcuckoo::DEFAULT_SLOT_PER_BUCKET,
+    libcuckoo::empty_key<uint64_t, std::numeric_limits<uint64_t>::max()>>;
+using Access = libcuckoo::MicroBenchmarkInternalAccess;
+
+// The same table type as `Table`, but storing up to 16 elements inline
+template <class Table> struct WithInlineStorage;
+template <class Key, class T, class Hash, class KeyEqual, class Allocator,
+          size_t SLOT_PER_BUCKET, class EmptyKey, size_t INLINE_SIZE>
+struct WithInlineStorage<
+    libcuckoo::cuckoohash_map<Key, T, Hash, KeyEqual, Allocator,
+                              SLOT_PER_BUCKET, EmptyKey, INLINE_SIZE>> {
+  using type = libcuckoo::cuckoohash_map<Key, T, Hash, KeyEqual, Allocator,
+                                         SLOT_PER_BUCKET, EmptyKey, 16>;
+};
+
+// The number of times each benchmark is timed
+size_t g_repetitions = 10;
+// The number of operations timed in each repetition
+size_t g_ops = 1UL << 20;
+// The percentage of slots filled in each table
+size_t g_load_factor = 90;
+// The seed for the random number generator, or 0 for a random seed
+size_t g_seed = 0;
+// The sizes of the bucket arrays to benchmark, chosen to fit in L1, L2 and
+// the last-level cache, and to be much larger than any cache
+std::string g_sizes = "32K,1M,32M,512M";
+// Only benchmarks whose name contains this string are run
+std::string g_filter = "";
+// Whether to benchmark EmptyKeyTable rather than Table
+bool g_empty_key = false;
+
+// A table whose bucket array takes up at most a given number of bytes, filled
+// to the configured load factor with random keys
+template <class Table> class SizedTable {
+public:
+  using Probe = Access::probe<Table>;
+
+  SizedTable(size_t bytes, pcg64_oneseq_once_insecure &rng) {
+    const size_t buckets =
+        std::max<size_t>(bytes / Access::bucket_size<Table>(), 2);
+    size_t hashpower = 1;
+    while ((size_t(1) << (hashpower + 1)) <= buckets) {
+      ++hashpower;
+    }
+    const size_t slots = (size_t(1) << hashpower) * Table::slot_per_bucket();
+    table_.reset(new Table(slots));
+    const size_t elems = slots * g_load_factor / 100;
+    keys_.reserve(elems);
+    while (keys_.size() < elems) {
+      const uint64_t key = rng();
+      if (table_->insert(key, key)) {
+        keys_.push_back(key);
+      }
+    }
+  }
+
+  Table &table() { return *table_; }
+
+  const std::vector<uint64_t> &keys() const { return keys_; }
+
+  // Returns `n` random keys that are in the table
+  std::vector<uint64_t> hits(size_t n, pcg64_oneseq_once_insecure &rng) const {
+    std::vector<uint64_t> result(n);
+    std::uniform_int_distribution<size_t> index(0, keys_.size() - 1);
+    for (uint64_t &key : result) {
+      key = keys_[index(rng)];
+    }
+    return result;
+  }
+
+  // Returns `n` distinct random keys that aren't in the table
+  std::vector<uint64_t> misses(size_t n,
+                               pcg64_oneseq_once_insecure &rng) const {
+    std::vector<uint64_t> result;
+    result.reserve(n);
+    Table seen(n);
+    while (result.size() < n) {
+      const uint64_t key = rng();
+      if (!table_->contains(key) && seen.insert(key, key)) {
+        result.push_back(key);
+      }
+    }
+    return result;
+  }
+
+  std::vector<Probe> probes(const std::vector<uint64_t> &keys) const {
+    std::vector<Probe> result;
+    result.reserve(keys.size());
+    for (uint64_t key : keys) {
+      result.push_back(Access::make_probe(*table_, key));
+    }
+    return result;
+  }
+
+private:
+  std::unique_ptr<Table> table_;
+  std::vector<uint64_t> keys_;
+};
+
+// Benchmarks that take keys cycle through an array of random keys. The array
+// has enough keys to touch every bucket of the table several times, so that
+// the table isn't artificially kept in cache by probing the same few buckets,
+// but is no longer than necessary, so that it doesn't push the table out of
+// small caches.
+template <class Table> size_t num_probes(const Table &table) {
+  return std::min(g_ops, std::max<size_t>(4096, 8 * table.bucket_count()));
+}
+
+template <class Table>
+void benchmark_lookups(MicroBenchmarkRunner &runner, const std::string &size,
+                       SizedTable<Table> &sized,
+                       pcg64_oneseq_once_insecure &rng) {
+  using Probe = Access::probe<Table>;
+  Table &table = sized.table();
+  const size_t hp = table.hashpower();
+  const size_t n = num_probes(table);
+  const std::vector<Probe> hits = sized.probes(sized.hits(n, rng));
+  const std::vector<Probe> misses = sized.probes(sized.misses(n, rng));
+
+  runner.run("hash_to_buckets", size, g_ops, [&]() {
+    size_t sum = 0;
+    for (size_t i = 0; i < g_ops; ++i) {
+      const Probe &p = hits[i % n];
+      const std::pair<size_t, size_t> b = Access::buckets<Table>(
+          hp, p.hash, Access::partial_key<Table>(p.hash));
+      sum += b.first ^ b.second;
+    }
+    do_not_optimize(sum);
+  });
+
+  auto read_buckets = [&](const std::vector<Probe> &probes, bool expected) {
+    return [&table, &probes, hp, n, expected]() {
+      size_t found = 0;
+      for (size_t i = 0; i < g_ops; ++i) {
+        const Probe &p = probes[i % n];
+        const std::pair<size_t, size_t> b =
+            Access::buckets<Table>(hp, p.hash, p.partial);
+        found += Access::cuckoo_find(table, p, b.first, b.second);
+      }
+      ASSERT_EQ(found, expected ? g_ops : 0);
+    };
+  };
+  runner.run("try_read_from_bucket_hit", size, g_ops,
+             read_buckets(hits, true));
+  runner.run("try_read_from_bucket_miss", size, g_ops,
+             read_buckets(misses, false));
+
+  auto find = [&](const std::vector<Probe> &probes, bool expected) {
+    return [&table, &probes, n, expected]() {
+      size_t found = 0;
+      uint64_t value;
+      for (size_t i = 0; i < g_ops; ++i) {
+        found += table.find(probes[i % n].key, value);
+      }
+      ASSERT_EQ(found, expected ? g_ops : 0);
+    };
+  };
+  runner.run("find_hit", size, g_ops, find(hits, true));
+  runner.run("find_miss", size, g_ops, find(misses, false));
+
+  runner.run("lock_one", size, g_ops, [&]() {
+    for (size_t i = 0; i < g_ops; ++i) {
+      const Probe &p = hits[i % n];
+      Access::lock_one(table, hp, Access::buckets<Table>(hp, p.hash,
+                                                        p.partial).first);
+    }
+  });
+
+  runner.run("lock_two", size, g_ops, [&]() {
+    for (size_t i = 0; i < g_ops; ++i) {
+      const Probe &p = hits[i % n];
+      const std::pair<size_t, size_t> b =
+          Access::buckets<Table>(hp, p.hash, p.partial);
+      Access::lock_two(table, hp, b.first, b.second);
+    }
+  });
+}
+
+template <class Table>
+void benchmark_inserts(MicroBenchmarkRunner &runner, const std::string &size,
+                       SizedTable<Table> &sized,
+                       pcg64_oneseq_once_insecure &rng) {
+  using Probe = Access::probe<Table>;
+  Table &table = sized.table();
+  const size_t hp = table.hashpower();
+  const size_t n = num_probes(table);
+  const std::vector<Probe> misses = sized.probes(sized.misses(n, rng));
+
+  // The search for a free slot that an insert starts with
+  runner.run("try_find_insert_bucket", size, g_ops, [&]() {
+    size_t free = 0;
+    for (size_t i = 0; i < g_ops; ++i) {
+      const Probe &p = misses[i % n];
+      const std::pair<size_t, size_t> b =
+          Access::buckets<Table>(hp, p.hash, p.partial);
+      free += Access::try_find_insert_bucket(table, p, b.first) != -1 ||
+              Access::try_find_insert_bucket(table, p, b.second) != -1;
+    }
+    do_not_optimize(free);
+  });
+
+  // The breadth-first search for a cuckoo path, for keys whose buckets are
+  // both full, which is what an insert falls back to
+  std::vector<std::pair<size_t, size_t>> full;
+  for (const Probe &p : misses) {
+    const std::pair<size_t, size_t> b =
+        Access::buckets<Table>(hp, p.hash, p.partial);
+    if (Access::try_find_insert_bucket(table, p, b.first) == -1 &&
+        Access::try_find_insert_bucket(table, p, b.second) == -1) {
+      full.push_back(b);
+    }
+  }
+  if (!full.empty()) {
+    runner.run("slot_search", size, g_ops, [&]() {
+      int depth = 0;
+      for (size_t i = 0; i < g_ops; ++i) {
+        const std::pair<size_t, size_t> &b = full[i % full.size()];
+        depth += Access::slot_search(table, hp, b.first, b.second);
+      }
+      do_not_optimize(depth);
+    });
+  }
+
+  // Inserting enough keys to raise the load factor by one percentage point,
+  // which includes moving elements along cuckoo paths when both buckets are
+  // full. The keys are erased again after each repetition.
+  const size_t batch = std::min(
+      n, std::max<size_t>(1, table.bucket_count() * table.slot_per_bucket() /
+                                 100));
+  runner.run("insert", size, batch, []() {},
+             [&]() {
+               for (size_t i = 0; i < batch; ++i) {
+                 table.insert(misses[i].key, misses[i].key);
+               }
+             },
+             [&]() {
+               for (size_t i = 0; i < batch; ++i) {
+                 table.erase(misses[i].key);
+               }
+             });
+}
+
+template <class Table>
+void benchmark_migration(MicroBenchmarkRunner &runner, const std::string &size,
+                         SizedTable<Table> &sized) {
+  // Each repetition migrates a fresh copy of the table, since migrating the
+  // table doubles it
+  const size_t buckets = sized.table().bucket_count();
+  std::unique_ptr<Table> copy;
+  runner.run("move_bucket", size, buckets,
+             [&]() {
+               copy.reset(new Table(sized.table()));
+               ASSERT_EQ(Access::begin_migration(*copy), buckets);
+             },
+             [&]() {
+               for (size_t i = 0; i < buckets; ++i) {
+                 Access::move_bucket(*copy, i);
+               }
+             },
+             [&]() {
+               Access::finish_migration(*copy);
+               copy.reset();
+             });
+}
+
+// Creating a small table, filling it with a few keys and destroying it, as is
+// done with many short-lived tables or the inner tables of a nested map. The
+// table starts with a single bucket, or with its elements stored inline, so
+// filling it past that also times the resizes a small table goes through as
+// it grows.
+template <class Table>
+void benchmark_small_tables(MicroBenchmarkRunner &runner,
+                            const std::string &name,
+                            pcg64_oneseq_once_insecure &rng) {
+  const size_t tables = std::max<size_t>(1, g_ops / 64);
+  for (size_t elems : {size_t(4), size_t(16), size_t(64)}) {
+    std::vector<uint64_t> keys(elems);
+    for (uint64_t &key : keys) {
+      key = rng();
+    }
+    runner.run(name, "n=" + std::to_string(elems), tables, [&]() {
+      size_t total = 0;
+      for (size_t i = 0; i < tables; ++i) {
+        Table table(libcuckoo::SMALL_TABLE_SIZE);
+        for (uint64_t key : keys) {
+          table.insert(key, key);
+        }
+        total += table.size();
+      }
+      do_not_optimize(total);
+    });
+  }
+}
+
+template <class Table> void run_benchmarks(pcg64_oneseq_once_insecure &rng) {
+  MicroBenchmarkRunner runner(g_repetitions, g_filter);
+  std::cout << "seed: " << g_seed << ", load factor: " << g_load_factor
+            << "%, bucket size: " << Access::bucket_size<Table>() << " bytes"
+            << std::endl;
+  runner.print_header();
+  for (size_t bytes : parse_byte_sizes(g_sizes)) {
+    const std::string size = format_byte_size(bytes);
+    SizedTable<Table> sized(bytes, rng);
+    benchmark_lookups(runner, size, sized, rng);
+    benchmark_inserts(runner, size, sized, rng);
+    benchmark_migration(runner, size, sized);
+  }
+  benchmark_small_tables<Table>(runner, "small_table", rng);
+  benchmark_small_tables<typename WithInlineStorage<Table>::type>(
+      runner, "inline_table", rng);
+}
+
+int main(int argc, char **argv) {
+  try {
+    const char *args[] = {"--repetitions", "--ops", "--load-factor", "--seed"};
+    size_t *arg_vars[] = {&g_repetitions, &g_ops, &g_load_factor, &g_seed};
+    const char *arg_descriptions[] = {
+        "Number of timed repetitions of each benchmark",
+        "Number of operations timed in each repetition",
+        "Percentage of slots filled in each table",
+        "Seed for the random number generator, or 0 for a random seed"};
+    const char *flags[] = {"--empty-key"};
+    bool *flag_vars[] = {&g_empty_key};
+    const char *flag_descriptions[] = {
+        "Benchmark a table that reserves a key to mark empty slots"};
+    const char *str_args[] = {"--sizes", "--filter"};
+    std::string *str_arg_vars[] = {&g_sizes, &g_filter};
+    const char *str_arg_descriptions[] = {
+        "Comma-separated sizes of the bucket arrays of the benchmarked "
+        "tables, with an optional K, M or G suffix",
+        "Only run benchmarks whose name contains this string"};
+    parse_flags(argc, argv, "Times the table's internal functions", args,
+                arg_vars, arg_descriptions, sizeof(args) / sizeof(const char *),
+                flags, flag_vars, flag_descriptions,
+                sizeof(flags) / sizeof(const char *), str_args, str_arg_vars,
+                str_arg_descriptions, sizeof(str_args) / sizeof(const char *));
+    if (g_load_factor == 0 || g_load_factor > 95) {
+      throw std::runtime_error("Load factor must be between 1 and 95\n");
+    }
+    if (g_ops == 0) {
+      throw std::runtime_error("Must time at least one operation\n");
+    }
+
+    if (g_seed == 0) {
+      g_seed = std::random_device()();
+    }
+    pcg64_oneseq_once_insecure rng(g_seed);
+    if (g_empty_key) {
+      run_benchmarks<EmptyKeyTable>(rng);
+    } else {
+      run_benchmarks<Table>(rng);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    std::exit(1);
+  }
+  return main_return_value;
+}
@@ -0,0 +1,131 @@
+#ifndef _MICRO_BENCHMARK_ACCESS_HH
+#define _MICRO_BENCHMARK_ACCESS_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <libcuckoo/cuckoohash_map.hh>
+
+// The micro benchmarks time private functions of the table, so they go through
+// this class, which is a friend of the table. None of these functions are
+// thread-safe unless the table function they call is.
+namespace libcuckoo {
+
+class MicroBenchmarkInternalAccess {
+public:
+  // A key along with its precomputed hash, so that benchmarks of functions
+  // that take a hash don't also time the hash function
+  template <class CuckoohashMap> struct probe {
+    typename CuckoohashMap::key_type key;
+    size_t hash;
+    typename CuckoohashMap::partial_t partial;
+  };
+
+  template <class CuckoohashMap>
+  static size_t bucket_size() {
+    return sizeof(typename CuckoohashMap::bucket);
+  }
+
+  template <class CuckoohashMap>
+  static probe<CuckoohashMap>
+  make_probe(const CuckoohashMap &table,
+             const typename CuckoohashMap::key_type &key) {
+    const auto hv = table.hashed_key(key);
+    return probe<CuckoohashMap>{key, hv.hash, hv.partial};
+  }
+
+  template <class CuckoohashMap>
+  static typename CuckoohashMap::partial_t partial_key(const size_t hash) {
+    return CuckoohashMap::partial_key(hash);
+  }
+
+  // Returns the two buckets a hash maps to
+  template <class CuckoohashMap>
+  static std::pair<size_t, size_t>
+  buckets(const size_t hashpower, const size_t hash,
+          const typename CuckoohashMap::partial_t partial) {
+    const size_t i1 = CuckoohashMap::index_hash(hashpower, hash);
+    return std::make_pair(i1,
+                          CuckoohashMap::alt_index(hashpower, partial, i1));
+  }
+
+  // Searches both buckets of the probe with `try_read_from_bucket`, without
+  // taking any locks
+  template <class CuckoohashMap>
+  static bool cuckoo_find(const CuckoohashMap &table,
+                          const probe<CuckoohashMap> &p, const size_t i1,
+                          const size_t i2) {
+    return table.cuckoo_find(p.key, p.partial, i1, i2).status ==
+           CuckoohashMap::ok;
+  }
+
+  // Searches one bucket for an empty slot, as an insert does before it
+  // resorts to cuckooing. Returns the free slot, or -1 if there is none or the
+  // key is already in the bucket.
+  template <class CuckoohashMap>
+  static int try_find_insert_bucket(const CuckoohashMap &table,
+                                    const probe<CuckoohashMap> &p,
+                                    const size_t i) {
+    int slot;
+    if (!table.try_find_insert_bucket(table.buckets_[i], slot, p.partial,
+                                      p.key)) {
+      return -1;
+    }
+    return slot;
+  }
+
+  // Runs the breadth-first search for a cuckoo path from the two buckets,
+  // without moving anything. Returns the depth of the path found, or -1.
+  template <class CuckoohashMap>
+  static int slot_search(CuckoohashMap &table, const size_t hashpower,
+                         const size_t i1, const size_t i2) {
+    return table
+        .template slot_search<typename CuckoohashMap::normal_mode>(hashpower,
+                                                                   i1, i2)
+        .depth;
+  }
+
+  // Takes and releases the lock on one bucket
+  template <class CuckoohashMap>
+  static void lock_one(const CuckoohashMap &table, const size_t hashpower,
+                       const size_t i) {
+    table.lock_one(hashpower, i, typename CuckoohashMap::normal_mode());
+  }
+
+  // Takes and releases the locks on two buckets
+  template <class CuckoohashMap>
+  static void lock_two(const CuckoohashMap &table, const size_t hashpower,
+                       const size_t i1, const size_t i2) {
+    table.lock_two(hashpower, i1, i2, typename CuckoohashMap::normal_mode());
+  }
+
+  // Sets up a doubling of the table the way `cuckoo_fast_double` does, moving
+  // the current buckets into the old container and allocating an empty
+  // container twice the size, but doesn't move any elements. Returns the
+  // number of buckets left to move with `move_bucket`.
+  template <class CuckoohashMap>
+  static size_t begin_migration(CuckoohashMap &table) {
+    const size_t new_hp = table.hashpower() + 1;
+    table.maybe_resize_locks(size_t(1) << new_hp);
+    table.old_buckets_.swap(table.buckets_);
+    table.buckets_ =
+        typename CuckoohashMap::buckets_t(new_hp, table.get_allocator());
+    return table.old_buckets_.size();
+  }
+
+  template <class CuckoohashMap>
+  static void move_bucket(CuckoohashMap &table, const size_t i) {
+    table.move_bucket(table.old_buckets_, table.buckets_, i);
+  }
+
+  // Frees the old container once every bucket has been moved
+  template <class CuckoohashMap>
+  static void finish_migration(CuckoohashMap &table) {
+    table.num_remaining_lazy_rehash_locks(0);
+  }
+};
+
+} // namespace libcuckoo
+
+#endif // _MICRO_BENCHMARK_ACCESS_HH
@@ -0,0 +1,249 @@
+#ifndef _MICRO_BENCHMARK_UTIL_HH
+#define _MICRO_BENCHMARK_UTIL_HH
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* A small harness for timing individual table functions. Each benchmark is run
+ * for a number of repetitions, each of which times a fixed number of
+ * operations, after one untimed warmup repetition. Per-repetition setup and
+ * teardown run outside of the timed region, so a benchmark can rebuild the
+ * state it destroys (e.g. a table it migrates). The harness reports the
+ * minimum, median, mean and standard deviation of the time per operation
+ * across repetitions, along with the median number of cycles per operation,
+ * and returns them so that callers can derive their own measures.
+ *
+ * Cycles are read from the CPU's timestamp counter (the TSC on x86, or the
+ * virtual counter on AArch64), which ticks at a constant rate rather than at
+ * the core's current frequency, so cycles per operation are only comparable
+ * between runs on the same machine. On other architectures, cycles aren't
+ * reported. */
+
+// Returns the current value of the CPU's cycle counter, or 0 if there isn't
+// one we can read
+inline uint64_t read_cycle_counter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t value;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+  return value;
+#else
+  return 0;
+#endif
+}
+
+// Prevents the compiler from optimizing away the computation of `value`
+template <typename T> inline void do_not_optimize(const T &value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  volatile const T *sink = &value;
+  (void)sink;
+#endif
+}
+
+// Statistics for one benchmark, over all of its timed repetitions
+struct MicroBenchmarkResult {
+  std::string name;
+  std::string size;
+  double min_ns;
+  double median_ns;
+  double mean_ns;
+  double stddev_ns;
+  double median_cycles;
+};
+
+class MicroBenchmarkRunner {
+public:
+  // Only benchmarks whose name contains `filter` are run. If `print` is false,
+  // results are only returned, and the caller prints them.
+  MicroBenchmarkRunner(size_t repetitions, const std::string &filter,
+                       bool print = true)
+      : repetitions_(repetitions), filter_(filter), print_(print) {
+    if (repetitions_ == 0) {
+      throw std::runtime_error("Must run at least one repetition\n");
+    }
+  }
+
+  bool enabled(const std::string &name) const {
+    return name.find(filter_) != std::string::npos;
+  }
+
+  // Runs a benchmark. `body` performs `ops` operations per call, and is the
+  // only part that is timed. `setup` and `teardown` are called before and
+  // after every call to `body`. If the benchmark is filtered out, the
+  // returned result has an empty name.
+  template <typename Setup, typename Body, typename Teardown>
+  MicroBenchmarkResult run(const std::string &name, const std::string &size,
+                           size_t ops, Setup setup, Body body,
+                           Teardown teardown) {
+    if (!enabled(name)) {
+      return MicroBenchmarkResult();
+    }
+    if (ops == 0) {
+      throw std::runtime_error("Benchmark `" + name + "` runs no operations\n");
+    }
+    std::vector<double> ns_per_op;
+    std::vector<double> cycles_per_op;
+    for (size_t rep = 0; rep <= repetitions_; ++rep) {
+      setup();
+      const uint64_t start_cycles = read_cycle_counter();
+      const auto start_time = std::chrono::steady_clock::now();
+      body();
+      const auto end_time = std::chrono::steady_clock::now();
+      const uint64_t end_cycles = read_cycle_counter();
+      teardown();
+      // The first repetition warms up the caches and branch predictors
+      if (rep == 0) {
+        continue;
+      }
+      ns_per_op.push_back(
+          std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(
+              end_time - start_time)
+              .count() /
+          ops);
+      cycles_per_op.push_back(static_cast<double>(end_cycles - start_cycles) /
+                              ops);
+    }
+
+    MicroBenchmarkResult result;
+    result.name = name;
+    result.size = size;
+    result.min_ns = *std::min_element(ns_per_op.begin(), ns_per_op.end());
+    result.median_ns = median(ns_per_op);
+    result.mean_ns = 0;
+    for (double ns : ns_per_op) {
+      result.mean_ns += ns;
+    }
+    result.mean_ns /= ns_per_op.size();
+    result.stddev_ns = 0;
+    for (double ns : ns_per_op) {
+      result.stddev_ns += (ns - result.mean_ns) * (ns - result.mean_ns);
+    }
+    result.stddev_ns = std::sqrt(result.stddev_ns / ns_per_op.size());
+    result.median_cycles = median(cycles_per_op);
+    if (print_) {
+      print(result);
+    }
+    results_.push_back(result);
+    return result;
+  }
+
+  // Runs a benchmark that needs no per-repetition setup or teardown
+  template <typename Body>
+  MicroBenchmarkResult run(const std::string &name, const std::string &size,
+                           size_t ops, Body body) {
+    return run(name, size, ops, []() {}, body, []() {});
+  }
+
+  void print_header() const {
+    std::printf("%-28s %10s %10s %10s %10s %10s %12s\n", "benchmark", "size",
+                "min ns/op", "median", "mean", "stddev", "cycles/op");
+  }
+
+  const std::vector<MicroBenchmarkResult> &results() const { return results_; }
+
+private:
+  static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    const size_t mid = values.size() / 2;
+    return values.size() % 2 == 1 ? values[mid]
+                                  : (values[mid - 1] + values[mid]) / 2;
+  }
+
+  static void print(const MicroBenchmarkResult &result) {
+    std::printf("%-28s %10s %10.2f %10.2f %10.2f %10.2f", result.name.c_str(),
+                result.size.c_str(), result.min_ns, result.median_ns,
+                result.mean_ns, result.stddev_ns);
+    if (read_cycle_counter() != 0) {
+      std::printf(" %12.1f\n", result.median_cycles);
+    } else {
+      std::printf(" %12s\n", "-");
+    }
+    std::fflush(stdout);
+  }
+
+  const size_t repetitions_;
+  const std::string filter_;
+  const bool print_;
+  std::vector<MicroBenchmarkResult> results_;
+};
+
+// Parses a size in bytes, with an optional K, M or G suffix
+inline size_t parse_byte_size(const std::string &str) {
+  char *end;
+  size_t size = std::strtoull(str.c_str(), &end, 10);
+  if (end == str.c_str()) {
+    throw std::runtime_error("Invalid size `" + str + "`\n");
+  }
+  const std::string suffix(end);
+  if (suffix == "K") {
+    size <<= 10;
+  } else if (suffix == "M") {
+    size <<= 20;
+  } else if (suffix == "G") {
+    size <<= 30;
+  } else if (!suffix.empty()) {
+    throw std::runtime_error("Invalid size `" + str + "`\n");
+  }
+  return size;
+}
+
+// Formats a size in bytes with the largest suffix that divides it
+inline std::string format_byte_size(size_t size) {
+  const char *suffixes[] = {"", "K", "M", "G"};
+  size_t i = 0;
+  while (i < 3 && size >= 1024 && size % 1024 == 0) {
+    size /= 1024;
+    ++i;
+  }
+  return std::to_string(size) + suffixes[i];
+}
+
+// Splits a comma-separated list, parsing each element with `parse`
+template <typename Parse>
+std::vector<size_t> parse_list(const std::string &str, Parse parse) {
+  std::vector<size_t> values;
+  size_t start = 0;
+  while (start <= str.size()) {
+    size_t end = str.find(',', start);
+    if (end == std::string::npos) {
+      end = str.size();
+    }
+    values.push_back(parse(str.substr(start, end - start)));
+    start = end + 1;
+  }
+  return values;
+}
+
+// Parses a comma-separated list of byte sizes
+inline std::vector<size_t> parse_byte_sizes(const std::string &str) {
+  return parse_list(str, parse_byte_size);
+}
+
+// Parses a comma-separated list of non-negative integers
+inline std::vector<size_t> parse_counts(const std::string &str) {
+  return parse_list(str, [](const std::string &count) {
+    char *end;
+    const size_t value = std::strtoull(count.c_str(), &end, 10);
+    if (end == count.c_str() || *end != '\0') {
+      throw std::runtime_error("Invalid number `" + count + "`\n");
+    }
+    return value;
+  });
+}
+
+#endif // _MICRO_BENCHMARK_UTIL_HH
@@ -0,0 +1,234 @@
+/* Times inserting, finding and erasing string keys and values, with the
+ * default allocator and with libcuckoo::arena_allocator, and counts the calls
+ * each makes to the system allocator. Every insert of a std::string key and
+ * value allocates twice while holding bucket locks, and every erase frees
+ * twice, so with many threads these calls contend in the allocator. */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libcuckoo/cuckoohash_arena.hh>
+#include <libcuckoo/cuckoohash_map.hh>
+#include <pcg/pcg_random.hpp>
+#include <test_util.hh>
+
+#include "micro_benchmark_util.hh"
+
+// The number of calls to the global operator new and operator delete made by
+// the current thread. Each benchmark thread adds its counts to shared totals
+// once it's done, so counting doesn't contend.
+thread_local size_t t_allocations = 0;
+thread_local size_t t_frees = 0;
+
+void *operator new(size_t size) {
+  ++t_allocations;
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  if (p != nullptr) {
+    ++t_frees;
+  }
+  std::free(p);
+}
+
+// The number of elements inserted, found and erased by each benchmark
+size_t g_elements = 1 << 20;
+// The length of each key and value, long enough by default that neither fits
+// in std::string's inline buffer
+size_t g_key_length = 32;
+size_t g_value_length = 64;
+// The number of times each benchmark is timed
+size_t g_repetitions = 5;
+// The seed for the random number generator, or 0 for a random seed
+size_t g_seed = 0;
+// The thread counts to benchmark with
+std::string g_threads = "1,2,4";
+// Only benchmarks whose name contains this string are run
+std::string g_filter = "";
+
+void print_header() {
+  std::printf("%-14s %7s %10s %10s %10s %10s %10s\n", "benchmark", "threads",
+              "min ms", "median ms", "Mops/s", "allocs/op", "frees/op");
+}
+
+// Calls to the system allocator made by a benchmark's threads
+struct AllocatorCalls {
+  size_t allocations;
+  size_t frees;
+};
+
+void print_result(const MicroBenchmarkResult &result, size_t threads,
+                  const AllocatorCalls &calls) {
+  if (result.name.empty()) {
+    return;
+  }
+  std::printf("%-14s %7zu %10.3f %10.3f %10.2f %10.3f %10.3f\n",
+              result.name.c_str(), threads, result.min_ns * g_elements / 1e6,
+              result.median_ns * g_elements / 1e6, 1e3 / result.median_ns,
+              static_cast<double>(calls.allocations) / g_elements,
+              static_cast<double>(calls.frees) / g_elements);
+  std::fflush(stdout);
+}
+
+// Runs `fn(begin, end)` on `threads` threads, splitting [0, g_elements)
+// between them, and returns the calls they made to the system allocator
+template <typename Fn> AllocatorCalls run_threads(size_t threads, Fn fn) {
+  std::atomic<size_t> allocations(0);
+  std::atomic<size_t> frees(0);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([&, i]() {
+      const size_t start_allocations = t_allocations;
+      const size_t start_frees = t_frees;
+      fn(g_elements * i / threads, g_elements * (i + 1) / threads);
+      allocations.fetch_add(t_allocations - start_allocations);
+      frees.fetch_add(t_frees - start_frees);
+    });
+  }
+  for (std::thread &t : workers) {
+    t.join();
+  }
+  return AllocatorCalls{allocations.load(), frees.load()};
+}
+
+// Benchmarks a table of String keys and values. The keys and values are
+// generated as std::string ahead of time, and each operation constructs the
+// String it needs from them, as a caller reading keys from a request would.
+template <typename String>
+void benchmark_table(MicroBenchmarkRunner &runner, const std::string &label,
+                     const std::vector<std::string> &keys,
+                     const std::string &value, size_t threads) {
+  using Table =
+      libcuckoo::cuckoohash_map<String, String, libcuckoo::arena_string_hash>;
+  // The table is sized to hold every element up front, so that the
+  // benchmarks measure the keys and values rather than resizing
+  Table table(g_elements);
+  auto insert = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      table.insert(String(keys[i].data(), keys[i].size()),
+                   String(value.data(), value.size()));
+    }
+  };
+  auto find = [&](size_t begin, size_t end) {
+    size_t found = 0;
+    for (size_t i = begin; i < end; ++i) {
+      found += table.contains(String(keys[i].data(), keys[i].size()));
+    }
+    ASSERT_EQ(found, end - begin);
+  };
+  auto erase = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      table.erase(String(keys[i].data(), keys[i].size()));
+    }
+  };
+  auto fill = [&]() {
+    if (table.size() != g_elements) {
+      run_threads(threads, insert);
+    }
+  };
+
+  // Runs one benchmark, and prints the calls to the system allocator made in
+  // its last repetition
+  auto benchmark = [&](const std::string &name, std::function<void()> setup,
+                       std::function<void(size_t, size_t)> body,
+                       size_t final_size) {
+    AllocatorCalls calls{0, 0};
+    const MicroBenchmarkResult result = runner.run(
+        name + "_" + label, "", g_elements, setup,
+        [&]() { calls = run_threads(threads, body); },
+        [&]() { ASSERT_EQ(table.size(), final_size); });
+    print_result(result, threads, calls);
+  };
+  benchmark("insert", [&]() { table.clear(); }, insert, g_elements);
+  benchmark("find", fill, find, g_elements);
+  benchmark("erase", fill, erase, 0);
+}
+
+int main(int argc, char **argv) {
+  try {
+    const char *args[] = {"--elements", "--key-length", "--value-length",
+                          "--repetitions", "--seed"};
+    size_t *arg_vars[] = {&g_elements, &g_key_length, &g_value_length,
+                          &g_repetitions, &g_seed};
+    const char *arg_descriptions[] = {
+        "Number of elements inserted, found and erased by each benchmark",
+        "Length of each key, at least 8",
+        "Length of each value",
+        "Number of timed repetitions of each benchmark",
+        "Seed for the random number generator, or 0 for a random seed"};
+    const char *str_args[] = {"--threads", "--filter"};
+    std::string *str_arg_vars[] = {&g_threads, &g_filter};
+    const char *str_arg_descriptions[] = {
+        "Comma-separated thread counts to benchmark with",
+        "Only run benchmarks whose name contains this string"};
+    parse_flags(argc, argv,
+                "Times string keys and values with and without arenas", args,
+                arg_vars, arg_descriptions, sizeof(args) / sizeof(const char *),
+                nullptr, nullptr, nullptr, 0, str_args, str_arg_vars,
+                str_arg_descriptions, sizeof(str_args) / sizeof(const char *));
+    if (g_elements == 0) {
+      throw std::runtime_error("Must benchmark at least one element\n");
+    }
+    if (g_key_length < sizeof(uint64_t)) {
+      throw std::runtime_error("Keys must be at least 8 bytes long\n");
+    }
+    const std::vector<size_t> thread_counts = parse_counts(g_threads);
+    for (size_t threads : thread_counts) {
+      if (threads == 0) {
+        throw std::runtime_error("Thread counts must be positive\n");
+      }
+    }
+
+    if (g_seed == 0) {
+      g_seed = std::random_device()();
+    }
+    pcg64_oneseq_once_insecure rng(g_seed);
+    // Each key ends with a distinct number, so that keys are unique
+    std::vector<std::string> keys;
+    keys.reserve(g_elements);
+    for (size_t i = 0; i < g_elements; ++i) {
+      std::string key(g_key_length, 'k');
+      const uint64_t suffix = (static_cast<uint64_t>(rng()) << 32) ^ i;
+      key.replace(g_key_length - sizeof(suffix), sizeof(suffix),
+                  reinterpret_cast<const char *>(&suffix), sizeof(suffix));
+      keys.push_back(key);
+    }
+    const std::string value(g_value_length, 'v');
+
+    MicroBenchmarkRunner runner(g_repetitions, g_filter, false);
+    std::cout << "seed: " << g_seed << ", elements: " << g_elements
+              << ", key length: " << g_key_length
+              << ", value length: " << g_value_length << std::endl;
+    print_header();
+    for (size_t threads : thread_counts) {
+      benchmark_table<std::string>(runner, "std", keys, value, threads);
+      benchmark_table<libcuckoo::arena_string>(runner, "arena", keys, value,
+                                               threads);
+    }
+    const libcuckoo::arena_stats stats =
+        libcuckoo::arena_allocator<char>::stats();
+    std::cout << "arena chunks: " << stats.chunks
+              << ", arena bytes: " << stats.chunk_bytes
+              << ", large allocations: " << stats.large_allocations
+              << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    std::exit(1);
+  }
+  return main_return_value;
+}
@@ -0,0 +1,5 @@
+extern "C" {
+#include "u64_u64_table.h"
+}
+
+#include <libcuckoo-c/cuckoo_table_template.cc>
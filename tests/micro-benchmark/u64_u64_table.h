@@ -0,0 +1,12 @@
+#ifndef U64_U64_TABLE_H
+#define U64_U64_TABLE_H
+
+#include <stdint.h>
+
+#define CUCKOO_TABLE_NAME u64_u64_table
+#define CUCKOO_KEY_TYPE uint64_t
+#define CUCKOO_MAPPED_TYPE uint64_t
+
+#include <libcuckoo-c/cuckoo_table_template.h>
+
+#endif // U64_U64_TABLE_H
@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+"""Runs a fixed suite of the universal and micro benchmarks, and compares the
+results against a saved baseline.
+
+Each benchmark in the suite is run several times, and every metric it reports
+is summarized by its median over the runs, along with its noise: the median
+absolute deviation from the median, relative to the median. A metric has
+regressed if it got worse than the baseline by more than the larger of the
+threshold and a multiple of the noise of the two runs, so that noisy metrics
+don't fail the comparison on their own.
+
+The results are written as JSON, and a results file can be saved as the
+baseline for later comparisons. Exits with status 1 if any metric regressed.
+"""
+
+import argparse
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+
+RESULTS_VERSION = 1
+
+# The benchmarks always run with a fixed seed, so that every run does the same
+# work
+SEED = "1"
+
+
+def universal_suite(quick):
+    """The universal benchmark workloads, as (name, arguments) pairs. Each
+    reports its throughput."""
+    capacity = "14" if quick else "22"
+    common = ["--initial-capacity", capacity, "--seed", SEED,
+              "--memory-interval", "0"]
+    return [
+        ("read_heavy", ["--reads", "90", "--inserts", "10", "--prefill", "50",
+                        "--total-ops", "200"] + common),
+        ("mixed", ["--reads", "60", "--inserts", "20", "--erases", "10",
+                   "--updates", "10", "--prefill", "50", "--total-ops",
+                   "200"] + common),
+        ("insert_only", ["--inserts", "100", "--total-ops", "75"] + common),
+        ("upsert_only", ["--upserts", "100", "--prefill", "25", "--total-ops",
+                         "200"] + common),
+        # Starts from a tiny table, so the time is dominated by resizing
+        ("insert_growth", ["--inserts", "100", "--initial-capacity", "4",
+                           "--total-ops", "102400" if quick else "1638400",
+                           "--seed", SEED, "--memory-interval", "0"]),
+    ]
+
+
+def micro_args(quick):
+    if quick:
+        return ["--sizes", "16K,256K", "--ops", "4096", "--repetitions", "3",
+                "--seed", SEED]
+    return ["--sizes", "32K,1M,32M", "--repetitions", "5", "--seed", SEED]
+
+
+def bulk_args(quick):
+    if quick:
+        return ["--hashpowers", "8,12", "--threads", "1,2", "--repetitions",
+                "3", "--seed", SEED]
+    return ["--hashpowers", "16,20", "--threads", "1,2", "--repetitions", "5",
+            "--seed", SEED]
+
+
+def run(command):
+    result = subprocess.run(command, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE, universal_newlines=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr)
+        raise RuntimeError("`%s` failed with status %d" %
+                           (" ".join(command), result.returncode))
+    return result.stdout
+
+
+def parse_universal(output, name, threads):
+    """Returns the throughput reported by one universal benchmark run"""
+    result = json.loads(output)
+    key = "universal/%s/threads=%d/throughput" % (name, threads)
+    return {key: (result["output"]["throughput"]["value"], "ops/s", True)}
+
+
+def parse_micro(output):
+    """Returns the median time per operation of each micro benchmark"""
+    metrics = {}
+    for line in output.splitlines():
+        fields = line.split()
+        # Rows are: benchmark size min median mean stddev cycles/op
+        if len(fields) != 7 or fields[0] == "benchmark":
+            continue
+        key = "micro/%s/%s/median" % (fields[0], fields[1])
+        metrics[key] = (float(fields[3]), "ns/op", False)
+    return metrics
+
+
+def parse_bulk(output):
+    """Returns the median time of each bulk benchmark"""
+    metrics = {}
+    for line in output.splitlines():
+        fields = line.split()
+        # Rows are: benchmark hashpower elements threads min median Mitems/s
+        # GB/s
+        if len(fields) != 8 or fields[0] == "benchmark":
+            continue
+        key = "bulk/%s/hashpower=%s/threads=%s/median" % (
+            fields[0], fields[1], fields[3])
+        metrics[key] = (float(fields[5]), "ms", False)
+    return metrics
+
+
+def collect(args):
+    """Runs the suite `args.repeat` times, and returns each metric's samples,
+    keyed by metric name, along with its units and direction"""
+    samples = {}
+
+    def add(metrics):
+        for key, (value, units, higher_is_better) in metrics.items():
+            entry = samples.setdefault(key, {
+                "units": units,
+                "higher_is_better": higher_is_better,
+                "samples": [],
+            })
+            entry["samples"].append(value)
+
+    for rep in range(args.repeat):
+        sys.stderr.write("Repetition %d of %d\n" % (rep + 1, args.repeat))
+        if args.universal_benchmark:
+            for name, bench_args in universal_suite(args.quick):
+                sys.stderr.write("  universal_benchmark %s\n" % name)
+                command = [args.universal_benchmark, "--num-threads",
+                           str(args.threads)] + bench_args
+                add(parse_universal(run(command), name, args.threads))
+        if args.micro_benchmark:
+            sys.stderr.write("  micro_benchmark\n")
+            add(parse_micro(run([args.micro_benchmark] +
+                                micro_args(args.quick))))
+        if args.bulk_benchmark:
+            sys.stderr.write("  bulk_benchmark\n")
+            add(parse_bulk(run([args.bulk_benchmark] +
+                               bulk_args(args.quick))))
+    return samples
+
+
+def summarize(samples):
+    metrics = {}
+    for key, entry in samples.items():
+        values = entry["samples"]
+        median = statistics.median(values)
+        mad = statistics.median(abs(v - median) for v in values)
+        metrics[key] = dict(entry, median=median,
+                            noise=mad / median if median else 0.0)
+    return metrics
+
+
+def machine():
+    return {
+        "node": platform.node(),
+        "machine": platform.machine(),
+        "processor": platform.processor(),
+        "system": platform.system(),
+        "cpus": os.cpu_count(),
+    }
+
+
+def compare(results, baseline, threshold, noise_factor):
+    """Prints a comparison of each metric with the baseline, and returns the
+    names of the metrics that regressed"""
+    if baseline.get("version") != RESULTS_VERSION:
+        raise RuntimeError("Baseline has an unsupported version")
+    if baseline.get("quick") != results["quick"]:
+        raise RuntimeError("Baseline was run with a different suite size "
+                           "(--quick)")
+    if baseline.get("machine") != results["machine"]:
+        sys.stderr.write("Warning: the baseline was recorded on a different "
+                         "machine\n")
+    regressions = []
+    print("%-52s %14s %14s %8s %8s  %s" % ("metric", "baseline", "current",
+                                           "change", "allowed", "verdict"))
+    for key in sorted(results["metrics"]):
+        current = results["metrics"][key]
+        base = baseline["metrics"].get(key)
+        if base is None:
+            print("%-52s %14s %14.4g %8s %8s  %s" % (key, "-",
+                                                      current["median"], "-",
+                                                      "-", "new"))
+            continue
+        change = (current["median"] - base["median"]) / base["median"]
+        # Positive changes are always for the worse
+        worse = -change if current["higher_is_better"] else change
+        allowed = max(threshold,
+                      noise_factor * max(base["noise"], current["noise"]))
+        if worse > allowed:
+            verdict = "REGRESSED"
+            regressions.append(key)
+        elif -worse > allowed:
+            verdict = "improved"
+        else:
+            verdict = "ok"
+        print("%-52s %14.4g %14.4g %+7.1f%% %7.1f%%  %s" %
+              (key, base["median"], current["median"], 100 * change,
+               100 * allowed, verdict))
+    for key in sorted(set(baseline["metrics"]) - set(results["metrics"])):
+        print("%-52s %14.4g %14s %8s %8s  %s" %
+              (key, baseline["metrics"][key]["median"], "-", "-", "-",
+               "missing"))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--universal-benchmark",
+                        help="path to the universal_benchmark executable")
+    parser.add_argument("--micro-benchmark",
+                        help="path to the micro_benchmark executable")
+    parser.add_argument("--bulk-benchmark",
+                        help="path to the bulk_benchmark executable")
+    parser.add_argument("--repeat", type=int, default=5,
+                        help="number of times to run the suite (default 5)")
+    parser.add_argument("--threads", type=int, default=4,
+                        help="threads used by the universal benchmark "
+                        "(default 4)")
+    parser.add_argument("--quick", action="store_true",
+                        help="run a much smaller suite, to check that the "
+                        "harness works")
+    parser.add_argument("--output",
+                        help="file to write the results to, as JSON")
+    parser.add_argument("--baseline",
+                        help="baseline results to compare against")
+    parser.add_argument("--save-baseline",
+                        help="also write the results to this file, to use as "
+                        "the baseline of later runs")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percentage by which a metric may get worse "
+                        "before it counts as a regression (default 5)")
+    parser.add_argument("--noise-factor", type=float, default=3.0,
+                        help="a metric may also get worse by this multiple of "
+                        "its relative noise (default 3)")
+    parser.add_argument("--report-only", action="store_true",
+                        help="print the comparison, but exit with status 0 "
+                        "even if metrics regressed")
+    args = parser.parse_args()
+    if args.repeat < 1:
+        parser.error("--repeat must be at least 1")
+    if not (args.universal_benchmark or args.micro_benchmark or
+            args.bulk_benchmark):
+        parser.error("no benchmarks to run")
+
+    try:
+        # Read the baseline first, so a bad path fails before the suite runs
+        baseline = None
+        if args.baseline:
+            if os.path.exists(args.baseline):
+                with open(args.baseline) as f:
+                    baseline = json.load(f)
+            else:
+                sys.stderr.write("No baseline at %s, so nothing to compare "
+                                 "against\n" % args.baseline)
+        results = {
+            "version": RESULTS_VERSION,
+            "machine": machine(),
+            "quick": args.quick,
+            "repeat": args.repeat,
+            "threads": args.threads,
+            "metrics": summarize(collect(args)),
+        }
+        for path in (args.output, args.save_baseline):
+            if path:
+                with open(path, "w") as f:
+                    json.dump(results, f, indent=2, sort_keys=True)
+        if baseline is None:
+            return 0
+        regressions = compare(results, baseline, args.threshold / 100.0,
+                              args.noise_factor)
+    except (OSError, RuntimeError, ValueError, KeyError) as e:
+        sys.stderr.write("%s\n" % e)
+        return 2
+    if regressions:
+        sys.stderr.write("%d metrics regressed\n" % len(regressions))
+        return 0 if args.report_only else 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
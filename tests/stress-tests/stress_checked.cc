@@ -21,6 +21,8 @@
 #include <pcg/pcg_random.hpp>
 #include <test_util.hh>
 
+#include "stress_progress.hh"
+
 typedef uint32_t KeyType;
 typedef std::string KeyType2;
 typedef uint32_t ValType;
@@ -53,6 +55,9 @@ size_t g_test_len = 10;
 size_t g_seed = 0;
 // Whether to use strings as the key
 bool g_use_strings = false;
+// How often to record the throughput of all threads, in milliseconds, or 0 to
+// not record it. This can be set with the command line flag --report-interval
+size_t g_report_interval = 1000;
 
 std::atomic<size_t> num_inserts = ATOMIC_VAR_INIT(0);
 std::atomic<size_t> num_deletes = ATOMIC_VAR_INIT(0);
@@ -69,7 +74,8 @@ public:
                  std::numeric_limits<ValType>::max()),
         val_dist2(std::numeric_limits<ValType2>::min(),
                   std::numeric_limits<ValType2>::max()),
-        ind_dist(0, g_numkeys - 1), finished(false) {
+        ind_dist(0, g_numkeys - 1), finished(false),
+        progress(g_report_interval) {
     // Sets up the random number generator
     if (g_seed == 0) {
       g_seed = std::chrono::system_clock::now().time_since_epoch().count();
@@ -98,9 +104,14 @@ public:
   size_t gen_seed;
   // When set to true, it signals to the threads to stop running
   std::atomic<bool> finished;
+  // Counts the operations each thread runs on the tables
+  StressProgress progress;
 };
 
-template <class KType> void stress_insert_thread(AllEnvironment<KType> *env) {
+template <class KType>
+void stress_insert_thread(AllEnvironment<KType> *env,
+                          StressProgress::ThreadProgress *progress) {
+  env->progress.wait_for_start();
   pcg64_fast gen(env->gen_seed);
   while (!env->finished.load()) {
     // Pick a random number between 0 and g_numkeys. If that slot is
@@ -127,12 +138,16 @@ template <class KType> void stress_insert_thread(AllEnvironment<KType> *env) {
         env->in_table[ind] = true;
         num_inserts.fetch_add(2, std::memory_order_relaxed);
       }
+      progress->add(2);
       env->in_use[ind].clear();
     }
   }
 }
 
-template <class KType> void delete_thread(AllEnvironment<KType> *env) {
+template <class KType>
+void delete_thread(AllEnvironment<KType> *env,
+                   StressProgress::ThreadProgress *progress) {
+  env->progress.wait_for_start();
   pcg64_fast gen(env->gen_seed);
   while (!env->finished.load()) {
     // Run deletes on a random key, check that the deletes
@@ -154,12 +169,16 @@ template <class KType> void delete_thread(AllEnvironment<KType> *env) {
         env->in_table[ind] = false;
         num_deletes.fetch_add(2, std::memory_order_relaxed);
       }
+      progress->add(2);
       env->in_use[ind].clear();
     }
   }
 }
 
-template <class KType> void update_thread(AllEnvironment<KType> *env) {
+template <class KType>
+void update_thread(AllEnvironment<KType> *env,
+                   StressProgress::ThreadProgress *progress) {
+  env->progress.wait_for_start();
   pcg64_fast gen(env->gen_seed);
   std::uniform_int_distribution<size_t> third(0, 2);
   auto updatefn = [](ValType &v) { v += 3; };
@@ -227,12 +246,16 @@ template <class KType> void update_thread(AllEnvironment<KType> *env) {
         env->vals2[ind] = v2;
         num_updates.fetch_add(2, std::memory_order_relaxed);
       }
+      progress->add(2);
       env->in_use[ind].clear();
     }
   }
 }
 
-template <class KType> void find_thread(AllEnvironment<KType> *env) {
+template <class KType>
+void find_thread(AllEnvironment<KType> *env,
+                 StressProgress::ThreadProgress *progress) {
+  env->progress.wait_for_start();
   pcg64_fast gen(env->gen_seed);
   while (!env->finished.load()) {
     // Run finds on a random key and check that the presence of
@@ -253,6 +276,7 @@ template <class KType> void find_thread(AllEnvironment<KType> *env) {
         EXPECT_FALSE(env->in_table[ind]);
       }
       num_finds.fetch_add(2, std::memory_order_relaxed);
+      progress->add(2);
       env->in_use[ind].clear();
     }
   }
@@ -263,24 +287,30 @@ template <class KType> void StressTest(AllEnvironment<KType> *env) {
   std::vector<std::thread> threads;
   for (size_t i = 0; i < g_thread_num; i++) {
     if (!g_disable_inserts) {
-      threads.emplace_back(stress_insert_thread<KType>, env);
+      threads.emplace_back(stress_insert_thread<KType>, env,
+                           env->progress.add_thread("insert"));
     }
     if (!g_disable_deletes) {
-      threads.emplace_back(delete_thread<KType>, env);
+      threads.emplace_back(delete_thread<KType>, env,
+                           env->progress.add_thread("delete"));
     }
     if (!g_disable_updates) {
-      threads.emplace_back(update_thread<KType>, env);
+      threads.emplace_back(update_thread<KType>, env,
+                           env->progress.add_thread("update"));
     }
     if (!g_disable_finds) {
-      threads.emplace_back(find_thread<KType>, env);
+      threads.emplace_back(find_thread<KType>, env,
+                           env->progress.add_thread("find"));
     }
   }
+  env->progress.start();
   // Sleeps before ending the threads
   std::this_thread::sleep_for(std::chrono::seconds(g_test_len));
   env->finished.store(true);
   for (size_t i = 0; i < threads.size(); i++) {
     threads[i].join();
   }
+  env->progress.stop();
   // Finds the number of slots that are filled
   size_t numfilled = 0;
   for (size_t i = 0; i < g_numkeys; i++) {
@@ -294,16 +324,20 @@ template <class KType> void StressTest(AllEnvironment<KType> *env) {
   std::cout << "Number of deletes:\t" << num_deletes.load() << std::endl;
   std::cout << "Number of updates:\t" << num_updates.load() << std::endl;
   std::cout << "Number of finds:\t" << num_finds.load() << std::endl;
+  env->progress.report();
 }
 
 int main(int argc, char **argv) {
-  const char *args[] = {"--power", "--thread-num", "--time", "--seed"};
-  size_t *arg_vars[] = {&g_power, &g_thread_num, &g_test_len, &g_seed};
+  const char *args[] = {"--power", "--thread-num", "--time", "--seed",
+                        "--report-interval"};
+  size_t *arg_vars[] = {&g_power, &g_thread_num, &g_test_len, &g_seed,
+                        &g_report_interval};
   const char *arg_help[] = {
       "The number of keys to size the table with, expressed as a power of 2",
       "The number of threads to spawn for each type of operation",
       "The number of seconds to run the test for",
-      "The seed for the random number generator"};
+      "The seed for the random number generator",
+      "How often to record the throughput, in milliseconds (0 disables it)"};
   const char *flags[] = {"--disable-inserts", "--disable-deletes",
                          "--disable-updates", "--disable-finds",
                          "--use-strings"};
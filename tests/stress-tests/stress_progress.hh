@@ -0,0 +1,192 @@
+#ifndef _STRESS_PROGRESS_HH
+#define _STRESS_PROGRESS_HH
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Tracks how many table operations each stress test thread completes, so the
+ * tests report throughput and fairness alongside correctness. Each thread
+ * counts its operations in a counter on its own cache line, which only it
+ * writes, and a monitor thread reads all the counters once per interval to
+ * record the throughput over time. At the end, the test reports each thread's
+ * operations per second, and for each kind of thread, the total throughput and
+ * the ratio of the least to the most progress made by any thread of that kind
+ * (1 is perfectly fair, and 0 means some thread was starved).
+ *
+ * Threads must all be added before start() is called, and each thread should
+ * call wait_for_start() before its first operation, so that the clock covers
+ * every operation counted. start() starts the clock, releases the waiting
+ * threads, and starts the monitor. An interval of 0 disables the monitor. */
+
+class StressProgress {
+public:
+  using clock = std::chrono::steady_clock;
+
+  // Each counter is allocated separately, and padded so that no other
+  // thread's counter shares its cache line
+  class ThreadProgress {
+  public:
+    ThreadProgress(const std::string &kind) : kind_(kind), ops_(0) {}
+
+    // Called only by the thread that owns this counter
+    void add(size_t ops) {
+      ops_.store(ops_.load(std::memory_order_relaxed) + ops,
+                 std::memory_order_relaxed);
+    }
+
+    size_t ops() const { return ops_.load(std::memory_order_relaxed); }
+
+    const std::string &kind() const { return kind_; }
+
+  private:
+    const std::string kind_;
+    std::atomic<size_t> ops_;
+    char padding_[64];
+  };
+
+  StressProgress(size_t interval_ms)
+      : interval_(interval_ms), started_(false), done_(false) {}
+
+  ~StressProgress() { stop(); }
+
+  // Adds a thread of the given kind, and returns the counter it should report
+  // its operations to. The counter stays valid for the lifetime of the
+  // tracker.
+  ThreadProgress *add_thread(const std::string &kind) {
+    threads_.emplace_back(new ThreadProgress(kind));
+    return threads_.back().get();
+  }
+
+  // Called by each thread before its first operation. Returns once the clock
+  // has been started.
+  void wait_for_start() const {
+    while (!started_.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Starts the clock, lets the threads waiting in wait_for_start go, and
+  // starts the monitor thread if it's enabled
+  void start() {
+    start_time_ = clock::now();
+    started_.store(true, std::memory_order_release);
+    if (interval_.count() == 0) {
+      return;
+    }
+    monitor_ = std::thread([this]() {
+      size_t last_ops = 0;
+      clock::time_point last_time = start_time_;
+      while (true) {
+        std::this_thread::sleep_until(last_time + interval_);
+        // Once stopped, the threads have finished, so the rest of the
+        // interval would only measure the time it took to stop them
+        if (done_.load(std::memory_order_acquire)) {
+          break;
+        }
+        const clock::time_point now = clock::now();
+        const size_t ops = total_ops();
+        intervals_.push_back(Interval{seconds(now - start_time_),
+                                      (ops - last_ops) /
+                                          seconds(now - last_time)});
+        last_ops = ops;
+        last_time = now;
+      }
+    });
+  }
+
+  // Stops the clock and the monitor thread. Call this once the threads being
+  // tracked have finished.
+  void stop() {
+    if (end_time_ == clock::time_point()) {
+      end_time_ = clock::now();
+    }
+    if (monitor_.joinable()) {
+      done_.store(true, std::memory_order_release);
+      monitor_.join();
+    }
+  }
+
+  void report() const {
+    const double elapsed = seconds(end_time_ - start_time_);
+    std::printf("----------Throughput----------\n");
+    std::printf("Elapsed seconds:\t%.3f\n", elapsed);
+    std::printf("%-8s %-10s %14s %14s\n", "thread", "kind", "ops", "ops/sec");
+    std::map<std::string, std::vector<size_t>> by_kind;
+    std::vector<size_t> all;
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      const ThreadProgress &thread = *threads_[i];
+      std::printf("%-8zu %-10s %14zu %14.0f\n", i, thread.kind().c_str(),
+                  thread.ops(), thread.ops() / elapsed);
+      by_kind[thread.kind()].push_back(thread.ops());
+      all.push_back(thread.ops());
+    }
+    std::printf("%-10s %8s %14s %14s %14s %10s\n", "kind", "threads",
+                "ops/sec", "min ops", "max ops", "fairness");
+    for (const auto &kind : by_kind) {
+      print_kind(kind.first, kind.second, elapsed);
+    }
+    print_kind("all", all, elapsed);
+    if (!intervals_.empty()) {
+      std::printf("----------Intervals----------\n");
+      std::printf("%10s %14s\n", "end sec", "ops/sec");
+      for (const Interval &interval : intervals_) {
+        std::printf("%10.3f %14.0f\n", interval.end, interval.throughput);
+      }
+    }
+    std::fflush(stdout);
+  }
+
+private:
+  struct Interval {
+    double end;
+    double throughput;
+  };
+
+  static double seconds(clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::duration<double>>(d)
+        .count();
+  }
+
+  static void print_kind(const std::string &kind,
+                         const std::vector<size_t> &ops, double elapsed) {
+    if (ops.empty()) {
+      return;
+    }
+    size_t total = 0;
+    for (size_t n : ops) {
+      total += n;
+    }
+    const size_t min = *std::min_element(ops.begin(), ops.end());
+    const size_t max = *std::max_element(ops.begin(), ops.end());
+    std::printf("%-10s %8zu %14.0f %14zu %14zu %10.3f\n", kind.c_str(),
+                ops.size(), total / elapsed, min, max,
+                max == 0 ? 1.0 : static_cast<double>(min) / max);
+  }
+
+  size_t total_ops() const {
+    size_t total = 0;
+    for (const std::unique_ptr<ThreadProgress> &thread : threads_) {
+      total += thread->ops();
+    }
+    return total;
+  }
+
+  const std::chrono::milliseconds interval_;
+  std::vector<std::unique_ptr<ThreadProgress>> threads_;
+  std::atomic<bool> started_;
+  std::atomic<bool> done_;
+  std::thread monitor_;
+  clock::time_point start_time_;
+  clock::time_point end_time_;
+  std::vector<Interval> intervals_;
+};
+
+#endif // _STRESS_PROGRESS_HH
@@ -21,6 +21,8 @@
 #include <pcg/pcg_random.hpp>
 #include <test_util.hh>
 
+#include "stress_progress.hh"
+
 typedef uint32_t KeyType;
 typedef std::string KeyType2;
 typedef uint32_t ValType;
@@ -65,10 +67,15 @@ size_t g_test_len = 10;
 size_t g_seed = 0;
 // Whether to use strings as the key
 bool g_use_strings = false;
+// How often to record the throughput of all threads, in milliseconds, or 0 to
+// not record it. This can be set with the command line flag --report-interval
+size_t g_report_interval = 1000;
 
 template <class KType> class AllEnvironment {
 public:
-  AllEnvironment() : table(g_numkeys), table2(g_numkeys), finished(false) {
+  AllEnvironment()
+      : table(g_numkeys), table2(g_numkeys), finished(false),
+        progress(g_report_interval) {
     // Sets up the random number generator
     if (g_seed == 0) {
       g_seed = std::chrono::system_clock::now().time_since_epoch().count();
@@ -87,10 +94,14 @@ public:
   libcuckoo::cuckoohash_map<KType, ValType2> table2;
   size_t gen_seed;
   std::atomic<bool> finished;
+  // Counts the operations each thread runs on the tables
+  StressProgress progress;
 };
 
 template <class KType>
-void stress_insert_thread(AllEnvironment<KType> *env, size_t thread_seed) {
+void stress_insert_thread(AllEnvironment<KType> *env, size_t thread_seed,
+                          StressProgress::ThreadProgress *progress) {
+  env->progress.wait_for_start();
   std::uniform_int_distribution<size_t> ind_dist;
   std::uniform_int_distribution<ValType> val_dist;
   std::uniform_int_distribution<ValType2> val_dist2;
@@ -102,11 +113,14 @@ void stress_insert_thread(AllEnvironment<KType> *env, size_t thread_seed) {
     env->table2.insert(k, val_dist2(gen));
     env->table.insert_or_assign(k, val_dist(gen));
     env->table2.insert_or_assign(k, val_dist2(gen));
+    progress->add(4);
   }
 }
 
 template <class KType>
-void delete_thread(AllEnvironment<KType> *env, size_t thread_seed) {
+void delete_thread(AllEnvironment<KType> *env, size_t thread_seed,
+                   StressProgress::ThreadProgress *progress) {
+  env->progress.wait_for_start();
   std::uniform_int_distribution<size_t> ind_dist;
   pcg64_fast gen(thread_seed);
   while (!env->finished.load()) {
@@ -114,11 +128,14 @@ void delete_thread(AllEnvironment<KType> *env, size_t thread_seed) {
     const KType k = generateKey<KType>(ind_dist(gen));
     env->table.erase(k);
     env->table2.erase(k);
+    progress->add(2);
   }
 }
 
 template <class KType>
-void update_thread(AllEnvironment<KType> *env, size_t thread_seed) {
+void update_thread(AllEnvironment<KType> *env, size_t thread_seed,
+                   StressProgress::ThreadProgress *progress) {
+  env->progress.wait_for_start();
   std::uniform_int_distribution<size_t> ind_dist;
   std::uniform_int_distribution<ValType> val_dist;
   std::uniform_int_distribution<ValType2> val_dist2;
@@ -143,11 +160,14 @@ void update_thread(AllEnvironment<KType> *env, size_t thread_seed) {
       env->table.upsert(k, updatefn, val_dist(gen));
       env->table2.upsert(k, [](ValType2 &v) { v -= 50; }, val_dist2(gen));
     }
+    progress->add(2);
   }
 }
 
 template <class KType>
-void find_thread(AllEnvironment<KType> *env, size_t thread_seed) {
+void find_thread(AllEnvironment<KType> *env, size_t thread_seed,
+                 StressProgress::ThreadProgress *progress) {
+  env->progress.wait_for_start();
   std::uniform_int_distribution<size_t> ind_dist;
   pcg64_fast gen(thread_seed);
   ValType v;
@@ -159,11 +179,13 @@ void find_thread(AllEnvironment<KType> *env, size_t thread_seed) {
       env->table2.find(k);
     } catch (...) {
     }
+    progress->add(2);
   }
 }
 
 template <class KType>
 void resize_thread(AllEnvironment<KType> *env, size_t thread_seed) {
+  env->progress.wait_for_start();
   pcg64_fast gen(thread_seed);
   // Resizes at a random time
   const size_t sleep_time = gen() % g_test_len;
@@ -184,6 +206,7 @@ void resize_thread(AllEnvironment<KType> *env, size_t thread_seed) {
 
 template <class KType>
 void iterator_thread(AllEnvironment<KType> *env, size_t thread_seed) {
+  env->progress.wait_for_start();
   pcg64_fast gen(thread_seed);
   // Runs an iteration operation at a random time
   const size_t sleep_time = gen() % g_test_len;
@@ -199,7 +222,10 @@ void iterator_thread(AllEnvironment<KType> *env, size_t thread_seed) {
   }
 }
 
-template <class KType> void misc_thread(AllEnvironment<KType> *env) {
+template <class KType>
+void misc_thread(AllEnvironment<KType> *env,
+                 StressProgress::ThreadProgress *progress) {
+  env->progress.wait_for_start();
   // Runs all the misc functions
   pcg64_fast gen(g_seed);
   while (!env->finished.load()) {
@@ -210,11 +236,13 @@ template <class KType> void misc_thread(AllEnvironment<KType> *env) {
     env->table.load_factor();
     env->table.hash_function();
     env->table.key_eq();
+    progress->add(7);
   }
 }
 
 template <class KType>
 void clear_thread(AllEnvironment<KType> *env, size_t thread_seed) {
+  env->progress.wait_for_start();
   pcg64_fast gen(thread_seed);
   // Runs a clear operation at a random time
   const size_t sleep_time = gen() % g_test_len;
@@ -230,16 +258,20 @@ template <class KType> void StressTest(AllEnvironment<KType> *env) {
   std::vector<std::thread> threads;
   for (size_t i = 0; i < g_thread_num; i++) {
     if (!g_disable_inserts) {
-      threads.emplace_back(stress_insert_thread<KType>, env, env->gen_seed++);
+      threads.emplace_back(stress_insert_thread<KType>, env, env->gen_seed++,
+                           env->progress.add_thread("insert"));
     }
     if (!g_disable_deletes) {
-      threads.emplace_back(delete_thread<KType>, env, env->gen_seed++);
+      threads.emplace_back(delete_thread<KType>, env, env->gen_seed++,
+                           env->progress.add_thread("delete"));
     }
     if (!g_disable_updates) {
-      threads.emplace_back(update_thread<KType>, env, env->gen_seed++);
+      threads.emplace_back(update_thread<KType>, env, env->gen_seed++,
+                           env->progress.add_thread("update"));
     }
     if (!g_disable_finds) {
-      threads.emplace_back(find_thread<KType>, env, env->gen_seed++);
+      threads.emplace_back(find_thread<KType>, env, env->gen_seed++,
+                           env->progress.add_thread("find"));
     }
     if (!g_disable_resizes) {
       threads.emplace_back(resize_thread<KType>, env, env->gen_seed++);
@@ -248,31 +280,43 @@ template <class KType> void StressTest(AllEnvironment<KType> *env) {
       threads.emplace_back(iterator_thread<KType>, env, env->gen_seed++);
     }
     if (!g_disable_misc) {
-      threads.emplace_back(misc_thread<KType>, env);
+      threads.emplace_back(misc_thread<KType>, env,
+                           env->progress.add_thread("misc"));
     }
     if (!g_disable_clears) {
       threads.emplace_back(clear_thread<KType>, env, env->gen_seed++);
     }
   }
+  env->progress.start();
   // Sleeps before ending the threads
   std::this_thread::sleep_for(std::chrono::seconds(g_test_len));
   env->finished.store(true);
   for (size_t i = 0; i < threads.size(); i++) {
     threads[i].join();
   }
+  env->progress.stop();
   std::cout << "----------Results----------" << std::endl;
   std::cout << "Final size:\t" << env->table.size() << std::endl;
   std::cout << "Final load factor:\t" << env->table.load_factor() << std::endl;
+#if LIBCUCKOO_LOCK_STATS
+  const auto locks = env->table.get_lock_stats();
+  std::cout << "Lock acquisitions:\t" << locks.acquisitions << std::endl;
+  std::cout << "Contended acquisitions:\t" << locks.contended << std::endl;
+#endif
+  env->progress.report();
 }
 
 int main(int argc, char **argv) {
-  const char *args[] = {"--power", "--thread-num", "--time", "--seed"};
-  size_t *arg_vars[] = {&g_power, &g_thread_num, &g_test_len, &g_seed};
+  const char *args[] = {"--power", "--thread-num", "--time", "--seed",
+                        "--report-interval"};
+  size_t *arg_vars[] = {&g_power, &g_thread_num, &g_test_len, &g_seed,
+                        &g_report_interval};
   const char *arg_help[] = {
       "The number of keys to size the table with, expressed as a power of 2",
       "The number of threads to spawn for each type of operation",
       "The number of seconds to run the test for",
-      "The seed for the random number generator"};
+      "The seed for the random number generator",
+      "How often to record the throughput, in milliseconds (0 disables it)"};
   const char *flags[] = {
       "--disable-inserts", "--disable-deletes", "--disable-updates",
       "--disable-finds",   "--disable-resizes", "--disable-iterators",
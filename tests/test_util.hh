@@ -10,6 +10,7 @@
 #include <iostream>
 #include <mutex>
 #include <random>
+#include <string>
 
 #include <pcg/pcg_random.hpp>
 
@@ -89,11 +90,14 @@ inline void do_assert_true(bool x, const char *xname, size_t line) {
 }
 #define ASSERT_TRUE(x) do_assert_true(x, #x, __LINE__)
 
-// Parses boolean flags and flags with positive integer arguments
+// Parses boolean flags, flags with positive integer arguments, and flags with
+// string arguments
 void parse_flags(int argc, char **argv, const char *description,
                  const char *args[], size_t *arg_vars[], const char *arg_help[],
                  size_t arg_num, const char *flags[], bool *flag_vars[],
-                 const char *flag_help[], size_t flag_num) {
+                 const char *flag_help[], size_t flag_num,
+                 const char *str_args[], std::string *str_arg_vars[],
+                 const char *str_arg_help[], size_t str_arg_num) {
 
   errno = 0;
   for (int i = 0; i < argc; i++) {
@@ -120,6 +124,17 @@ void parse_flags(int argc, char **argv, const char *description,
         *(flag_vars[j]) = true;
       }
     }
+    for (size_t j = 0; j < str_arg_num; j++) {
+      if (strcmp(argv[i], str_args[j]) == 0) {
+        if (i == argc - 1) {
+          std::cerr << "You must provide an argument after the " << str_args[j]
+                    << " argument" << std::endl;
+          exit(EXIT_FAILURE);
+        } else {
+          *(str_arg_vars[j]) = argv[i + 1];
+        }
+      }
+    }
     if (strcmp(argv[i], "--help") == 0) {
       std::cerr << description << std::endl;
       std::cerr << "Arguments:" << std::endl;
@@ -127,6 +142,10 @@ void parse_flags(int argc, char **argv, const char *description,
         std::cerr << args[j] << " (default " << *arg_vars[j] << "):\t"
                   << arg_help[j] << std::endl;
       }
+      for (size_t j = 0; j < str_arg_num; j++) {
+        std::cerr << str_args[j] << " (default \"" << *str_arg_vars[j]
+                  << "\"):\t" << str_arg_help[j] << std::endl;
+      }
       for (size_t j = 0; j < flag_num; j++) {
         std::cerr << flags[j] << " (default "
                   << (*flag_vars[j] ? "true" : "false") << "):\t"
@@ -137,6 +156,16 @@ void parse_flags(int argc, char **argv, const char *description,
   }
 }
 
+// Parses boolean flags and flags with positive integer arguments
+void parse_flags(int argc, char **argv, const char *description,
+                 const char *args[], size_t *arg_vars[], const char *arg_help[],
+                 size_t arg_num, const char *flags[], bool *flag_vars[],
+                 const char *flag_help[], size_t flag_num) {
+  parse_flags(argc, argv, description, args, arg_vars, arg_help, arg_num,
+              flags, flag_vars, flag_help, flag_num, nullptr, nullptr, nullptr,
+              0);
+}
+
 // generateKey is a function from a number to another given type, used to
 // generate keys for insertion.
 template <class T> T generateKey(size_t i) { return (T)i; }
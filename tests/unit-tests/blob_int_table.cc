@@ -0,0 +1,5 @@
+extern "C" {
+#include "blob_int_table.h"
+}
+
+#include <libcuckoo-c/cuckoo_table_template.cc>
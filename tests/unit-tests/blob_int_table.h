@@ -0,0 +1,14 @@
+#ifndef BLOB_INT_TABLE_H
+#define BLOB_INT_TABLE_H
+
+typedef struct { char bytes[12]; } test_blob;
+
+// Without CUCKOO_HASH_FN and CUCKOO_EQ_FN, keys are hashed and compared as raw
+// bytes
+#define CUCKOO_TABLE_NAME blob_int_table
+#define CUCKOO_KEY_TYPE test_blob
+#define CUCKOO_MAPPED_TYPE int
+
+#include <libcuckoo-c/cuckoo_table_template.h>
+
+#endif // BLOB_INT_TABLE_H
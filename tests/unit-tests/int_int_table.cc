@@ -2,4 +2,7 @@ extern "C" {
 #include "int_int_table.h"
 }
 
+// Use tiny blocks, so that reading and writing the test tables spans several
+// blocks
+#define CUCKOO_IO_BLOCK_BYTES 64
 #include <libcuckoo-c/cuckoo_table_template.cc>
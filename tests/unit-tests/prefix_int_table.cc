@@ -0,0 +1,7 @@
+extern "C" {
+#include "prefix_int_table.h"
+}
+
+size_t prefix_hash_calls = 0;
+
+#include <libcuckoo-c/cuckoo_table_template.cc>
@@ -0,0 +1,37 @@
+#ifndef PREFIX_INT_TABLE_H
+#define PREFIX_INT_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "blob_int_table.h"
+
+#undef CUCKOO_TABLE_NAME
+#undef CUCKOO_KEY_TYPE
+#undef CUCKOO_MAPPED_TYPE
+
+// Counts the calls to prefix_hash
+extern size_t prefix_hash_calls;
+
+// Keys are equal if their first two bytes are, so keys that differ only in
+// later bytes are the same key
+static inline size_t prefix_hash(const test_blob *key) {
+  ++prefix_hash_calls;
+  return (size_t)(unsigned char)key->bytes[0] * 256 +
+         (unsigned char)key->bytes[1];
+}
+
+static inline bool prefix_equal(const test_blob *lhs, const test_blob *rhs) {
+  return memcmp(lhs->bytes, rhs->bytes, 2) == 0;
+}
+
+#define CUCKOO_TABLE_NAME prefix_int_table
+#define CUCKOO_KEY_TYPE test_blob
+#define CUCKOO_MAPPED_TYPE int
+#define CUCKOO_HASH_FN prefix_hash
+#define CUCKOO_EQ_FN prefix_equal
+
+#include <libcuckoo-c/cuckoo_table_template.h>
+
+#endif // PREFIX_INT_TABLE_H
@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <libcuckoo/cuckoohash_arena.hh>
+#include <libcuckoo/cuckoohash_map.hh>
+
+using libcuckoo::arena_allocator;
+using libcuckoo::arena_string;
+
+using ArenaStringTable =
+    libcuckoo::cuckoohash_map<arena_string, arena_string,
+                              libcuckoo::arena_string_hash>;
+
+TEST_CASE("arena reuses freed blocks", "[arena]") {
+  arena_allocator<char> alloc;
+  char *p = alloc.allocate(40);
+  alloc.deallocate(p, 40);
+  // Sizes that round up to the same block share a free list
+  char *q = alloc.allocate(48);
+  REQUIRE(q == p);
+  alloc.deallocate(q, 48);
+}
+
+TEST_CASE("arena blocks are aligned and distinct", "[arena]") {
+  arena_allocator<char> alloc;
+  std::vector<char *> blocks;
+  for (size_t size = 1; size <= 4096; size += 37) {
+    char *p = alloc.allocate(size);
+    REQUIRE(reinterpret_cast<uintptr_t>(p) % 16 == 0);
+    std::memset(p, static_cast<int>(size), size);
+    blocks.push_back(p);
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    const size_t size = 1 + i * 37;
+    REQUIRE(blocks[i][0] == static_cast<char>(size));
+    REQUIRE(blocks[i][size - 1] == static_cast<char>(size));
+    alloc.deallocate(blocks[i], size);
+  }
+}
+
+TEST_CASE("arena passes large allocations through", "[arena]") {
+  arena_allocator<char> alloc;
+  const size_t large = arena_allocator<char>::stats().large_allocations;
+  char *p = alloc.allocate(8192);
+  REQUIRE(arena_allocator<char>::stats().large_allocations == large + 1);
+  alloc.deallocate(p, 8192);
+}
+
+TEST_CASE("arena blocks freed on another thread", "[arena]") {
+  std::vector<arena_string> strings;
+  std::thread t([&strings]() {
+    for (int i = 0; i < 10000; ++i) {
+      strings.emplace_back(64, 'a' + i % 26);
+    }
+  });
+  t.join();
+  for (int i = 0; i < 10000; ++i) {
+    REQUIRE(strings[i] == arena_string(64, 'a' + i % 26));
+  }
+  strings.clear();
+  // The blocks the thread returned to the pool when it exited are reused
+  const size_t chunks = arena_allocator<char>::stats().chunks;
+  for (int i = 0; i < 10000; ++i) {
+    strings.emplace_back(64, 'b');
+  }
+  REQUIRE(arena_allocator<char>::stats().chunks == chunks);
+}
+
+TEST_CASE("arena string hash matches std::string", "[arena]") {
+  libcuckoo::arena_string_hash hash;
+  for (size_t len = 0; len < 40; ++len) {
+    const std::string s(len, 'x');
+    REQUIRE(hash(s) == hash(arena_string(s.data(), s.size())));
+  }
+  REQUIRE(hash(std::string("abc")) != hash(std::string("abd")));
+}
+
+TEST_CASE("arena string table", "[arena]") {
+  ArenaStringTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  const int num_elems = 10000;
+  auto key = [](int i) {
+    return arena_string("a key long enough to allocate ") +
+           arena_string(std::to_string(i).c_str());
+  };
+  // Growing from a single bucket moves every element several times
+  for (int i = 0; i < num_elems; ++i) {
+    REQUIRE(tbl.insert(key(i), arena_string(100, 'v')));
+  }
+  REQUIRE(tbl.size() == num_elems);
+  for (int i = 0; i < num_elems; ++i) {
+    REQUIRE(tbl.find(key(i)) == arena_string(100, 'v'));
+  }
+  for (int i = 0; i < num_elems; i += 2) {
+    REQUIRE(tbl.erase(key(i)));
+  }
+  for (int i = 0; i < num_elems; ++i) {
+    REQUIRE(tbl.contains(key(i)) == (i % 2 == 1));
+  }
+  ArenaStringTable copy(tbl);
+  tbl.clear();
+  REQUIRE(copy.size() == num_elems / 2);
+  REQUIRE(copy.find(key(1)) == arena_string(100, 'v'));
+}
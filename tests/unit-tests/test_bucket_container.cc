@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <memory>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <utility>
 
@@ -327,3 +328,34 @@ TEST_CASE("copy assignment with throwing type is destroyed properly",
   REQUIRE_THROWS_AS(other = container, std::runtime_error);
   ExceptionInt::do_throw = false;
 }
+
+TEST_CASE("wide partial keys hold the occupied flag", "[bucket container]") {
+  using WideContainer =
+      libcuckoo::bucket_container<std::string, int,
+                                  std::allocator<std::pair<std::string, int>>,
+                                  uint16_t, SLOT_PER_BUCKET>;
+  using NarrowContainer =
+      libcuckoo::bucket_container<std::string, int,
+                                  std::allocator<std::pair<std::string, int>>,
+                                  uint8_t, SLOT_PER_BUCKET>;
+  // The flags are packed into the partial keys, so the wider partial keys
+  // take up no extra space
+  REQUIRE(sizeof(WideContainer::bucket) == sizeof(NarrowContainer::bucket));
+
+  WideContainer container(0, WideContainer::allocator_type());
+  container.setKV(0, 0, 0x7fff, "a", 1);
+  container.setKV(0, 1, 0, "b", 2);
+  REQUIRE(container[0].occupied(0));
+  REQUIRE(container[0].partial(0) == 0x7fff);
+  REQUIRE(container[0].occupied(1));
+  REQUIRE(container[0].partial(1) == 0);
+  REQUIRE_FALSE(container[0].occupied(2));
+
+  container.eraseKV(0, 0);
+  REQUIRE_FALSE(container[0].occupied(0));
+  REQUIRE(container[0].occupied(1));
+  container.setKV(0, 0, 5, "c", 3);
+  REQUIRE(container[0].occupied(0));
+  REQUIRE(container[0].partial(0) == 5);
+  REQUIRE(container[0].key(0) == "c");
+}
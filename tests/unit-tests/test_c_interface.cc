@@ -1,11 +1,20 @@
 #include <catch.hpp>
 #include <cerrno>
 #include <cstdio>
+#include <cstring>
 
 extern "C" {
 #include "int_int_table.h"
 }
 
+#undef CUCKOO_TABLE_NAME
+#undef CUCKOO_KEY_TYPE
+#undef CUCKOO_MAPPED_TYPE
+
+extern "C" {
+#include "prefix_int_table.h"
+}
+
 int cuckoo_find_fn_value;
 void cuckoo_find_fn(const int *value) { cuckoo_find_fn_value = *value; }
 
@@ -13,6 +22,24 @@ void cuckoo_increment_fn(int *value) { ++(*value); }
 
 bool cuckoo_erase_fn(int *value) { return (*value) & 1; }
 
+void cuckoo_find_fn_ctx(const int *value, void *ctx) {
+  *static_cast<int *>(ctx) = *value;
+}
+
+void cuckoo_add_fn_ctx(int *value, void *ctx) {
+  *value += *static_cast<int *>(ctx);
+}
+
+bool cuckoo_erase_fn_ctx(int *value, void *ctx) {
+  return *value == *static_cast<int *>(ctx);
+}
+
+// Sums the keys, and doubles the values
+void cuckoo_for_each_fn(const int *key, int *value, void *ctx) {
+  *static_cast<int *>(ctx) += *key;
+  *value *= 2;
+}
+
 TEST_CASE("c interface", "[c interface]") {
   int_int_table *tbl = int_int_table_init(0);
 
@@ -73,6 +100,66 @@ TEST_CASE("c interface", "[c interface]") {
     }
   }
 
+  SECTION("find_fn_ctx") {
+    for (int i = 0; i < 10; ++i) {
+      int value = -1;
+      REQUIRE(int_int_table_find_fn_ctx(tbl, &i, cuckoo_find_fn_ctx, &value));
+      REQUIRE(value == i);
+    }
+    for (int i = 10; i < 20; ++i) {
+      int value = -1;
+      REQUIRE_FALSE(
+          int_int_table_find_fn_ctx(tbl, &i, cuckoo_find_fn_ctx, &value));
+      REQUIRE(value == -1);
+    }
+  }
+
+  SECTION("update_fn_ctx") {
+    int amount = 5;
+    for (int i = 0; i < 10; ++i) {
+      REQUIRE(int_int_table_update_fn_ctx(tbl, &i, cuckoo_add_fn_ctx, &amount));
+    }
+    for (int i = 0; i < 10; ++i) {
+      int value;
+      REQUIRE(int_int_table_find(tbl, &i, &value));
+      REQUIRE(value == i + 5);
+    }
+  }
+
+  SECTION("upsert_ctx") {
+    int amount = 3;
+    for (int i = 0; i < 20; ++i) {
+      REQUIRE(int_int_table_upsert_ctx(tbl, &i, cuckoo_add_fn_ctx, &amount,
+                                       &i) == (i >= 10));
+    }
+    for (int i = 0; i < 20; ++i) {
+      int value;
+      REQUIRE(int_int_table_find(tbl, &i, &value));
+      REQUIRE(value == (i < 10 ? i + 3 : i));
+    }
+  }
+
+  SECTION("erase_fn_ctx") {
+    int target = 4;
+    for (int i = 0; i < 10; ++i) {
+      REQUIRE(
+          int_int_table_erase_fn_ctx(tbl, &i, cuckoo_erase_fn_ctx, &target));
+    }
+    REQUIRE(int_int_table_size(tbl) == 9);
+    REQUIRE_FALSE(int_int_table_contains(tbl, &target));
+  }
+
+  SECTION("for_each") {
+    int sum = 0;
+    REQUIRE(int_int_table_for_each(tbl, cuckoo_for_each_fn, &sum));
+    REQUIRE(sum == 45);
+    for (int i = 0; i < 10; ++i) {
+      int value;
+      REQUIRE(int_int_table_find(tbl, &i, &value));
+      REQUIRE(value == i * 2);
+    }
+  }
+
   SECTION("find") {
     int value;
     for (int i = 0; i < 10; ++i) {
@@ -120,6 +207,42 @@ TEST_CASE("c interface", "[c interface]") {
     }
   }
 
+  SECTION("find_batch") {
+    int keys[20];
+    int values[20];
+    bool found[20];
+    for (int i = 0; i < 20; ++i) {
+      keys[i] = 19 - i;
+      values[i] = -1;
+    }
+    REQUIRE(int_int_table_find_batch(tbl, keys, 20, values, found) == 10);
+    for (int i = 0; i < 20; ++i) {
+      REQUIRE(found[i] == (keys[i] < 10));
+      REQUIRE(values[i] == (found[i] ? keys[i] : -1));
+    }
+    REQUIRE(int_int_table_find_batch(tbl, keys, 20, values, NULL) == 10);
+  }
+
+  SECTION("insert_batch") {
+    int keys[20];
+    int values[20];
+    bool inserted[20];
+    for (int i = 0; i < 20; ++i) {
+      keys[i] = i;
+      values[i] = i * 2;
+    }
+    REQUIRE(int_int_table_insert_batch(tbl, keys, values, 20, inserted) ==
+            10);
+    for (int i = 0; i < 20; ++i) {
+      int value;
+      REQUIRE(inserted[i] == (i >= 10));
+      REQUIRE(int_int_table_find(tbl, &i, &value));
+      REQUIRE(value == (i < 10 ? i : i * 2));
+    }
+    REQUIRE(int_int_table_insert_batch(tbl, keys, values, 20, NULL) == 0);
+    REQUIRE(int_int_table_size(tbl) == 20);
+  }
+
   SECTION("erase") {
     for (int i = 1; i < 10; i += 2) {
       REQUIRE(int_int_table_erase(tbl, &i));
@@ -129,6 +252,46 @@ TEST_CASE("c interface", "[c interface]") {
     }
   }
 
+  SECTION("configuration") {
+    REQUIRE(int_int_table_minimum_load_factor(tbl) == 0);
+    REQUIRE(int_int_table_maximum_hashpower(tbl) == SIZE_MAX);
+    REQUIRE(int_int_table_max_num_worker_threads(tbl) == 0);
+
+    REQUIRE(int_int_table_set_minimum_load_factor(tbl, 0.25));
+    REQUIRE(int_int_table_minimum_load_factor(tbl) == 0.25);
+    errno = 0;
+    REQUIRE_FALSE(int_int_table_set_minimum_load_factor(tbl, 1.5));
+    REQUIRE(errno == EINVAL);
+    REQUIRE(int_int_table_minimum_load_factor(tbl) == 0.25);
+
+    int_int_table_set_max_num_worker_threads(tbl, 3);
+    REQUIRE(int_int_table_max_num_worker_threads(tbl) == 3);
+
+    const size_t hp = int_int_table_hashpower(tbl);
+    REQUIRE(int_int_table_set_maximum_hashpower(tbl, hp));
+    REQUIRE(int_int_table_maximum_hashpower(tbl) == hp);
+    errno = 0;
+    REQUIRE_FALSE(int_int_table_set_maximum_hashpower(tbl, hp - 1));
+    REQUIRE(errno == EINVAL);
+    errno = 0;
+    REQUIRE_FALSE(int_int_table_rehash(tbl, hp + 1));
+    REQUIRE(errno == ENOSPC);
+    REQUIRE(int_int_table_hashpower(tbl) == hp);
+  }
+
+  SECTION("stats") {
+    int_int_table_stats stats;
+    int_int_table_get_stats(tbl, &stats);
+    REQUIRE(stats.size == 10);
+    REQUIRE(stats.hashpower == int_int_table_hashpower(tbl));
+    REQUIRE(stats.capacity == int_int_table_capacity(tbl));
+    REQUIRE(stats.load_factor == int_int_table_load_factor(tbl));
+    // The test table isn't built with the optional statistics
+    REQUIRE(stats.fast_double_count == 0);
+    REQUIRE(stats.lock_acquisitions == 0);
+    int_int_table_reset_stats(tbl);
+  }
+
   SECTION("rehash") {
     REQUIRE(int_int_table_rehash(tbl, 15));
     REQUIRE(int_int_table_hashpower(tbl) == 15);
@@ -161,6 +324,61 @@ TEST_CASE("c interface", "[c interface]") {
     fclose(fp);
   }
 
+  SECTION("read/write in parallel") {
+    for (int i = 10; i < 1000; ++i) {
+      int_int_table_insert(tbl, &i, &i);
+    }
+    FILE *fp = tmpfile();
+    int_int_table_locked_table *ltbl = int_int_table_lock_table(tbl);
+    REQUIRE(int_int_table_locked_table_write(ltbl, fp));
+    int_int_table_locked_table_free(ltbl);
+    for (size_t threads = 1; threads <= 4; ++threads) {
+      rewind(fp);
+      int_int_table *tbl2 = int_int_table_read_parallel(fp, threads);
+      REQUIRE(tbl2 != NULL);
+      REQUIRE(int_int_table_size(tbl2) == 1000);
+      for (int i = 0; i < 1000; ++i) {
+        int value;
+        REQUIRE(int_int_table_find(tbl2, &i, &value));
+        REQUIRE(i == value);
+      }
+      int_int_table_free(tbl2);
+    }
+    fclose(fp);
+  }
+
+  SECTION("read with more threads than can be started") {
+    for (int i = 10; i < 1000; ++i) {
+      int_int_table_insert(tbl, &i, &i);
+    }
+    FILE *fp = tmpfile();
+    int_int_table_locked_table *ltbl = int_int_table_lock_table(tbl);
+    REQUIRE(int_int_table_locked_table_write(ltbl, fp));
+    int_int_table_locked_table_free(ltbl);
+    rewind(fp);
+    errno = 0;
+    REQUIRE(int_int_table_read_parallel(fp, static_cast<size_t>(-1)) == NULL);
+    REQUIRE(errno == ENOMEM);
+    fclose(fp);
+  }
+
+  SECTION("read truncated file") {
+    FILE *fp = tmpfile();
+    int_int_table_locked_table *ltbl = int_int_table_lock_table(tbl);
+    REQUIRE(int_int_table_locked_table_write(ltbl, fp));
+    int_int_table_locked_table_free(ltbl);
+    const long full_size = ftell(fp);
+    FILE *truncated = tmpfile();
+    rewind(fp);
+    for (long i = 0; i < full_size - 1; ++i) {
+      fputc(fgetc(fp), truncated);
+    }
+    rewind(truncated);
+    REQUIRE(int_int_table_read(truncated) == NULL);
+    fclose(truncated);
+    fclose(fp);
+  }
+
   int_int_table_free(tbl);
 }
 
@@ -168,6 +386,22 @@ TEST_CASE("c interface locked table", "[c interface]") {
   int_int_table *tbl = int_int_table_init(0);
   int_int_table_locked_table *ltbl = int_int_table_lock_table(tbl);
 
+  SECTION("for_each") {
+    for (int i = 0; i < 10; ++i) {
+      int_int_table_locked_table_insert(ltbl, &i, &i, NULL);
+    }
+    int sum = 0;
+    int_int_table_locked_table_for_each(ltbl, cuckoo_for_each_fn, &sum);
+    REQUIRE(sum == 45);
+    int_int_table_const_iterator *it = int_int_table_locked_table_cbegin(ltbl);
+    for (int i = 0; i < 10; ++i) {
+      const int key = *int_int_table_const_iterator_key(it);
+      REQUIRE(*int_int_table_const_iterator_mapped(it) == key * 2);
+      int_int_table_const_iterator_increment(it);
+    }
+    int_int_table_const_iterator_free(it);
+  }
+
   SECTION("is_active/unlock") {
     REQUIRE(int_int_table_locked_table_is_active(ltbl));
     int_int_table_locked_table_unlock(ltbl);
@@ -313,3 +547,45 @@ TEST_CASE("c interface locked table", "[c interface]") {
   int_int_table_locked_table_free(ltbl);
   int_int_table_free(tbl);
 }
+
+TEST_CASE("c interface hash functions", "[c interface]") {
+  test_blob key;
+  memset(&key, 0, sizeof(key));
+
+  SECTION("blob keys are hashed as bytes by default") {
+    blob_int_table *tbl = blob_int_table_init(0);
+    for (int i = 0; i < 1000; ++i) {
+      memcpy(key.bytes + 4, &i, sizeof(i));
+      REQUIRE(blob_int_table_insert(tbl, &key, &i));
+    }
+    for (int i = 0; i < 1000; ++i) {
+      memcpy(key.bytes + 4, &i, sizeof(i));
+      int value;
+      REQUIRE(blob_int_table_find(tbl, &key, &value));
+      REQUIRE(value == i);
+    }
+    key.bytes[0] = 1;
+    REQUIRE_FALSE(blob_int_table_contains(tbl, &key));
+    blob_int_table_free(tbl);
+  }
+
+  SECTION("custom hash and equality functions") {
+    prefix_int_table *tbl = prefix_int_table_init(0);
+    const size_t calls = prefix_hash_calls;
+    int value = 1;
+    key.bytes[0] = 'a';
+    key.bytes[1] = 'b';
+    REQUIRE(prefix_int_table_insert(tbl, &key, &value));
+    REQUIRE(prefix_hash_calls > calls);
+    // Only the first two bytes matter
+    key.bytes[5] = 'z';
+    value = 2;
+    REQUIRE_FALSE(prefix_int_table_insert(tbl, &key, &value));
+    REQUIRE(prefix_int_table_find(tbl, &key, &value));
+    REQUIRE(value == 1);
+    key.bytes[1] = 'c';
+    REQUIRE_FALSE(prefix_int_table_contains(tbl, &key));
+    REQUIRE(prefix_int_table_size(tbl) == 1);
+    prefix_int_table_free(tbl);
+  }
+}
@@ -29,6 +29,52 @@ TEST_CASE("given size", "[constructor]") {
   REQUIRE(tbl.load_factor() == 0);
 }
 
+TEST_CASE("small table", "[constructor]") {
+  IntIntTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  REQUIRE(tbl.hashpower() == 0);
+  REQUIRE(libcuckoo::UnitTestInternalAccess::get_current_locks(tbl).size() ==
+          1);
+  // The table grows its buckets and locks together
+  for (int i = 0; i < 1000; ++i) {
+    REQUIRE(tbl.insert(i, i));
+  }
+  REQUIRE(libcuckoo::UnitTestInternalAccess::get_current_locks(tbl).size() ==
+          tbl.bucket_count());
+  for (int i = 0; i < 1000; ++i) {
+    REQUIRE(tbl.find(i) == i);
+  }
+}
+
+TEST_CASE("small table allocations", "[constructor]") {
+  // Large values make the size of a bucket stand out from the table's other
+  // allocations
+  typedef std::array<char, 1024> big_value;
+  typedef libcuckoo::cuckoohash_map<int, big_value, std::hash<int>,
+                                    std::equal_to<int>,
+                                    TrackingAllocator<int>, 4>
+      tracked_table;
+  // A table's other allocations are the same at any size, so the difference
+  // between a table with one bucket and one with two is one bucket and one
+  // lock
+  const int64_t base = get_unfreed_bytes();
+  int64_t one_bucket, two_buckets;
+  {
+    tracked_table tbl(libcuckoo::SMALL_TABLE_SIZE);
+    one_bucket = get_unfreed_bytes() - base;
+  }
+  {
+    tracked_table tbl(libcuckoo::SMALL_TABLE_SIZE * 2);
+    two_buckets = get_unfreed_bytes() - base;
+  }
+  const int64_t bucket_and_lock = two_buckets - one_bucket;
+  REQUIRE(bucket_and_lock > 4 * static_cast<int64_t>(sizeof(big_value)));
+  // Only the current buckets are allocated, not the old buckets used while
+  // resizing
+  REQUIRE(one_bucket <
+          bucket_and_lock + static_cast<int64_t>(sizeof(big_value)));
+  REQUIRE(get_unfreed_bytes() == base);
+}
+
 TEST_CASE("frees even with exceptions", "[constructor]") {
   typedef IntIntTableWithAlloc<TrackingAllocator<int, 0>> no_space_table;
   // Should throw when allocating anything
@@ -151,6 +197,20 @@ TEST_CASE("copy constructor other allocator", "[constructor]") {
   REQUIRE(map2.get_allocator().state == 30);
 }
 
+TEST_CASE("copy constructor after locking the table", "[constructor]") {
+  // Taking a locked_table frees the old buckets, which the copy must handle
+  IntIntTable map;
+  for (int i = 0; i < 10; ++i) {
+    map.insert(i, i);
+  }
+  { auto lt = map.lock_table(); }
+  IntIntTable map2(map);
+  REQUIRE(map2.size() == 10);
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(map2.find(i) == i);
+  }
+}
+
 TEST_CASE("move constructor", "[constructor]") {
   tbl_t map(10, StatefulHash(10), StatefulKeyEqual(20), alloc_t(30));
   map.insert(10, 10);
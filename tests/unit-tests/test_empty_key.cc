@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#include <catch.hpp>
+
+#include "unit_test_util.hh"
+#include <libcuckoo/cuckoohash_map.hh>
+
+using EmptyKeyTable = libcuckoo::cuckoohash_map<
+    uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+    std::allocator<std::pair<const uint64_t, uint64_t>>, 4,
+    libcuckoo::empty_key<uint64_t, std::numeric_limits<uint64_t>::max()>>;
+
+using FlaggedTable = libcuckoo::cuckoohash_map<uint64_t, uint64_t>;
+
+const uint64_t kEmpty = std::numeric_limits<uint64_t>::max();
+
+TEST_CASE("empty key bucket size", "[empty key]") {
+  // Without occupancy flags or partial keys, a bucket is just its keys and
+  // values
+  REQUIRE(libcuckoo::UnitTestInternalAccess::bucket_size<EmptyKeyTable>() ==
+          4 * 2 * sizeof(uint64_t));
+  REQUIRE(libcuckoo::UnitTestInternalAccess::bucket_size<EmptyKeyTable>() <
+          libcuckoo::UnitTestInternalAccess::bucket_size<FlaggedTable>());
+}
+
+TEST_CASE("empty key operations", "[empty key]") {
+  EmptyKeyTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  const uint64_t num_elems = 10000;
+  // Inserting into a table that starts with a single bucket runs cuckoo
+  // searches and resizes, which rehash the keys to find their partial keys
+  for (uint64_t i = 0; i < num_elems; ++i) {
+    REQUIRE(tbl.insert(i, i));
+  }
+  REQUIRE(tbl.size() == num_elems);
+  REQUIRE_FALSE(tbl.insert(0, 1));
+  for (uint64_t i = 0; i < num_elems; ++i) {
+    REQUIRE(tbl.find(i) == i);
+  }
+  REQUIRE_FALSE(tbl.contains(num_elems));
+  // The empty key matches every empty slot, but is never found
+  REQUIRE_FALSE(tbl.contains(kEmpty));
+  REQUIRE_FALSE(tbl.erase(kEmpty));
+
+  REQUIRE(tbl.update(1, 10));
+  REQUIRE(tbl.find(1) == 10);
+  for (uint64_t i = 0; i < num_elems; i += 2) {
+    REQUIRE(tbl.erase(i));
+  }
+  REQUIRE(tbl.size() == num_elems / 2);
+  for (uint64_t i = 0; i < num_elems; ++i) {
+    REQUIRE(tbl.contains(i) == (i % 2 == 1));
+  }
+
+  EmptyKeyTable copy(tbl);
+  REQUIRE(copy.size() == num_elems / 2);
+  size_t count = 0;
+  {
+    auto lt = copy.lock_table();
+    for (const auto &item : lt) {
+      REQUIRE(item.first % 2 == 1);
+      ++count;
+    }
+  }
+  REQUIRE(count == num_elems / 2);
+
+  tbl.clear();
+  REQUIRE(tbl.empty());
+  REQUIRE_FALSE(tbl.contains(1));
+}
+
+TEST_CASE("inserting the empty key", "[empty key]") {
+  EmptyKeyTable tbl;
+  REQUIRE_THROWS_AS(tbl.insert(kEmpty, 1), libcuckoo::empty_key_inserted);
+  REQUIRE_THROWS_AS(tbl.insert_or_assign(kEmpty, 1),
+                    libcuckoo::empty_key_inserted);
+  REQUIRE_THROWS_AS(tbl.upsert(kEmpty, [](uint64_t &) {}, 1),
+                    libcuckoo::empty_key_inserted);
+  REQUIRE(tbl.empty());
+  REQUIRE_FALSE(tbl.contains(kEmpty));
+
+  auto lt = tbl.lock_table();
+  REQUIRE_THROWS_AS(lt.insert(kEmpty, 1), libcuckoo::empty_key_inserted);
+  REQUIRE(lt.empty());
+}
+
+struct ThrowingValue {
+  ThrowingValue(bool fail) {
+    if (fail) {
+      throw std::runtime_error("ThrowingValue");
+    }
+  }
+};
+
+TEST_CASE("empty key value constructor throws", "[empty key]") {
+  libcuckoo::cuckoohash_map<
+      int, ThrowingValue, std::hash<int>, std::equal_to<int>,
+      std::allocator<std::pair<const int, ThrowingValue>>, 4,
+      libcuckoo::empty_key<int, -1>>
+      tbl(libcuckoo::SMALL_TABLE_SIZE);
+  REQUIRE_THROWS_AS(tbl.insert(1, true), std::runtime_error);
+  // The slot the key was being constructed in is empty again
+  REQUIRE(tbl.empty());
+  REQUIRE_FALSE(tbl.contains(1));
+  REQUIRE(tbl.insert(1, false));
+  REQUIRE(tbl.contains(1));
+}
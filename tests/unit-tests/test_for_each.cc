@@ -0,0 +1,120 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include "unit_test_util.hh"
+#include <libcuckoo/cuckoohash_map.hh>
+
+TEST_CASE("for_each empty table", "[for_each]") {
+  IntIntTable tbl;
+  size_t calls = 0;
+  REQUIRE(tbl.for_each([&calls](const int &, int &) { ++calls; }));
+  REQUIRE(calls == 0);
+}
+
+TEST_CASE("for_each visits every element once", "[for_each]") {
+  IntIntTable tbl;
+  const int num_elems = 10000;
+  for (int i = 0; i < num_elems; ++i) {
+    tbl.insert(i, i);
+  }
+  std::vector<int> seen(num_elems, 0);
+  REQUIRE(tbl.for_each([&seen](const int &k, int &v) {
+    ++seen[k];
+    v = k * 2;
+  }));
+  for (int i = 0; i < num_elems; ++i) {
+    REQUIRE(seen[i] == 1);
+    REQUIRE(tbl.find(i) == i * 2);
+  }
+}
+
+TEST_CASE("for_each after a lazy doubling", "[for_each]") {
+  IntIntTable tbl(1000);
+  for (int i = 0; i < 1000; ++i) {
+    tbl.insert(i, i);
+  }
+  // Doubling a table of nothrow-movable elements migrates its buckets lazily,
+  // so some of them are still in the old array when the scan starts
+  REQUIRE(tbl.rehash(tbl.hashpower() + 1));
+  size_t count = 0;
+  long long sum = 0;
+  REQUIRE(tbl.for_each([&](const int &k, int &) {
+    ++count;
+    sum += k;
+  }));
+  REQUIRE(count == 1000);
+  REQUIRE(sum == 999 * 1000 / 2);
+}
+
+TEST_CASE("for_each with concurrent writers", "[for_each]") {
+  // A high load factor makes the writer's inserts move elements along cuckoo
+  // paths, which can carry them between stripes during the scan
+  IntIntTable tbl(1 << 14);
+  const int num_stable = static_cast<int>(tbl.capacity() * 9 / 10);
+  for (int i = 0; i < num_stable; ++i) {
+    tbl.insert(i, 0);
+  }
+  tbl.maximum_hashpower(tbl.hashpower());
+  std::atomic<bool> done(false);
+  // Inserts and erases keys outside of the stable range while the scans run,
+  // keeping the table just short of full
+  std::thread writer([&tbl, &done, num_stable]() {
+    int key = num_stable;
+    while (!done.load()) {
+      try {
+        tbl.insert(key, 0);
+      } catch (libcuckoo::maximum_hashpower_exceeded &) {
+        // The table is full, which the erase below remedies
+      }
+      if (key - 100 >= num_stable) {
+        tbl.erase(key - 100);
+      }
+      ++key;
+      if (key == num_stable + 10000) {
+        for (int k = key - 100; k < key; ++k) {
+          tbl.erase(k);
+        }
+        key = num_stable;
+      }
+    }
+  });
+  // Failures are only checked once the writer has stopped
+  const int num_scans = 100;
+  size_t exact_scans = 0;
+  size_t wrong_exact_scans = 0;
+  for (int scan = 0; scan < num_scans; ++scan) {
+    std::vector<int> seen(num_stable, 0);
+    const bool exact = tbl.for_each([&seen, num_stable](const int &k, int &) {
+      if (k < num_stable) {
+        ++seen[k];
+      }
+    });
+    // Only a scan that reports no moves promises to see each element once
+    if (exact) {
+      ++exact_scans;
+      for (int i = 0; i < num_stable; ++i) {
+        if (seen[i] != 1) {
+          ++wrong_exact_scans;
+          break;
+        }
+      }
+    }
+  }
+  done.store(true);
+  writer.join();
+  INFO(exact_scans << " of " << num_scans << " scans saw no moves");
+  REQUIRE(wrong_exact_scans == 0);
+  // With no writers, nothing moves, so the scan is exact
+  std::vector<int> seen(num_stable, 0);
+  REQUIRE(tbl.for_each([&seen, num_stable](const int &k, int &) {
+    if (k < num_stable) {
+      ++seen[k];
+    }
+  }));
+  for (int i = 0; i < num_stable; ++i) {
+    REQUIRE(seen[i] == 1);
+  }
+}
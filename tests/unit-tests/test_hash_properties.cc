@@ -39,6 +39,20 @@ TEST_CASE("string alt index works correctly", "[hash properties]") {
   }
 }
 
+TEST_CASE("string partial keys are wider", "[hash properties]") {
+  // Strings get 15-bit partial keys, which leave the top bit free for the
+  // bucket's occupied flag
+  bool wide = false;
+  for (int key = 0; key < 10000; ++key) {
+    const size_t hv = StringIntTable::hasher()(std::to_string(key));
+    const size_t partial =
+        UnitTestInternalAccess::partial_key<StringIntTable>(hv);
+    REQUIRE(partial < 0x8000);
+    wide = wide || partial > 0xff;
+  }
+  REQUIRE(wide);
+}
+
 TEST_CASE("hash with larger hashpower only adds top bits",
           "[hash properties]") {
   std::string key = "abc";
@@ -0,0 +1,267 @@
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include "unit_test_util.hh"
+#include <libcuckoo/cuckoohash_map.hh>
+
+template <class Key, class T,
+          class Alloc = std::allocator<std::pair<const Key, T>>>
+using InlineTable =
+    libcuckoo::cuckoohash_map<Key, T, std::hash<Key>, std::equal_to<Key>,
+                              Alloc, 4, libcuckoo::no_empty_key, 16>;
+
+using InlineIntIntTable = InlineTable<int, int>;
+using InlineIntStringTable = InlineTable<int, std::string>;
+
+TEST_CASE("inline table allocates nothing", "[inline]") {
+  typedef InlineTable<int, int, TrackingAllocator<int>> tracked_table;
+  const int64_t base = get_unfreed_bytes();
+  {
+    tracked_table tbl(libcuckoo::SMALL_TABLE_SIZE);
+    REQUIRE(tbl.hashpower() == 0);
+    REQUIRE(tbl.bucket_count() == 0);
+    REQUIRE(tbl.capacity() == 16);
+    for (int i = 0; i < 16; ++i) {
+      REQUIRE(tbl.insert(i, i));
+    }
+    REQUIRE_FALSE(tbl.insert(0, 1));
+    REQUIRE(tbl.erase(5));
+    REQUIRE(tbl.insert(5, 50));
+    REQUIRE(tbl.size() == 16);
+    REQUIRE(tbl.load_factor() == 1);
+    REQUIRE(get_unfreed_bytes() == base);
+
+    // The next element doesn't fit, so the table moves them all into buckets
+    REQUIRE(tbl.insert(16, 16));
+    REQUIRE(get_unfreed_bytes() > base);
+    REQUIRE(tbl.bucket_count() > 0);
+    REQUIRE(tbl.capacity() == tbl.bucket_count() * tbl.slot_per_bucket());
+    REQUIRE(tbl.size() == 17);
+    for (int i = 0; i <= 16; ++i) {
+      REQUIRE(tbl.find(i) == (i == 5 ? 50 : i));
+    }
+  }
+  REQUIRE(get_unfreed_bytes() == base);
+}
+
+TEST_CASE("inline table of larger size", "[inline]") {
+  // Tables created for more elements than fit inline start out with buckets
+  InlineIntIntTable tbl(17);
+  REQUIRE(tbl.bucket_count() > 0);
+  REQUIRE(tbl.insert(1, 1));
+  REQUIRE(tbl.find(1) == 1);
+}
+
+TEST_CASE("inline table operations", "[inline]") {
+  InlineIntStringTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(tbl.insert(i, std::to_string(i)));
+  }
+  std::string val;
+  REQUIRE(tbl.find(3, val));
+  REQUIRE(val == "3");
+  REQUIRE_FALSE(tbl.find(10, val));
+  REQUIRE_THROWS_AS(tbl.find(10), std::out_of_range);
+
+  REQUIRE(tbl.update_fn(3, [](std::string &v) { v += "!"; }));
+  REQUIRE(tbl.find(3) == "3!");
+  REQUIRE(tbl.update(4, "four"));
+  REQUIRE(tbl.find(4) == "four");
+  REQUIRE_FALSE(tbl.update(10, "ten"));
+
+  REQUIRE_FALSE(tbl.upsert(4, [](std::string &v) { v = "FOUR"; }, "unused"));
+  REQUIRE(tbl.find(4) == "FOUR");
+  REQUIRE(tbl.upsert(10, [](std::string &) {}, "ten"));
+  REQUIRE_FALSE(tbl.insert_or_assign(10, "TEN"));
+  REQUIRE(tbl.find(10) == "TEN");
+
+  // Erasing moves the last element into the hole, which must stay findable
+  REQUIRE(tbl.erase_fn(0, [](std::string &) { return true; }));
+  REQUIRE(tbl.erase_fn(1, [](std::string &) { return false; }));
+  REQUIRE(tbl.erase(2));
+  REQUIRE_FALSE(tbl.erase(2));
+  REQUIRE_FALSE(tbl.uprase_fn(3, [](std::string &) { return true; }, "x"));
+  REQUIRE(tbl.size() == 8);
+  REQUIRE_FALSE(tbl.contains(0));
+  REQUIRE(tbl.contains(1));
+  REQUIRE_FALSE(tbl.contains(3));
+  REQUIRE(tbl.find(10) == "TEN");
+
+  size_t count = 0;
+  REQUIRE(tbl.for_each([&count](const int &k, std::string &v) {
+    v = std::to_string(k * 2);
+    ++count;
+  }));
+  REQUIRE(count == 8);
+  REQUIRE(tbl.find(10) == "20");
+  REQUIRE(tbl.bucket_count() == 0);
+
+  tbl.clear();
+  REQUIRE(tbl.empty());
+  REQUIRE_FALSE(tbl.contains(1));
+  REQUIRE(tbl.insert(1, "one"));
+  REQUIRE(tbl.find(1) == "one");
+}
+
+TEST_CASE("inline table copy, move and swap", "[inline]") {
+  InlineIntStringTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  for (int i = 0; i < 8; ++i) {
+    REQUIRE(tbl.insert(i, std::string(100, 'a' + i)));
+  }
+  InlineIntStringTable copy(tbl);
+  REQUIRE(copy.bucket_count() == 0);
+  REQUIRE(copy.size() == 8);
+  REQUIRE(copy.erase(0));
+  REQUIRE(tbl.contains(0));
+
+  InlineIntStringTable moved(std::move(copy));
+  REQUIRE(moved.size() == 7);
+  REQUIRE(moved.find(7) == std::string(100, 'h'));
+
+  InlineIntStringTable big(100);
+  for (int i = 100; i < 200; ++i) {
+    REQUIRE(big.insert(i, "big"));
+  }
+  swap(big, moved);
+  REQUIRE(big.bucket_count() == 0);
+  REQUIRE(big.size() == 7);
+  REQUIRE(big.find(1) == std::string(100, 'b'));
+  REQUIRE(moved.bucket_count() > 0);
+  REQUIRE(moved.size() == 100);
+  REQUIRE(moved.find(150) == "big");
+
+  moved = tbl;
+  REQUIRE(moved.bucket_count() == 0);
+  REQUIRE(moved.size() == 8);
+  REQUIRE(moved.find(0) == std::string(100, 'a'));
+  // Both tables can still grow independently
+  for (int i = 8; i < 100; ++i) {
+    REQUIRE(moved.insert(i, "x"));
+  }
+  REQUIRE(tbl.size() == 8);
+  REQUIRE(tbl.bucket_count() == 0);
+}
+
+TEST_CASE("inline table promotion is exception safe", "[inline]") {
+  InlineIntIntTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  for (int i = 0; i < 16; ++i) {
+    REQUIRE(tbl.insert(i, i));
+  }
+  // A single bucket can't hold the elements, so moving them into buckets
+  // fails, and they must all be moved back
+  tbl.maximum_hashpower(0);
+  REQUIRE_THROWS_AS(tbl.insert(16, 16), libcuckoo::maximum_hashpower_exceeded);
+  REQUIRE(tbl.bucket_count() == 0);
+  REQUIRE(tbl.size() == 16);
+  for (int i = 0; i < 16; ++i) {
+    REQUIRE(tbl.find(i) == i);
+  }
+  REQUIRE_FALSE(tbl.contains(16));
+
+  tbl.maximum_hashpower(libcuckoo::NO_MAXIMUM_HASHPOWER);
+  REQUIRE(tbl.insert(16, 16));
+  REQUIRE(tbl.bucket_count() > 0);
+  REQUIRE(tbl.size() == 17);
+}
+
+TEST_CASE("inline table resizing", "[inline]") {
+  InlineIntIntTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(tbl.insert(i, i));
+  }
+  REQUIRE_FALSE(tbl.reserve(16));
+  REQUIRE(tbl.bucket_count() == 0);
+  REQUIRE(tbl.reserve(1000));
+  REQUIRE(tbl.capacity() >= 1000);
+  REQUIRE(tbl.size() == 10);
+
+  InlineIntIntTable tbl2(libcuckoo::SMALL_TABLE_SIZE);
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(tbl2.insert(i, i));
+  }
+  REQUIRE(tbl2.rehash(3));
+  REQUIRE(tbl2.hashpower() == 3);
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(tbl2.find(i) == i);
+  }
+}
+
+TEST_CASE("inline table lock_table", "[inline]") {
+  InlineIntIntTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(tbl.insert(i, i));
+  }
+  {
+    auto lt = tbl.lock_table();
+    size_t count = 0;
+    for (const auto &item : lt) {
+      REQUIRE(item.first == item.second);
+      ++count;
+    }
+    REQUIRE(count == 10);
+    lt[10] = 10;
+  }
+  REQUIRE(tbl.bucket_count() > 0);
+  REQUIRE(tbl.size() == 11);
+  REQUIRE(tbl.find(10) == 10);
+}
+
+TEST_CASE("inline table empty key", "[inline]") {
+  using EmptyKeyInlineTable = libcuckoo::cuckoohash_map<
+      uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+      std::allocator<std::pair<const uint64_t, uint64_t>>, 4,
+      libcuckoo::empty_key<uint64_t, std::numeric_limits<uint64_t>::max()>,
+      16>;
+  EmptyKeyInlineTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  const uint64_t empty = std::numeric_limits<uint64_t>::max();
+  REQUIRE_THROWS_AS(tbl.insert(empty, 1), libcuckoo::empty_key_inserted);
+  REQUIRE(tbl.empty());
+  for (uint64_t i = 0; i < 100; ++i) {
+    REQUIRE(tbl.insert(i, i));
+  }
+  REQUIRE_FALSE(tbl.contains(empty));
+  REQUIRE(tbl.size() == 100);
+}
+
+TEST_CASE("inline table with concurrent inserts", "[inline]") {
+  // The threads race to fill the inline storage, and then to move it into
+  // buckets, while readers look up keys that were inserted before they
+  // started
+  InlineIntIntTable tbl(libcuckoo::SMALL_TABLE_SIZE);
+  for (int i = 0; i < 8; ++i) {
+    REQUIRE(tbl.insert(-1 - i, i));
+  }
+  const int num_threads = 4;
+  const int per_thread = 2000;
+  std::atomic<bool> go(false);
+  std::atomic<int> missed(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&tbl, &go, &missed, t]() {
+      while (!go.load()) {
+      }
+      for (int i = 0; i < per_thread; ++i) {
+        tbl.insert(i * num_threads + t, i);
+        if (!tbl.contains(-1 - (i % 8))) {
+          ++missed;
+        }
+      }
+    });
+  }
+  go.store(true);
+  for (std::thread &t : threads) {
+    t.join();
+  }
+  REQUIRE(missed.load() == 0);
+  REQUIRE(tbl.size() == num_threads * per_thread + 8);
+  for (int i = 0; i < num_threads * per_thread; ++i) {
+    REQUIRE(tbl.find(i) == i / num_threads);
+  }
+}
@@ -0,0 +1,115 @@
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch.hpp>
+
+#include <libcuckoo/cuckoohash_map.hh>
+#include <libcuckoo/cuckoohash_shared.hh>
+
+using libcuckoo::shared_allocator;
+using libcuckoo::shared_region;
+
+using SharedTable = libcuckoo::cuckoohash_map<
+    uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+    shared_allocator<std::pair<const uint64_t, uint64_t>>>;
+
+const size_t kRegionSize = 64 << 20;
+
+// Names the region after the process, so that concurrent test runs don't
+// collide, and removes it when the test is done
+class TestRegionName {
+public:
+  TestRegionName()
+      : name_("/libcuckoo_test_" + std::to_string(getpid())) {
+    shared_region::remove(name_);
+  }
+  ~TestRegionName() { shared_region::remove(name_); }
+  const std::string &str() const { return name_; }
+
+private:
+  std::string name_;
+};
+
+TEST_CASE("shared table survives reopening", "[shared]") {
+  TestRegionName name;
+  {
+    shared_region region = shared_region::create(name.str(), kRegionSize);
+    REQUIRE(region.root<SharedTable>() == nullptr);
+    SharedTable *tbl = region.construct<SharedTable>(
+        1000, SharedTable::hasher(), SharedTable::key_equal(),
+        SharedTable::allocator_type(region));
+    for (uint64_t i = 0; i < 1000; ++i) {
+      REQUIRE(tbl->insert(i, i * 2));
+    }
+    REQUIRE(region.allocated() > 0);
+  }
+  shared_region region = shared_region::open(name.str());
+  SharedTable *tbl = region.root<SharedTable>();
+  REQUIRE(tbl != nullptr);
+  REQUIRE(tbl->size() == 1000);
+  for (uint64_t i = 0; i < 1000; ++i) {
+    REQUIRE(tbl->find(i) == i * 2);
+  }
+  // Growing the table allocates its new buckets and locks from the region
+  for (uint64_t i = 1000; i < 100000; ++i) {
+    REQUIRE(tbl->insert(i, i * 2));
+  }
+  REQUIRE(tbl->find(99999) == 99999 * 2);
+  region.destroy<SharedTable>();
+  REQUIRE(region.root<SharedTable>() == nullptr);
+  REQUIRE(region.allocated() == 0);
+}
+
+TEST_CASE("shared table used by another process", "[shared]") {
+  TestRegionName name;
+  shared_region region = shared_region::create(name.str(), kRegionSize);
+  SharedTable *tbl = region.construct<SharedTable>(
+      10000, SharedTable::hasher(), SharedTable::key_equal(),
+      SharedTable::allocator_type(region));
+  for (uint64_t i = 0; i < 5000; ++i) {
+    tbl->insert(i, i);
+  }
+  const pid_t pid = fork();
+  REQUIRE(pid >= 0);
+  if (pid == 0) {
+    // The child sees the parent's elements, and adds its own. It exits
+    // without running any destructors, which would free memory in the region.
+    bool ok = true;
+    for (uint64_t i = 0; i < 5000; ++i) {
+      ok = ok && tbl->find(i) == i;
+      ok = ok && tbl->insert(i + 5000, i);
+    }
+    _exit(ok ? 0 : 1);
+  }
+  int status;
+  REQUIRE(waitpid(pid, &status, 0) == pid);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+  REQUIRE(tbl->size() == 10000);
+  for (uint64_t i = 0; i < 5000; ++i) {
+    REQUIRE(tbl->find(i + 5000) == i);
+  }
+  region.destroy<SharedTable>();
+}
+
+TEST_CASE("shared region errors", "[shared]") {
+  TestRegionName name;
+  REQUIRE_THROWS_AS(shared_region::open(name.str()), std::system_error);
+  shared_region region = shared_region::create(name.str(), kRegionSize);
+  REQUIRE_THROWS_AS(shared_region::create(name.str(), kRegionSize),
+                    std::system_error);
+  // The region is already mapped at its address in this process
+  REQUIRE_THROWS_AS(shared_region::open(name.str()), std::system_error);
+  SharedTable::allocator_type alloc(region);
+  REQUIRE_THROWS_AS(alloc.allocate(kRegionSize), std::bad_alloc);
+  // Freed blocks are reused
+  auto *p = alloc.allocate(100);
+  alloc.deallocate(p, 100);
+  REQUIRE(alloc.allocate(100) == p);
+  alloc.deallocate(p, 100);
+  REQUIRE(region.allocated() == 0);
+}
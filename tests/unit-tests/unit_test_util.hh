@@ -147,6 +147,10 @@ public:
     return CuckoohashMap::alt_index(hashpower, partial, index);
   }
 
+  template <class CuckoohashMap> static size_t bucket_size() {
+    return sizeof(typename CuckoohashMap::bucket);
+  }
+
   template <class CuckoohashMap> static size_t reserve_calc(size_t n) {
     return CuckoohashMap::reserve_calc(n);
   }
@@ -0,0 +1,257 @@
+/* Benchmarks a table that grows from a tiny size to a large one while serving
+ * reads. Writer threads insert keys until the table reaches the target size,
+ * and reader threads concurrently look up keys that have already been
+ * inserted, timing each lookup. The table is built with resize statistics
+ * enabled, so the time spent taking all the locks, doubling the table,
+ * rebuilding it, and lazily migrating buckets after a doubling is reported
+ * separately, next to the reader latencies they cause. */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libcuckoo/cuckoohash_map.hh>
+#include <pcg/pcg_random.hpp>
+#include <test_util.hh>
+
+#include "universal_latency.hh"
+
+#if !LIBCUCKOO_RESIZE_STATS
+#error "growth_benchmark must be built with LIBCUCKOO_RESIZE_STATS=1"
+#endif
+
+using Table = libcuckoo::cuckoohash_map<uint64_t, uint64_t>;
+
+// The table initially holds 2^g_initial_capacity elements
+size_t g_initial_capacity = 4;
+// The writers insert 2^g_final_capacity keys in total
+size_t g_final_capacity = 22;
+size_t g_writers = 4;
+size_t g_readers = 4;
+// Readers time one out of every this many lookups
+size_t g_latency_sample_period = 1;
+// The seed for the random number generator, or 0 for a random seed
+size_t g_seed = 0;
+
+// Each writer's count of inserted keys, on its own cache line. Writer `w`
+// inserts the keys w, w + g_writers, w + 2 * g_writers, and so on, so the
+// first `inserted` of its keys are all in the table.
+struct WriterProgress {
+  WriterProgress() : inserted(0) {}
+  std::atomic<size_t> inserted;
+  char padding[64 - sizeof(std::atomic<size_t>)];
+};
+
+void writer(Table &table, std::vector<WriterProgress> &progress,
+            const size_t writer_id, const size_t num_keys) {
+  for (size_t i = 0; i < num_keys; ++i) {
+    ASSERT_TRUE(table.insert(writer_id + i * g_writers, i));
+    progress[writer_id].inserted.store(i + 1, std::memory_order_release);
+  }
+}
+
+void reader(Table &table, std::vector<WriterProgress> &progress,
+            std::atomic<bool> &done, LatencyRecorder &latency,
+            std::atomic<size_t> &lookups, const size_t seed) {
+  pcg64_oneseq_once_insecure rng(seed);
+  std::uniform_int_distribution<size_t> writer_dist(0, g_writers - 1);
+  size_t num_lookups = 0;
+  uint64_t value;
+  while (!done.load(std::memory_order_acquire)) {
+    const size_t w = writer_dist(rng);
+    const size_t inserted = progress[w].inserted.load(std::memory_order_acquire);
+    if (inserted == 0) {
+      continue;
+    }
+    const uint64_t key =
+        w + std::uniform_int_distribution<size_t>(0, inserted - 1)(rng) *
+                g_writers;
+    const bool timed = latency.sample();
+    LatencyRecorder::clock::time_point start;
+    if (timed) {
+      start = LatencyRecorder::clock::now();
+    }
+    const bool found = table.find(key, value);
+    if (timed) {
+      latency.record(0, LatencyRecorder::clock::now() - start);
+    }
+    ASSERT_TRUE(found);
+    ++num_lookups;
+  }
+  lookups.fetch_add(num_lookups, std::memory_order_relaxed);
+}
+
+// Formats one phase of resizing as a JSON object, and prints it to stderr
+std::string report_phase(const char *name, const size_t count,
+                         const uint64_t ns) {
+  std::cerr << "  " << name << ": count " << count << ", " << ns / 1e6
+            << " ms\n";
+  std::stringstream json;
+  json << "\n            \"" << name << "\": {\"count\": " << count
+       << ", \"ms\": " << ns / 1e6 << "}";
+  return json.str();
+}
+
+int main(int argc, char **argv) {
+  try {
+    const char *args[] = {"--initial-capacity", "--final-capacity",
+                          "--writers",          "--readers",
+                          "--latency-sample-period", "--seed"};
+    size_t *arg_vars[] = {&g_initial_capacity, &g_final_capacity,
+                          &g_writers,          &g_readers,
+                          &g_latency_sample_period, &g_seed};
+    const char *arg_descriptions[] = {
+        "Initial number of elements the table is sized for, as a power of 2",
+        "Number of keys inserted in total, as a power of 2",
+        "Number of threads inserting keys",
+        "Number of threads looking up keys while the table grows",
+        "Readers time one out of every this many lookups",
+        "Seed for the random number generator, or 0 for a random seed"};
+    parse_flags(argc, argv, "Benchmarks lookups in a table that is growing",
+                args, arg_vars, arg_descriptions,
+                sizeof(args) / sizeof(const char *), nullptr, nullptr, nullptr,
+                0);
+    if (g_writers == 0) {
+      throw std::runtime_error("Must have at least one writer\n");
+    }
+    if (g_latency_sample_period == 0) {
+      throw std::runtime_error("Latency sample period must be positive\n");
+    }
+    if (g_final_capacity <= g_initial_capacity) {
+      throw std::runtime_error(
+          "Final capacity must be larger than the initial capacity\n");
+    }
+    if (g_seed == 0) {
+      g_seed = std::random_device()();
+    }
+
+    Table table(1UL << g_initial_capacity);
+    const size_t initial_hashpower = table.hashpower();
+    const size_t total_keys = 1UL << g_final_capacity;
+    std::vector<WriterProgress> progress(g_writers);
+    std::atomic<bool> done(false);
+    std::atomic<size_t> lookups(0);
+    std::vector<LatencyRecorder> latencies(
+        g_readers, LatencyRecorder(1, g_latency_sample_period));
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < g_readers; ++i) {
+      readers.emplace_back(reader, std::ref(table), std::ref(progress),
+                           std::ref(done), std::ref(latencies[i]),
+                           std::ref(lookups), g_seed + i);
+    }
+    const auto start_time = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for (size_t i = 0; i < g_writers; ++i) {
+      // Spread the remainder over the first few writers
+      const size_t num_keys =
+          total_keys / g_writers + (i < total_keys % g_writers ? 1 : 0);
+      writers.emplace_back(writer, std::ref(table), std::ref(progress), i,
+                           num_keys);
+    }
+    for (std::thread &t : writers) {
+      t.join();
+    }
+    const auto end_time = std::chrono::steady_clock::now();
+    done.store(true, std::memory_order_release);
+    for (std::thread &t : readers) {
+      t.join();
+    }
+    ASSERT_EQ(table.size(), total_keys);
+
+    const double seconds_elapsed =
+        std::chrono::duration_cast<std::chrono::duration<double>>(end_time -
+                                                                  start_time)
+            .count();
+    for (size_t i = 1; i < g_readers; ++i) {
+      latencies[0].merge(latencies[i]);
+    }
+
+    std::stringstream argstr;
+    for (size_t i = 0; i < sizeof(args) / sizeof(args[0]); ++i) {
+      argstr << (i == 0 ? "" : " ") << args[i] << " " << *arg_vars[i];
+    }
+
+    std::cerr << "Resize phases\n";
+    const Table::resize_stats stats = table.get_resize_stats();
+    std::stringstream phases;
+    phases << report_phase("lock_all", stats.lock_all_count,
+                           stats.lock_all_ns)
+           << ","
+           << report_phase("fast_double", stats.fast_double_count,
+                           stats.fast_double_ns)
+           << ","
+           << report_phase("expand_simple", stats.expand_simple_count,
+                           stats.expand_simple_ns)
+           << ","
+           << report_phase("lazy_rehash", stats.lazy_rehash_count,
+                           stats.lazy_rehash_ns);
+
+    std::stringstream latency;
+    if (g_readers > 0) {
+      const Histogram &hist = latencies[0].histogram(0);
+      std::cerr << "Lookup latency (nanoseconds): count "
+                << hist.total_count() << ", p50 " << hist.percentile(50.0)
+                << ", p99 " << hist.percentile(99.0) << ", p99.9 "
+                << hist.percentile(99.9) << ", max " << hist.max() << "\n";
+      latency << ",\n        \"lookup_latency\": {"
+              << "\n            \"name\": \"Lookup Latency\","
+              << "\n            \"units\": \"nanoseconds\","
+              << "\n            \"value\": {\"count\": " << hist.total_count()
+              << ", \"p50\": " << hist.percentile(50.0)
+              << ", \"p99\": " << hist.percentile(99.0)
+              << ", \"p99.9\": " << hist.percentile(99.9)
+              << ", \"max\": " << hist.max() << "}\n        }";
+    }
+
+    const char *json_format = R"({
+    "args": "%s",
+    "output": {
+        "initial_hashpower": {
+            "name": "Initial Hashpower",
+            "units": "count",
+            "value": %zu
+        },
+        "final_hashpower": {
+            "name": "Final Hashpower",
+            "units": "count",
+            "value": %zu
+        },
+        "time_elapsed": {
+            "name": "Time Elapsed",
+            "units": "seconds",
+            "value": %.4f
+        },
+        "insert_throughput": {
+            "name": "Insert Throughput",
+            "units": "count/seconds",
+            "value": %.4f
+        },
+        "lookups": {
+            "name": "Lookups",
+            "units": "count",
+            "value": %zu
+        },
+        "resize_phases": {%s
+        }%s
+    }
+}
+)";
+    printf(json_format, argstr.str().c_str(), initial_hashpower,
+           table.hashpower(), seconds_elapsed, total_keys / seconds_elapsed,
+           lookups.load(), phases.str().c_str(), latency.str().c_str());
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    std::exit(1);
+  }
+  return main_return_value;
+}
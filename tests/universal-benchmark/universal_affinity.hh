@@ -0,0 +1,147 @@
+#ifndef _UNIVERSAL_AFFINITY_HH
+#define _UNIVERSAL_AFFINITY_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/* Pins benchmark threads to CPUs, so that results don't depend on where the
+ * scheduler happens to place threads. Thread i is pinned to the i-th CPU of an
+ * ordering determined by the pinning strategy, wrapping around if there are
+ * more threads than CPUs. Only the CPUs the process is allowed to run on are
+ * used. The strategies are
+ *
+ * none      threads are not pinned
+ * compact   fill each physical core, including all of its hyperthreads, before
+ *           moving on to the next core, and each socket before the next one
+ * scatter   alternate between sockets, using every physical core of a socket
+ *           before using any of its hyperthreads
+ * physical  use one hyperthread of every physical core, in socket order,
+ *           before using any core's second hyperthread
+ *
+ * The topology is read from /sys/devices/system/cpu, so pinning is only
+ * supported on Linux. */
+
+class ThreadPinner {
+public:
+  explicit ThreadPinner(const std::string &strategy) : strategy_(strategy) {
+    if (strategy == "none") {
+      return;
+    }
+    if (strategy != "compact" && strategy != "scatter" &&
+        strategy != "physical") {
+      throw std::runtime_error("Invalid pinning strategy `" + strategy +
+                               "`\n");
+    }
+#ifdef __linux__
+    std::vector<cpu_info> cpus;
+    std::map<std::pair<int, int>, int> threads_per_core;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      throw std::runtime_error("Could not get the process's CPU affinity\n");
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (!CPU_ISSET(cpu, &allowed)) {
+        continue;
+      }
+      cpu_info info;
+      info.cpu = cpu;
+      info.socket = read_topology(cpu, "physical_package_id");
+      info.core = read_topology(cpu, "core_id");
+      info.thread = threads_per_core[std::make_pair(info.socket, info.core)]++;
+      cpus.push_back(info);
+    }
+    // For scatter, number each socket's CPUs in physical-cores-first order,
+    // so that ordering by that number interleaves the sockets
+    std::sort(cpus.begin(), cpus.end(),
+              [](const cpu_info &a, const cpu_info &b) {
+                return std::make_tuple(a.socket, a.thread, a.core) <
+                       std::make_tuple(b.socket, b.thread, b.core);
+              });
+    std::map<int, int> cpus_in_socket;
+    for (cpu_info &info : cpus) {
+      info.rank_in_socket = cpus_in_socket[info.socket]++;
+    }
+    std::sort(cpus.begin(), cpus.end(),
+              [&strategy](const cpu_info &a, const cpu_info &b) {
+                return a.key(strategy) < b.key(strategy);
+              });
+    for (const cpu_info &info : cpus) {
+      order_.push_back(info.cpu);
+    }
+#else
+    throw std::runtime_error("Pinning threads is only supported on Linux\n");
+#endif
+  }
+
+  const std::string &strategy() const { return strategy_; }
+
+  // The CPUs threads are pinned to, in order. Empty if threads aren't pinned.
+  const std::vector<int> &order() const { return order_; }
+
+  // Pins the `i`-th benchmark thread
+  void pin(std::thread &t, size_t i) const {
+    if (order_.empty()) {
+      return;
+    }
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(order_[i % order_.size()], &cpuset);
+    if (pthread_setaffinity_np(t.native_handle(), sizeof(cpuset), &cpuset) !=
+        0) {
+      throw std::runtime_error("Could not pin thread to a CPU\n");
+    }
+#endif
+  }
+
+private:
+  struct cpu_info {
+    int cpu;
+    int socket;
+    int core;
+    // Index of this CPU among the hyperthreads of its core
+    int thread;
+    // Index of this CPU within its socket, in physical-cores-first order
+    int rank_in_socket;
+
+    std::tuple<int, int, int> key(const std::string &strategy) const {
+      if (strategy == "compact") {
+        return std::make_tuple(socket, core, thread);
+      } else if (strategy == "physical") {
+        return std::make_tuple(thread, socket, core);
+      } else {
+        return std::make_tuple(rank_in_socket, socket, 0);
+      }
+    }
+  };
+
+  // Reads a topology attribute of a CPU. If the topology isn't available, each
+  // CPU is treated as its own core in a single socket.
+  static int read_topology(int cpu, const char *attribute) {
+    std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                     "/topology/" + attribute);
+    int value;
+    if (!(in >> value)) {
+      return std::string(attribute) == "core_id" ? cpu : 0;
+    }
+    return value;
+  }
+
+  std::string strategy_;
+  std::vector<int> order_;
+};
+
+#endif // _UNIVERSAL_AFFINITY_HH
@@ -1,4 +1,5 @@
-/* Benchmarks a mix of operations for a compile-time specified key-value pair */
+/* Benchmarks a mix of operations for a run-time selected key-value pair and
+ * table configuration */
 
 #include <algorithm>
 #include <array>
@@ -9,6 +10,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <random>
 #include <sstream>
 #include <stdexcept>
@@ -19,8 +22,31 @@
 #include <pcg/pcg_random.hpp>
 #include <test_util.hh>
 
+#include "universal_affinity.hh"
+#include "universal_distribution.hh"
 #include "universal_gen.hh"
+#include "universal_latency.hh"
+#include "universal_memory.hh"
 #include "universal_table_wrapper.hh"
+#include "universal_timeline.hh"
+#include "universal_trace.hh"
+
+#define XSTR(s) STR(s)
+#define STR(s) #s
+
+// The key and value types used when they aren't specified on the command line.
+// These can be changed at compile time through CMake.
+#ifndef DEFAULT_KEY
+#define DEFAULT_KEY uint64_t
+#endif
+
+#ifndef DEFAULT_VALUE
+#define DEFAULT_VALUE uint64_t
+#endif
+
+#ifndef DEFAULT_TABLE
+#define DEFAULT_TABLE LIBCUCKOO
+#endif
 
 /* Run-time parameters -- operation mix and table configuration */
 
@@ -41,18 +67,86 @@ size_t g_prefill_percentage = 0;
 // initial capacity. This can exceed 100.
 size_t g_total_ops_percentage = 75;
 
+// Number of slots per bucket of the table. Must be 2, 4, or 8. Only applies to
+// the libcuckoo table.
+size_t g_slots = libcuckoo::DEFAULT_SLOT_PER_BUCKET;
+
 // Number of threads to run with
 size_t g_threads = std::thread::hardware_concurrency();
 
+// If non-empty, a comma-separated list of thread counts to run the benchmark
+// with in turn, overriding `g_threads`, for measuring how the table scales.
+std::string g_thread_counts;
+
+// How to pin benchmark threads to CPUs. See universal_affinity.hh for the
+// supported strategies.
+std::string g_pin = "none";
+ThreadPinner g_pinner("none");
+
+// If non-empty, record the operations run by the benchmark to this file, in
+// the format described in universal_trace.hh.
+std::string g_trace_record;
+
+// If non-empty, replay the operations in this trace file instead of running a
+// synthetic operation mix. `g_trace_partition` decides how the trace is split
+// between threads: "ordered" gives each thread the operations of one thread in
+// the trace, in their original order, while "key" gives each thread all the
+// operations on a subset of the keys.
+std::string g_trace_replay;
+std::string g_trace_partition = "ordered";
+const TraceFile *g_trace = nullptr;
+
 // Seed for random number generator. If left at the default (0), we'll generate
 // a random seed.
 size_t g_seed = 0;
 
+// Time one out of every this many operations, and report latency percentiles
+// for each operation type. If left at the default (0), latencies are not
+// recorded.
+size_t g_latency_sample_period = 0;
+
+// The key and value types of the table. Each must name one of the types in
+// universal_gen.hh.
+std::string g_key = XSTR(DEFAULT_KEY);
+std::string g_value = XSTR(DEFAULT_VALUE);
+
+// The table to benchmark. Must be the name of one of the wrappers in
+// universal_table_wrapper.hh, or ALL to run the same workload against each of
+// them in turn and compare the results.
+std::string g_table = XSTR(DEFAULT_TABLE);
+
+// The distribution of keys chosen by operations other than inserts. See
+// universal_distribution.hh for the supported distributions.
+std::string g_distribution = "uniform";
+
+// If non-empty, the distribution of the lengths of std::string keys, and the
+// number and length of the prefixes they share, as "<count>:<length>". See
+// universal_gen.hh for the supported length distributions.
+std::string g_key_length;
+std::string g_key_prefix;
+
+// If non-empty, the distribution of the lengths of std::string values.
+std::string g_value_length;
+
+// Record the throughput of each thread over every interval of this many
+// milliseconds, along with any resizes of the table. If left at the default
+// (0), no timeline is recorded.
+size_t g_timeline_interval = 0;
+
+// If non-empty, also write the throughput timeline to this file, as CSV.
+std::string g_timeline_csv;
+
+// Sample the memory use of the process every this many milliseconds, from
+// just before the table is created until the end of the run. If set to 0,
+// memory isn't sampled.
+size_t g_memory_interval = 10;
+
 const char *args[] = {
     "--reads",   "--inserts",   "--erases",
     "--updates", "--upserts",   "--initial-capacity",
-    "--prefill", "--total-ops", "--num-threads",
-    "--seed",
+    "--prefill", "--total-ops", "--slots",
+    "--num-threads", "--seed",  "--latency-sample-period",
+    "--timeline-interval", "--memory-interval",
 };
 
 size_t *arg_vars[] = {
@@ -64,8 +158,12 @@ size_t *arg_vars[] = {
     &g_initial_capacity,
     &g_prefill_percentage,
     &g_total_ops_percentage,
+    &g_slots,
     &g_threads,
     &g_seed,
+    &g_latency_sample_period,
+    &g_timeline_interval,
+    &g_memory_interval,
 };
 
 const char *arg_descriptions[] = {
@@ -76,17 +174,76 @@ const char *arg_descriptions[] = {
     "Percentage of final size to pre-fill table",
     "Number of operations, as a percentage of the initial capacity. This can "
     "exceed 100",
+    "Number of slots per bucket (2, 4, or 8)",
     "Number of threads", "Seed for random number generator",
+    "Record the latency of one in this many operations (0 disables latency "
+    "recording)",
+    "Record per-thread throughput over intervals of this many milliseconds "
+    "(0 disables the timeline)",
+    "Sample the process's memory use every this many milliseconds (0 "
+    "disables memory sampling)",
 };
 
-#define XSTR(s) STR(s)
-#define STR(s) #s
+const char *str_args[] = {
+    "--table",
+    "--key",
+    "--value",
+    "--distribution",
+    "--timeline-csv",
+    "--threads",
+    "--pin",
+    "--trace-record",
+    "--trace-replay",
+    "--trace-partition",
+    "--key-length",
+    "--key-prefix",
+    "--value-length",
+};
+
+std::string *str_arg_vars[] = {
+    &g_table,
+    &g_key,
+    &g_value,
+    &g_distribution,
+    &g_timeline_csv,
+    &g_thread_counts,
+    &g_pin,
+    &g_trace_record,
+    &g_trace_replay,
+    &g_trace_partition,
+    &g_key_length,
+    &g_key_prefix,
+    &g_value_length,
+};
+
+const char *str_arg_descriptions[] = {
+    "Table to benchmark (LIBCUCKOO, LOCKED_TABLE, UNORDERED_MAP, "
+    "STRIPED_UNORDERED_MAP, SHARDED_UNORDERED_MAP, or ALL to compare all of "
+    "them)",
+    "Key type (uint64_t, std::string, MediumBlob, or BigBlob)",
+    "Value type (uint64_t, std::string, MediumBlob, or BigBlob)",
+    "Distribution of keys chosen by reads, erases, updates, and upserts. One "
+    "of uniform, zipf:<theta>, or hotset:<fraction>:<probability>",
+    "File to write the throughput timeline to, as CSV",
+    "Comma-separated list of thread counts to sweep over (e.g. 1,2,4,8), "
+    "overriding --num-threads",
+    "How to pin threads to CPUs. One of none, compact, scatter, or physical",
+    "File to record a trace of the benchmark's operations to",
+    "Trace file to replay instead of running the operation mix",
+    "How to split a replayed trace between threads. One of ordered (keep each "
+    "recorded thread's operations in order) or key (shard by key)",
+    "Length distribution of std::string keys. One of fixed:<n>, "
+    "uniform:<min>:<max>, or lognormal:<median>:<sigma>",
+    "Prefixes shared by std::string keys, as <count>:<length>",
+    "Length distribution of std::string values, in the same format as "
+    "--key-length",
+};
 
 const char *description =
     "A benchmark that can run an arbitrary mixture of "
     "table operations.\nThe sum of read, insert, erase, update, and upsert "
-    "percentages must be 100.\nMap type is " TABLE_TYPE
-    "<" XSTR(KEY) ", " XSTR(VALUE) ">.";
+    "percentages must be 100.\nMap type is --table<--key, --value>, with "
+    "--slots slots per bucket.";
 
 void check_percentage(size_t value, const char *name) {
   if (value > 100) {
@@ -103,36 +260,91 @@ enum Ops {
   ERASE,
   UPDATE,
   UPSERT,
+  NUM_OPS,
 };
 
+const char *op_names[] = {"read", "insert", "erase", "update", "upsert"};
+
 void gen_nums(std::vector<uint64_t> &nums, pcg64_oneseq_once_insecure &rng) {
   for (uint64_t &num : nums) {
     num = rng();
   }
 }
 
+template <typename Key>
 void gen_keys(std::vector<uint64_t> &nums,
-              std::vector<Gen<KEY>::storage_type> &keys) {
+              std::vector<typename Gen<Key>::storage_type> &keys) {
   const size_t n = nums.size();
   for (size_t i = 0; i < n; ++i) {
-    keys[i] = Gen<KEY>::storage_key(nums[i]);
+    keys[i] = Gen<Key>::storage_key(nums[i]);
   }
 }
 
-void prefill(Table &tbl, const std::vector<Gen<KEY>::storage_type> &keys,
-             const size_t prefill_elems) {
-  Gen<VALUE>::storage_type local_value = Gen<VALUE>::storage_value();
+void gen_find_indices(const KeyDistribution &dist, const size_t seed,
+                      std::vector<size_t> &find_indices) {
+  pcg64_oneseq_once_insecure rng(seed);
+  dist.generate(find_indices.size(), find_indices, rng);
+}
+
+// The values written by inserts, updates, and upserts are taken in turn from a
+// pool generated along with the keys, so that generating them isn't timed. If
+// the values all have the same size, they're all the same, and the pool holds
+// just one, which stays in cache the way a single local value would.
+constexpr size_t VALUE_POOL_SIZE = 1024;
+
+template <typename Value>
+std::vector<typename Gen<Value>::storage_type>
+gen_values(pcg64_oneseq_once_insecure &rng) {
+  const size_t n = g_value_length.empty() ? 1 : VALUE_POOL_SIZE;
+  std::vector<typename Gen<Value>::storage_type> values;
+  values.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    values.push_back(Gen<Value>::storage_value(rng()));
+  }
+  return values;
+}
+
+// Cycles through a pool of values. Each thread has its own cursor.
+template <typename Value> class ValueCursor {
+public:
+  using storage_type = typename Gen<Value>::storage_type;
+
+  ValueCursor(const std::vector<storage_type> &values, size_t start)
+      : values_(values), mask_(values.size() - 1), next_(start) {}
+
+  const storage_type &next() { return values_[next_++ & mask_]; }
+
+private:
+  const std::vector<storage_type> &values_;
+  const size_t mask_;
+  size_t next_;
+};
+
+template <typename Key, typename Value, typename Table>
+void prefill(Table &tbl, const std::vector<uint64_t> &nums,
+             const std::vector<typename Gen<Key>::storage_type> &keys,
+             const std::vector<typename Gen<Value>::storage_type> &values,
+             const size_t prefill_elems, TraceRecorder &trace,
+             const size_t thread_id) {
+  ValueCursor<Value> value_cursor(values, thread_id);
   for (size_t i = 0; i < prefill_elems; ++i) {
-    ASSERT_TRUE(
-        tbl.insert(Gen<KEY>::get(keys[i]), Gen<VALUE>::get(local_value)));
+    const typename Gen<Value>::storage_type &value = value_cursor.next();
+    trace.record(INSERT, nums[i], Gen<Value>::size(value),
+                 TraceRecord::PREFILL);
+    ASSERT_TRUE(tbl.insert(Gen<Key>::get(keys[i]), Gen<Value>::get(value)));
   }
 }
 
+template <typename Key, typename Value, typename Table>
 void mix(Table &tbl, const size_t num_ops, const std::array<Ops, 100> &op_mix,
-         const std::vector<Gen<KEY>::storage_type> &keys,
-         const size_t prefill_elems, std::vector<size_t> &samples) {
+         const std::vector<uint64_t> &nums,
+         const std::vector<typename Gen<Key>::storage_type> &keys,
+         const std::vector<typename Gen<Value>::storage_type> &values,
+         const std::vector<size_t> &find_indices, const size_t prefill_elems,
+         std::vector<size_t> &samples, LatencyRecorder &latency,
+         Timeline &timeline, TraceRecorder &trace, const size_t thread_id) {
   Sampler sampler(num_ops);
-  Gen<VALUE>::storage_type local_value = Gen<VALUE>::storage_value();
+  ValueCursor<Value> value_cursor(values, thread_id);
   // Invariant: erase_seq <= insert_seq
   // Invariant: insert_seq < numkeys
   const size_t numkeys = keys.size();
@@ -141,41 +353,67 @@ void mix(Table &tbl, const size_t num_ops, const std::array<Ops, 100> &op_mix,
   // These variables are initialized out here so we don't create new variables
   // in the switch statement.
   size_t n;
-  VALUE v;
+  Value v;
+  const typename Gen<Value>::storage_type *value;
   // Convenience functions for getting the nth key and value
   auto key = [&keys](size_t n) {
     assert(n < keys.size());
-    return Gen<KEY>::get(keys[n]);
+    return Gen<Key>::get(keys[n]);
   };
   // The upsert function is just the identity
-  auto upsert_fn = [](VALUE &v) { return; };
+  auto upsert_fn = [](Value &) {};
+  // Maps a rank drawn from a non-uniform distribution to a key index. Rank r
+  // is the r-th most recently inserted key, so the hottest ranks stay on live
+  // keys as the oldest keys are erased. Ranks past the keys inserted so far
+  // are left as they are, and name keys that haven't been inserted yet.
+  auto live_index = [&insert_seq](size_t rank) {
+    return rank < insert_seq ? insert_seq - 1 - rank : rank;
+  };
   // Use an LCG over the keys array to iterate over the keys in a pseudorandom
-  // order, for find operations
+  // order, for find operations. If we were given a pre-generated sequence of
+  // ranks drawn from a non-uniform distribution, we instead use the LCG to
+  // iterate over that sequence, and look up the key at the rank we find
+  // there. Either way, `find_ind` is the index of the next key to look up.
   assert(1UL << static_cast<size_t>(floor(log2(numkeys))) == numkeys);
   assert(numkeys > 4);
+  assert(find_indices.empty() || find_indices.size() == numkeys);
   size_t find_seq = 0;
+  size_t find_ind = find_indices.empty() ? 0 : live_index(find_indices[0]);
   const size_t a = numkeys / 2 + 1;
   const size_t c = numkeys / 4 - 1;
   const size_t find_seq_mask = numkeys - 1;
-  auto find_seq_update = [&find_seq, &a, &c, &find_seq_mask, &numkeys]() {
+  auto find_seq_update = [&find_seq, &find_ind, &find_indices, &a, &c,
+                          &find_seq_mask, &live_index]() {
     find_seq = (a * find_seq + c) & find_seq_mask;
+    find_ind = find_indices.empty() ? find_seq
+                                    : live_index(find_indices[find_seq]);
   };
   // Run the operation mix for num_ops operations
   for (size_t i = 0; i < num_ops;) {
     for (size_t j = 0; j < 100 && i < num_ops; ++i, ++j) {
       sampler.iter();
+      // Only read the clock for the operations we are sampling, so that
+      // latency recording doesn't distort the throughput measurement.
+      const bool timed = latency.sample();
+      LatencyRecorder::clock::time_point op_start;
+      if (timed) {
+        op_start = LatencyRecorder::clock::now();
+      }
       switch (op_mix[j]) {
       case READ:
-        // If `find_seq` is between `erase_seq` and `insert_seq`, then it
+        // If `find_ind` is between `erase_seq` and `insert_seq`, then it
         // should be in the table.
-        ASSERT_EQ(find_seq >= erase_seq && find_seq < insert_seq,
-                  tbl.read(key(find_seq), v));
+        trace.record(READ, nums[find_ind], 0, 0);
+        ASSERT_EQ(find_ind >= erase_seq && find_ind < insert_seq,
+                  tbl.read(key(find_ind), v));
         find_seq_update();
         break;
       case INSERT:
         // Insert sequence number `insert_seq`. This should always
         // succeed and be inserting a new value.
-        ASSERT_TRUE(tbl.insert(key(insert_seq), Gen<VALUE>::get(local_value)));
+        value = &value_cursor.next();
+        trace.record(INSERT, nums[insert_seq], Gen<Value>::size(*value), 0);
+        ASSERT_TRUE(tbl.insert(key(insert_seq), Gen<Value>::get(*value)));
         ++insert_seq;
         break;
       case ERASE:
@@ -183,179 +421,141 @@ void mix(Table &tbl, const size_t num_ops, const std::array<Ops, 100> &op_mix,
         // we pick a random index to unsuccessfully erase. Otherwise we
         // erase `erase_seq`.
         if (erase_seq == insert_seq) {
-          ASSERT_TRUE(!tbl.erase(key(find_seq)));
+          trace.record(ERASE, nums[find_ind], 0, 0);
+          ASSERT_TRUE(!tbl.erase(key(find_ind)));
           find_seq_update();
         } else {
+          trace.record(ERASE, nums[erase_seq], 0, 0);
           ASSERT_TRUE(tbl.erase(key(erase_seq++)));
         }
         break;
       case UPDATE:
-        // Same as find, except we update to the same default value
-        ASSERT_EQ(find_seq >= erase_seq && find_seq < insert_seq,
-                  tbl.update(key(find_seq), Gen<VALUE>::get(local_value)));
+        // Same as find, except we update to the next value in the pool
+        value = &value_cursor.next();
+        trace.record(UPDATE, nums[find_ind], Gen<Value>::size(*value), 0);
+        ASSERT_EQ(find_ind >= erase_seq && find_ind < insert_seq,
+                  tbl.update(key(find_ind), Gen<Value>::get(*value)));
         find_seq_update();
         break;
       case UPSERT:
         // Pick a number from the full distribution, but cap it to the
         // insert_seq, so we don't insert a number greater than
         // insert_seq.
-        n = std::max(find_seq, insert_seq);
+        n = std::max(find_ind, insert_seq);
         find_seq_update();
-        tbl.upsert(key(n), upsert_fn, Gen<VALUE>::get(local_value));
+        value = &value_cursor.next();
+        trace.record(UPSERT, nums[n], Gen<Value>::size(*value), 0);
+        tbl.upsert(key(n), upsert_fn, Gen<Value>::get(*value));
         if (n == insert_seq) {
           ++insert_seq;
         }
         break;
+      default:
+        assert(false);
+      }
+      if (timed) {
+        latency.record(op_mix[j], LatencyRecorder::clock::now() - op_start);
       }
     }
+    timeline.publish(thread_id, i);
   }
   sampler.store(samples);
 }
 
-int main(int argc, char **argv) {
-  try {
-    // Parse parameters and check them.
-    parse_flags(argc, argv, description, args, arg_vars, arg_descriptions,
-                sizeof(args) / sizeof(const char *), nullptr, nullptr, nullptr,
-                0);
-    check_percentage(g_read_percentage, "reads");
-    check_percentage(g_insert_percentage, "inserts");
-    check_percentage(g_erase_percentage, "erases");
-    check_percentage(g_update_percentage, "updates");
-    check_percentage(g_upsert_percentage, "upserts");
-    check_percentage(g_prefill_percentage, "prefill");
-    if (g_read_percentage + g_insert_percentage + g_erase_percentage +
-            g_update_percentage + g_upsert_percentage !=
-        100) {
-      throw std::runtime_error("Operation mix percentages must sum to 100\n");
+// Prints the latency percentiles of each operation type in the mix to stderr,
+// and returns the same information formatted as an entry of the JSON output.
+std::string report_latencies(const LatencyRecorder &latency) {
+  const double percentiles[] = {50.0, 99.0, 99.9};
+  const char *percentile_names[] = {"p50", "p99", "p99.9"};
+  std::stringstream json;
+  json << ",\n        \"latency\": {"
+       << "\n            \"name\": \"Latency\","
+       << "\n            \"units\": \"nanoseconds\","
+       << "\n            \"sample_period\": " << g_latency_sample_period << ","
+       << "\n            \"value\": {";
+  std::cerr << "Latency (nanoseconds)\n";
+  const char *separator = "";
+  for (size_t op = 0; op < NUM_OPS; ++op) {
+    const Histogram &hist = latency.histogram(op);
+    if (hist.total_count() == 0) {
+      continue;
     }
-    if (g_seed == 0) {
-      g_seed = std::random_device()();
+    std::cerr << "  " << op_names[op] << ": count " << hist.total_count();
+    json << separator << "\n                \"" << op_names[op]
+         << "\": {\"count\": " << hist.total_count();
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+      const uint64_t value = hist.percentile(percentiles[i]);
+      std::cerr << ", " << percentile_names[i] << " " << value;
+      json << ", \"" << percentile_names[i] << "\": " << value;
     }
+    std::cerr << ", max " << hist.max() << "\n";
+    json << ", \"max\": " << hist.max() << "}";
+    separator = ",";
+  }
+  json << "\n            }\n        }";
+  return json.str();
+}
 
-    pcg64_oneseq_once_insecure base_rng(g_seed);
-
-    const size_t initial_capacity = 1UL << g_initial_capacity;
-    const size_t total_ops = initial_capacity * g_total_ops_percentage / 100;
-
-    // Pre-generate an operation mix based on our percentages.
-    std::array<Ops, 100> op_mix;
-    auto *op_mix_p = &op_mix[0];
-    for (size_t i = 0; i < g_read_percentage; ++i) {
-      *op_mix_p++ = READ;
-    }
-    for (size_t i = 0; i < g_insert_percentage; ++i) {
-      *op_mix_p++ = INSERT;
-    }
-    for (size_t i = 0; i < g_erase_percentage; ++i) {
-      *op_mix_p++ = ERASE;
-    }
-    for (size_t i = 0; i < g_update_percentage; ++i) {
-      *op_mix_p++ = UPDATE;
-    }
-    for (size_t i = 0; i < g_upsert_percentage; ++i) {
-      *op_mix_p++ = UPSERT;
-    }
-    std::shuffle(op_mix.begin(), op_mix.end(), base_rng);
-
-    // Pre-generate all the keys we'd want to insert. In case the insert +
-    // upsert percentage is too low, lower bound by the table capacity.
-    std::cerr << "Generating keys\n";
-    const size_t prefill_elems = initial_capacity * g_prefill_percentage / 100;
-    // We won't be running through `op_mix` more than ceil(total_ops / 100),
-    // so calculate that ceiling and multiply by the number of inserts and
-    // upserts to get an upper bound on how many elements we'll be
-    // inserting.
-    const size_t max_insert_ops =
-        (total_ops + 99) / 100 * (g_insert_percentage + g_erase_percentage);
-    const size_t insert_keys =
-        std::max(initial_capacity, max_insert_ops) + prefill_elems;
-    // Round this quantity up to a power of 2, so that we can use an LCG to
-    // cycle over the array "randomly".
-    const size_t insert_keys_per_thread =
-        1UL << static_cast<size_t>(
-            ceil(log2((insert_keys + g_threads - 1) / g_threads)));
-    // Can't do this in parallel, because the random number generator is
-    // single-threaded.
-    std::vector<std::vector<uint64_t>> nums(g_threads);
-    for (size_t i = 0; i < g_threads; ++i) {
-      nums[i].resize(insert_keys_per_thread);
-      gen_nums(nums[i], base_rng);
-    }
-    std::vector<std::thread> gen_key_threads(g_threads);
-    std::vector<std::vector<Gen<KEY>::storage_type>> keys(g_threads);
-    for (size_t i = 0; i < g_threads; ++i) {
-      keys[i].resize(insert_keys_per_thread);
-      gen_key_threads[i] =
-          std::thread(gen_keys, std::ref(nums[i]), std::ref(keys[i]));
-    }
-    for (auto &t : gen_key_threads) {
-      t.join();
-    }
+// The headline results of a run, used to compare tables and thread counts
+// against each other
+struct RunResult {
+  std::string table;
+  size_t threads;
+  double throughput;
+  size_t table_bytes;
+};
 
-    // Create and size the table
-    Table tbl(initial_capacity);
+// When more than one run is printed, the JSON results are printed as an array
+bool g_json_array = false;
+size_t g_json_results = 0;
 
-    std::cerr << "Pre-filling table\n";
-    std::vector<std::thread> prefill_threads(g_threads);
-    const size_t prefill_elems_per_thread = prefill_elems / g_threads;
-    for (size_t i = 0; i < g_threads; ++i) {
-      prefill_threads[i] = std::thread(
-          prefill, std::ref(tbl), std::ref(keys[i]), prefill_elems_per_thread);
-    }
-    for (auto &t : prefill_threads) {
-      t.join();
-    }
+void begin_json_result() {
+  if (g_json_array) {
+    printf(g_json_results++ == 0 ? "[\n" : ",\n");
+  }
+}
 
-    // Run the operation mix, timed
-    std::cerr << "Running operations\n";
-    std::vector<std::thread> mix_threads(g_threads);
-    std::vector<std::vector<size_t>> samples(g_threads);
-    const size_t num_ops_per_thread = total_ops / g_threads;
-    auto start_time = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < g_threads; ++i) {
-      mix_threads[i] = std::thread(
-          mix, std::ref(tbl), num_ops_per_thread, std::ref(op_mix),
-          std::ref(keys[i]), prefill_elems_per_thread, std::ref(samples[i]));
-    }
-    for (auto &t : mix_threads) {
-      t.join();
+// Prints the arguments, the table configuration, and the results of a run in
+// JSON format, and returns the headline results
+template <typename Key, typename Value, typename table_type>
+RunResult report_run(const size_t slot_per_bucket, const size_t total_ops,
+                     const double seconds_elapsed, const std::string &samplestr,
+                     const size_t table_bytes,
+                     std::vector<LatencyRecorder> &latencies,
+                     const Timeline &timeline, const size_t initial_hashpower,
+                     const std::string &memorystr) {
+  std::stringstream argstr;
+  argstr << args[0] << " " << *arg_vars[0];
+  for (size_t i = 1; i < sizeof(args) / sizeof(args[0]); ++i) {
+    argstr << " " << args[i] << " " << *arg_vars[i];
+  }
+  for (size_t i = 0; i < sizeof(str_args) / sizeof(str_args[0]); ++i) {
+    if (!str_arg_vars[i]->empty()) {
+      argstr << " " << str_args[i] << " " << *str_arg_vars[i];
     }
-    auto end_time = std::chrono::high_resolution_clock::now();
-    double seconds_elapsed =
-        std::chrono::duration_cast<std::chrono::duration<double>>(end_time -
-                                                                  start_time)
-            .count();
-    // Print out args, preprocessor constants, and results in JSON format
-    std::stringstream argstr;
-    argstr << args[0] << " " << *arg_vars[0];
-    for (size_t i = 1; i < sizeof(args) / sizeof(args[0]); ++i) {
-      argstr << " " << args[i] << " " << *arg_vars[i];
+  }
+  // Merge the per-thread latency histograms into the first one
+  std::string latencystr;
+  if (g_latency_sample_period != 0) {
+    for (size_t i = 1; i < g_threads; ++i) {
+      latencies[0].merge(latencies[i]);
     }
-    // Average together the allocator samples from each thread. If
-    // TRACKING_ALLOCATOR is turned off, the samples should all be empty,
-    // and this list should end up empty.
-    std::stringstream samplestr;
-    samplestr << "[";
-    const size_t total_samples = samples[0].size();
-    for (size_t i = 0; i < total_samples; ++i) {
-      size_t total = 0;
-      for (size_t j = 0; j < g_threads; ++j) {
-        total += samples.at(j).at(i);
-      }
-      size_t avg = total / g_threads;
-      samplestr << avg;
-      if (i < total_samples - 1) {
-        samplestr << ",";
-      }
+    latencystr = report_latencies(latencies[0]);
+  }
+  std::string timelinestr;
+  if (timeline.enabled()) {
+    timelinestr = timeline.json(initial_hashpower);
+    if (!g_timeline_csv.empty()) {
+      timeline.write_csv(g_timeline_csv);
     }
-    samplestr << "]";
-    const char *json_format = R"({
+  }
+  const char *json_format = R"({
     "args": "%s",
     "key": "%s",
     "key_size": "%zu",
     "value": "%s",
     "value_size": "%zu",
+    "slot_per_bucket": "%zu",
     "table": "%s",
     "output": {
         "total_ops": {
@@ -377,14 +577,602 @@ int main(int argc, char **argv) {
             "name": "Memory Samples",
             "units": "[bytes]",
             "value": %s
-        }
+        },
+        "table_memory": {
+            "name": "Table Memory",
+            "units": "bytes",
+            "value": %zu
+        }%s%s%s
     }
 }
 )";
-    printf(json_format, argstr.str().c_str(), XSTR(KEY), Gen<KEY>::key_size,
-           XSTR(VALUE), Gen<VALUE>::value_size, TABLE, total_ops,
-           seconds_elapsed, total_ops / seconds_elapsed,
-           samplestr.str().c_str());
+  printf(json_format, argstr.str().c_str(), Gen<Key>::name().c_str(),
+         Gen<Key>::key_size, Gen<Value>::name().c_str(),
+         Gen<Value>::value_size, slot_per_bucket, table_type::name(),
+         total_ops, seconds_elapsed, total_ops / seconds_elapsed,
+         samplestr.c_str(), table_bytes, latencystr.c_str(),
+         timelinestr.c_str(), memorystr.c_str());
+  return RunResult{table_type::name(), g_threads, total_ops / seconds_elapsed,
+                   table_bytes};
+}
+
+// An operation from a trace, with its key already converted to the table's key
+// type
+template <typename Key> struct ReplayOp {
+  Ops op;
+  typename Gen<Key>::storage_type key;
+  // The index of the value the operation writes, in the values built by
+  // partition_trace
+  size_t value;
+};
+
+// Returns the thread a trace record is replayed by. Keys are mixed first, so
+// that they're spread evenly across threads even if they're sequential.
+size_t replay_thread_of(const TraceRecord &record) {
+  if (g_trace_partition == "key") {
+    uint64_t key = record.key;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key % g_threads;
+  } else {
+    return record.thread % g_threads;
+  }
+}
+
+// Splits the records of the trace between threads, converting each key to the
+// table's key type, so that neither happens while timing the replay. Each
+// value the trace writes is built with the size it was recorded with, for
+// value types whose size varies. Operations writing values of the same size
+// share one, which is added to `values`.
+template <typename Key, typename Value>
+void partition_trace(const TraceFile &trace,
+                     std::vector<std::vector<ReplayOp<Key>>> &prefill_ops,
+                     std::vector<std::vector<ReplayOp<Key>>> &ops,
+                     std::vector<typename Gen<Value>::storage_type> &values) {
+  std::map<uint32_t, size_t> value_of_size;
+  for (const TraceRecord &record : trace) {
+    if (record.op >= NUM_OPS) {
+      throw std::runtime_error("Invalid operation in trace\n");
+    }
+    const size_t thread = replay_thread_of(record);
+    std::vector<ReplayOp<Key>> &dest =
+        (record.flags & TraceRecord::PREFILL) ? prefill_ops[thread]
+                                              : ops[thread];
+    auto value = value_of_size.find(record.value_size);
+    if (value == value_of_size.end()) {
+      value = value_of_size.emplace(record.value_size, values.size()).first;
+      values.push_back(Gen<Value>::storage_value_of_size(
+          values.size(), record.value_size));
+    }
+    dest.push_back(ReplayOp<Key>{static_cast<Ops>(record.op),
+                                 Gen<Key>::storage_key(record.key),
+                                 value->second});
+  }
+}
+
+// Runs a sequence of operations from a trace. Unlike `mix`, we can't know what
+// the result of each operation should be, so the results aren't checked.
+template <typename Key, typename Value, typename Table>
+void replay_ops(Table &tbl, const std::vector<ReplayOp<Key>> &ops,
+                const std::vector<typename Gen<Value>::storage_type> &values,
+                LatencyRecorder &latency, Timeline &timeline,
+                const size_t thread_id) {
+  Value v;
+  auto upsert_fn = [](Value &) {};
+  const size_t num_ops = ops.size();
+  for (size_t i = 0; i < num_ops;) {
+    for (size_t j = 0; j < 100 && i < num_ops; ++i, ++j) {
+      const ReplayOp<Key> &op = ops[i];
+      const bool timed = latency.sample();
+      LatencyRecorder::clock::time_point op_start;
+      if (timed) {
+        op_start = LatencyRecorder::clock::now();
+      }
+      switch (op.op) {
+      case READ:
+        tbl.read(Gen<Key>::get(op.key), v);
+        break;
+      case INSERT:
+        tbl.insert(Gen<Key>::get(op.key), Gen<Value>::get(values[op.value]));
+        break;
+      case ERASE:
+        tbl.erase(Gen<Key>::get(op.key));
+        break;
+      case UPDATE:
+        tbl.update(Gen<Key>::get(op.key), Gen<Value>::get(values[op.value]));
+        break;
+      case UPSERT:
+        tbl.upsert(Gen<Key>::get(op.key), upsert_fn,
+                   Gen<Value>::get(values[op.value]));
+        break;
+      default:
+        assert(false);
+      }
+      if (timed) {
+        latency.record(op.op, LatencyRecorder::clock::now() - op_start);
+      }
+    }
+    timeline.publish(thread_id, i);
+  }
+}
+
+// Replays the trace in `g_trace` against one table, instead of running the
+// synthetic operation mix. The prefill operations in the trace are run first,
+// untimed, and then the rest of the trace is timed.
+template <typename Key, typename Value, typename table_type>
+RunResult replay(const size_t slot_per_bucket) {
+  std::cerr << "Partitioning trace\n";
+  std::vector<std::vector<ReplayOp<Key>>> prefill_ops(g_threads);
+  std::vector<std::vector<ReplayOp<Key>>> ops(g_threads);
+  std::vector<typename Gen<Value>::storage_type> values;
+  partition_trace<Key, Value>(*g_trace, prefill_ops, ops, values);
+  size_t total_ops = 0;
+  for (const std::vector<ReplayOp<Key>> &thread_ops : ops) {
+    total_ops += thread_ops.size();
+  }
+
+  std::vector<std::thread> threads(g_threads);
+  std::vector<LatencyRecorder> latencies(
+      g_threads, LatencyRecorder(NUM_OPS, g_latency_sample_period));
+  Timeline timeline(g_threads, g_timeline_interval);
+  // The prefill isn't timed. A disabled recorder is never modified, so the
+  // prefill threads can share one.
+  LatencyRecorder no_latency(NUM_OPS, 0);
+  Timeline no_timeline(g_threads, 0);
+  MemorySampler memory(g_memory_interval);
+
+  memory.start(tracked_bytes_allocated);
+  const size_t heap_bytes_before = heap_bytes_in_use();
+  table_type tbl(1UL << g_initial_capacity);
+
+  std::cerr << "Pre-filling table\n";
+  for (size_t i = 0; i < g_threads; ++i) {
+    threads[i] = std::thread(replay_ops<Key, Value, table_type>, std::ref(tbl),
+                             std::ref(prefill_ops[i]), std::cref(values),
+                             std::ref(no_latency), std::ref(no_timeline), i);
+    g_pinner.pin(threads[i], i);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  std::cerr << "Replaying trace\n";
+  const size_t initial_hashpower = tbl.hashpower();
+  auto start_time = std::chrono::high_resolution_clock::now();
+  memory.mark_run_start();
+  timeline.start([&tbl]() { return tbl.hashpower(); });
+  for (size_t i = 0; i < g_threads; ++i) {
+    threads[i] = std::thread(replay_ops<Key, Value, table_type>, std::ref(tbl),
+                             std::ref(ops[i]), std::cref(values),
+                             std::ref(latencies[i]), std::ref(timeline), i);
+    g_pinner.pin(threads[i], i);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  timeline.stop();
+  memory.stop();
+  const size_t heap_bytes_after = heap_bytes_in_use();
+  const size_t table_bytes = heap_bytes_after > heap_bytes_before
+                                 ? heap_bytes_after - heap_bytes_before
+                                 : 0;
+  double seconds_elapsed =
+      std::chrono::duration_cast<std::chrono::duration<double>>(end_time -
+                                                                start_time)
+          .count();
+  return report_run<Key, Value, table_type>(
+      slot_per_bucket, total_ops, seconds_elapsed, "[]", table_bytes,
+      latencies, timeline, initial_hashpower, memory.report(tbl.size()));
+}
+
+// Runs the benchmark against one table, prints the results as JSON, and
+// returns them. If we were given a trace, it is replayed instead of running
+// the operation mix. `slot_per_bucket` is only reported, and is 0 for tables
+// other than libcuckoo.
+template <typename Key, typename Value, typename table_type>
+RunResult run(const KeyDistribution &distribution,
+              const size_t slot_per_bucket) {
+  if (g_trace != nullptr) {
+    return replay<Key, Value, table_type>(slot_per_bucket);
+  }
+  pcg64_oneseq_once_insecure base_rng(g_seed);
+
+  const size_t initial_capacity = 1UL << g_initial_capacity;
+  const size_t total_ops = initial_capacity * g_total_ops_percentage / 100;
+
+  // Pre-generate an operation mix based on our percentages.
+  std::array<Ops, 100> op_mix;
+  auto *op_mix_p = &op_mix[0];
+  for (size_t i = 0; i < g_read_percentage; ++i) {
+    *op_mix_p++ = READ;
+  }
+  for (size_t i = 0; i < g_insert_percentage; ++i) {
+    *op_mix_p++ = INSERT;
+  }
+  for (size_t i = 0; i < g_erase_percentage; ++i) {
+    *op_mix_p++ = ERASE;
+  }
+  for (size_t i = 0; i < g_update_percentage; ++i) {
+    *op_mix_p++ = UPDATE;
+  }
+  for (size_t i = 0; i < g_upsert_percentage; ++i) {
+    *op_mix_p++ = UPSERT;
+  }
+  std::shuffle(op_mix.begin(), op_mix.end(), base_rng);
+
+  // Pre-generate all the keys we'd want to insert. In case the insert +
+  // upsert percentage is too low, lower bound by the table capacity.
+  std::cerr << "Generating keys\n";
+  const size_t prefill_elems = initial_capacity * g_prefill_percentage / 100;
+  // We won't be running through `op_mix` more than ceil(total_ops / 100),
+  // so calculate that ceiling and multiply by the number of inserts and
+  // upserts to get an upper bound on how many elements we'll be
+  // inserting.
+  const size_t max_insert_ops =
+      (total_ops + 99) / 100 * (g_insert_percentage + g_erase_percentage);
+  const size_t insert_keys =
+      std::max(initial_capacity, max_insert_ops) + prefill_elems;
+  // Round this quantity up to a power of 2, so that we can use an LCG to
+  // cycle over the array "randomly".
+  const size_t insert_keys_per_thread =
+      1UL << static_cast<size_t>(
+          ceil(log2((insert_keys + g_threads - 1) / g_threads)));
+  // Can't do this in parallel, because the random number generator is
+  // single-threaded.
+  std::vector<std::vector<uint64_t>> nums(g_threads);
+  for (size_t i = 0; i < g_threads; ++i) {
+    nums[i].resize(insert_keys_per_thread);
+    gen_nums(nums[i], base_rng);
+  }
+  std::vector<std::thread> gen_key_threads(g_threads);
+  std::vector<std::vector<typename Gen<Key>::storage_type>> keys(g_threads);
+  for (size_t i = 0; i < g_threads; ++i) {
+    keys[i].resize(insert_keys_per_thread);
+    gen_key_threads[i] =
+        std::thread(gen_keys<Key>, std::ref(nums[i]), std::ref(keys[i]));
+  }
+  // If the key distribution isn't uniform, also pre-generate the sequence of
+  // key indices each thread will look up, so that sampling the distribution
+  // doesn't happen while timing the workload.
+  std::vector<std::vector<size_t>> find_indices(g_threads);
+  if (distribution.type() != KeyDistribution::UNIFORM) {
+    for (size_t i = 0; i < g_threads; ++i) {
+      find_indices[i].resize(insert_keys_per_thread);
+      gen_key_threads.emplace_back(gen_find_indices, std::cref(distribution),
+                                   base_rng(), std::ref(find_indices[i]));
+    }
+  }
+  for (auto &t : gen_key_threads) {
+    t.join();
+  }
+  const std::vector<typename Gen<Value>::storage_type> values =
+      gen_values<Value>(base_rng);
+
+  std::vector<std::thread> mix_threads(g_threads);
+  std::vector<std::vector<size_t>> samples(g_threads);
+  std::vector<LatencyRecorder> latencies(
+      g_threads, LatencyRecorder(NUM_OPS, g_latency_sample_period));
+  Timeline timeline(g_threads, g_timeline_interval);
+  const size_t prefill_elems_per_thread = prefill_elems / g_threads;
+  const size_t num_ops_per_thread = total_ops / g_threads;
+  std::vector<TraceRecorder> traces;
+  for (size_t i = 0; i < g_threads; ++i) {
+    traces.emplace_back(!g_trace_record.empty(), i);
+    traces[i].reserve(prefill_elems_per_thread + num_ops_per_thread);
+  }
+  MemorySampler memory(g_memory_interval);
+
+  // Create and size the table. Everything else we allocate on the heap is
+  // allocated before this point, so that the growth in the heap from here
+  // until the end of the run is the memory used by the table.
+  memory.start(tracked_bytes_allocated);
+  const size_t heap_bytes_before = heap_bytes_in_use();
+  table_type tbl(initial_capacity);
+
+  std::cerr << "Pre-filling table\n";
+  std::vector<std::thread> prefill_threads(g_threads);
+  for (size_t i = 0; i < g_threads; ++i) {
+    prefill_threads[i] = std::thread(
+        prefill<Key, Value, table_type>, std::ref(tbl), std::ref(nums[i]),
+        std::ref(keys[i]), std::cref(values), prefill_elems_per_thread,
+        std::ref(traces[i]), i);
+    g_pinner.pin(prefill_threads[i], i);
+  }
+  for (auto &t : prefill_threads) {
+    t.join();
+  }
+
+  // Run the operation mix, timed
+  std::cerr << "Running operations\n";
+  const size_t initial_hashpower = tbl.hashpower();
+  auto start_time = std::chrono::high_resolution_clock::now();
+  memory.mark_run_start();
+  timeline.start([&tbl]() { return tbl.hashpower(); });
+  for (size_t i = 0; i < g_threads; ++i) {
+    mix_threads[i] = std::thread(
+        mix<Key, Value, table_type>, std::ref(tbl), num_ops_per_thread,
+        std::ref(op_mix), std::ref(nums[i]), std::ref(keys[i]),
+        std::cref(values), std::ref(find_indices[i]), prefill_elems_per_thread,
+        std::ref(samples[i]), std::ref(latencies[i]), std::ref(timeline),
+        std::ref(traces[i]), i);
+    g_pinner.pin(mix_threads[i], i);
+  }
+  for (auto &t : mix_threads) {
+    t.join();
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  timeline.stop();
+  memory.stop();
+  const size_t heap_bytes_after = heap_bytes_in_use();
+  const size_t table_bytes = heap_bytes_after > heap_bytes_before
+                                 ? heap_bytes_after - heap_bytes_before
+                                 : 0;
+  double seconds_elapsed =
+      std::chrono::duration_cast<std::chrono::duration<double>>(end_time -
+                                                                start_time)
+          .count();
+  // Average together the allocator samples from each thread. If
+  // TRACKING_ALLOCATOR is turned off, the samples should all be empty,
+  // and this list should end up empty.
+  std::stringstream samplestr;
+  samplestr << "[";
+  const size_t total_samples = samples[0].size();
+  for (size_t i = 0; i < total_samples; ++i) {
+    size_t total = 0;
+    for (size_t j = 0; j < g_threads; ++j) {
+      total += samples.at(j).at(i);
+    }
+    size_t avg = total / g_threads;
+    samplestr << avg;
+    if (i < total_samples - 1) {
+      samplestr << ",";
+    }
+  }
+  samplestr << "]";
+  if (!g_trace_record.empty()) {
+    std::cerr << "Writing trace\n";
+    write_trace(g_trace_record, traces);
+  }
+  return report_run<Key, Value, table_type>(
+      slot_per_bucket, total_ops, seconds_elapsed, samplestr.str(),
+      table_bytes, latencies, timeline, initial_hashpower,
+      memory.report(tbl.size()));
+}
+
+template <typename Key, typename Value>
+RunResult run_libcuckoo(const KeyDistribution &distribution) {
+  switch (g_slots) {
+  case 2:
+    return run<Key, Value, LibcuckooTable<Key, Value, 2>>(distribution, 2);
+  case 4:
+    return run<Key, Value, LibcuckooTable<Key, Value, 4>>(distribution, 4);
+  case 8:
+    return run<Key, Value, LibcuckooTable<Key, Value, 8>>(distribution, 8);
+  default:
+    throw std::runtime_error("Unsupported number of slots per bucket " +
+                             std::to_string(g_slots) + "\n");
+  }
+}
+
+// Runs the benchmark against the table named by `--table`, or against every
+// table if it is ALL, and returns the results of each run
+template <typename Key, typename Value>
+std::vector<RunResult> dispatch_table(const KeyDistribution &distribution) {
+  const bool all = g_table == "ALL";
+  std::vector<RunResult> results;
+  if (all || g_table == LibcuckooTable<Key, Value, 4>::name()) {
+    begin_json_result();
+    results.push_back(run_libcuckoo<Key, Value>(distribution));
+  }
+  if (all || g_table == LockedTable<Key, Value>::name()) {
+    if (g_threads == 1) {
+      begin_json_result();
+      results.push_back(
+          run<Key, Value, LockedTable<Key, Value>>(
+              distribution, libcuckoo::DEFAULT_SLOT_PER_BUCKET));
+    } else if (all) {
+      std::cerr << "Skipping " << LockedTable<Key, Value>::name()
+                << ", which only supports one thread\n";
+    } else {
+      throw std::runtime_error(std::string(LockedTable<Key, Value>::name()) +
+                               " only supports one thread\n");
+    }
+  }
+  if (all || g_table == UnorderedMapTable<Key, Value>::name()) {
+    begin_json_result();
+    results.push_back(
+        run<Key, Value, UnorderedMapTable<Key, Value>>(distribution, 0));
+  }
+  if (all || g_table == StripedUnorderedMapTable<Key, Value>::name()) {
+    begin_json_result();
+    results.push_back(
+        run<Key, Value, StripedUnorderedMapTable<Key, Value>>(distribution, 0));
+  }
+  if (all || g_table == ShardedUnorderedMapTable<Key, Value>::name()) {
+    begin_json_result();
+    results.push_back(
+        run<Key, Value, ShardedUnorderedMapTable<Key, Value>>(distribution, 0));
+  }
+  if (results.empty()) {
+    throw std::runtime_error("Unsupported table `" + g_table + "`\n");
+  }
+  return results;
+}
+
+// Instantiates the benchmark for every value type in universal_gen.hh, and
+// runs the one named by `--value`
+template <typename Key>
+std::vector<RunResult> dispatch_value(const KeyDistribution &distribution) {
+  if (g_value == Gen<uint64_t>::name()) {
+    return dispatch_table<Key, uint64_t>(distribution);
+  } else if (g_value == Gen<std::string>::name()) {
+    return dispatch_table<Key, std::string>(distribution);
+  } else if (g_value == Gen<MediumBlob>::name()) {
+    return dispatch_table<Key, MediumBlob>(distribution);
+  } else if (g_value == Gen<BigBlob>::name()) {
+    return dispatch_table<Key, BigBlob>(distribution);
+  } else {
+    throw std::runtime_error("Unsupported value type `" + g_value + "`\n");
+  }
+}
+
+// Instantiates the benchmark for every key type in universal_gen.hh, and runs
+// the one named by `--key`
+std::vector<RunResult> dispatch_key(const KeyDistribution &distribution) {
+  if (g_key == Gen<uint64_t>::name()) {
+    return dispatch_value<uint64_t>(distribution);
+  } else if (g_key == Gen<std::string>::name()) {
+    return dispatch_value<std::string>(distribution);
+  } else if (g_key == Gen<MediumBlob>::name()) {
+    return dispatch_value<MediumBlob>(distribution);
+  } else if (g_key == Gen<BigBlob>::name()) {
+    return dispatch_value<BigBlob>(distribution);
+  } else {
+    throw std::runtime_error("Unsupported key type `" + g_key + "`\n");
+  }
+}
+
+// Prints a comparison of the throughput and memory usage of each table to
+// stderr, relative to the first one
+void report_comparison(const std::vector<RunResult> &results) {
+  fprintf(stderr, "\n%-24s %16s %10s %16s %10s\n", "Table", "Throughput",
+          "Relative", "Memory (bytes)", "Relative");
+  for (const RunResult &result : results) {
+    fprintf(stderr, "%-24s %16.0f %10.2f %16zu %10.2f\n",
+            result.table.c_str(), result.throughput,
+            result.throughput / results[0].throughput, result.table_bytes,
+            results[0].table_bytes == 0
+                ? 0.0
+                : static_cast<double>(result.table_bytes) /
+                      results[0].table_bytes);
+  }
+}
+
+// Prints how the throughput of each table scales with the number of threads to
+// stderr. Speedup is relative to the smallest thread count each table was run
+// with, and efficiency is the speedup divided by the increase in threads.
+void report_scaling(const std::vector<RunResult> &results) {
+  std::vector<std::string> tables;
+  for (const RunResult &result : results) {
+    if (std::find(tables.begin(), tables.end(), result.table) ==
+        tables.end()) {
+      tables.push_back(result.table);
+    }
+  }
+  fprintf(stderr, "\n%-24s %8s %16s %10s %10s\n", "Table", "Threads",
+          "Throughput", "Speedup", "Efficiency");
+  for (const std::string &table : tables) {
+    const RunResult *base = nullptr;
+    for (const RunResult &result : results) {
+      if (result.table == table &&
+          (base == nullptr || result.threads < base->threads)) {
+        base = &result;
+      }
+    }
+    for (const RunResult &result : results) {
+      if (result.table != table) {
+        continue;
+      }
+      const double speedup = result.throughput / base->throughput;
+      const double efficiency =
+          speedup * base->threads / static_cast<double>(result.threads);
+      fprintf(stderr, "%-24s %8zu %16.0f %10.2f %10.2f\n", table.c_str(),
+              result.threads, result.throughput, speedup, efficiency);
+    }
+  }
+}
+
+// Parses a comma-separated list of thread counts
+std::vector<size_t> parse_thread_counts(const std::string &str) {
+  std::vector<size_t> counts;
+  std::stringstream ss(str);
+  std::string count;
+  while (std::getline(ss, count, ',')) {
+    char *end;
+    const unsigned long long n = std::strtoull(count.c_str(), &end, 10);
+    if (count.empty() || *end != '\0' || n == 0) {
+      throw std::runtime_error("Invalid thread count `" + count + "`\n");
+    }
+    counts.push_back(n);
+  }
+  return counts;
+}
+
+int main(int argc, char **argv) {
+  try {
+    // Parse parameters and check them.
+    parse_flags(argc, argv, description, args, arg_vars, arg_descriptions,
+                sizeof(args) / sizeof(const char *), nullptr, nullptr, nullptr,
+                0, str_args, str_arg_vars, str_arg_descriptions,
+                sizeof(str_args) / sizeof(const char *));
+    check_percentage(g_read_percentage, "reads");
+    check_percentage(g_insert_percentage, "inserts");
+    check_percentage(g_erase_percentage, "erases");
+    check_percentage(g_update_percentage, "updates");
+    check_percentage(g_upsert_percentage, "upserts");
+    check_percentage(g_prefill_percentage, "prefill");
+    if (g_trace_replay.empty() &&
+        g_read_percentage + g_insert_percentage + g_erase_percentage +
+                g_update_percentage + g_upsert_percentage !=
+            100) {
+      throw std::runtime_error("Operation mix percentages must sum to 100\n");
+    }
+    if (!g_trace_replay.empty() && !g_trace_record.empty()) {
+      throw std::runtime_error("Cannot record and replay a trace at once\n");
+    }
+    if (g_trace_partition != "ordered" && g_trace_partition != "key") {
+      throw std::runtime_error("Invalid trace partitioning `" +
+                               g_trace_partition + "`\n");
+    }
+    const KeyDistribution distribution = KeyDistribution::parse(g_distribution);
+    if (!g_key_length.empty() || !g_key_prefix.empty()) {
+      if (g_key != Gen<std::string>::name()) {
+        throw std::runtime_error(
+            "--key-length and --key-prefix only apply to std::string keys\n");
+      }
+      Gen<std::string>::key_shape() =
+          StringKeyShape::parse(g_key_length, g_key_prefix);
+    }
+    if (!g_value_length.empty()) {
+      if (g_value != Gen<std::string>::name()) {
+        throw std::runtime_error(
+            "--value-length only applies to std::string values\n");
+      }
+      Gen<std::string>::value_length() =
+          LengthDistribution::parse(g_value_length);
+    }
+    if (g_seed == 0) {
+      g_seed = std::random_device()();
+    }
+    g_pinner = ThreadPinner(g_pin);
+    std::unique_ptr<TraceFile> trace;
+    if (!g_trace_replay.empty()) {
+      trace.reset(new TraceFile(g_trace_replay));
+      g_trace = trace.get();
+    }
+    std::vector<size_t> thread_counts(1, g_threads);
+    if (!g_thread_counts.empty()) {
+      thread_counts = parse_thread_counts(g_thread_counts);
+    }
+    g_json_array = g_table == "ALL" || thread_counts.size() > 1;
+
+    std::vector<RunResult> results;
+    for (size_t threads : thread_counts) {
+      g_threads = threads;
+      const std::vector<RunResult> thread_results = dispatch_key(distribution);
+      results.insert(results.end(), thread_results.begin(),
+                     thread_results.end());
+    }
+    if (g_json_array) {
+      printf("]\n");
+    }
+    if (thread_counts.size() > 1) {
+      report_scaling(results);
+    } else if (results.size() > 1) {
+      report_comparison(results);
+    }
   } catch (const std::exception &e) {
     std::cerr << e.what();
     std::exit(1);
@@ -0,0 +1,149 @@
+#ifndef _UNIVERSAL_DISTRIBUTION_HH
+#define _UNIVERSAL_DISTRIBUTION_HH
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Describes how the benchmark picks which of its pre-generated keys to operate
+ * on, for all operations that don't insert a brand new key. A distribution is
+ * specified on the command line as one of
+ *
+ * uniform                 every key is equally likely
+ * zipf:<theta>            rank i is chosen with probability proportional to
+ *                         1 / (i + 1)^theta, for 0 < theta < 1
+ * hotset:<frac>:<prob>    the first <frac> of the ranks are chosen with total
+ *                         probability <prob>, and the rest with 1 - <prob>
+ *
+ * The distribution gives each key a rank, with the hottest key at rank 0. The
+ * benchmark maps rank i to the i-th most recently inserted key, so the hottest
+ * keys stay in the table while the oldest keys are erased. Since the keys
+ * themselves are random, the rank is unrelated to the key's hash value. */
+
+class KeyDistribution {
+public:
+  enum Type {
+    UNIFORM,
+    ZIPF,
+    HOTSET,
+  };
+
+  KeyDistribution()
+      : type_(UNIFORM), theta_(0), hot_fraction_(0), hot_probability_(0) {}
+
+  // Parses a distribution specification, throwing std::runtime_error if it is
+  // malformed
+  static KeyDistribution parse(const std::string &spec) {
+    std::vector<std::string> parts;
+    std::stringstream ss(spec);
+    std::string part;
+    while (std::getline(ss, part, ':')) {
+      parts.push_back(part);
+    }
+    KeyDistribution dist;
+    if (parts.size() == 1 && parts[0] == "uniform") {
+      dist.type_ = UNIFORM;
+    } else if (parts.size() == 2 && parts[0] == "zipf") {
+      dist.type_ = ZIPF;
+      dist.theta_ = parse_double(parts[1], spec);
+      if (!(dist.theta_ > 0.0 && dist.theta_ < 1.0)) {
+        throw std::runtime_error("Zipf theta must be between 0 and 1, "
+                                 "exclusive\n");
+      }
+    } else if (parts.size() == 3 && parts[0] == "hotset") {
+      dist.type_ = HOTSET;
+      dist.hot_fraction_ = parse_double(parts[1], spec);
+      dist.hot_probability_ = parse_double(parts[2], spec);
+      if (!(dist.hot_fraction_ > 0.0 && dist.hot_fraction_ <= 1.0) ||
+          !(dist.hot_probability_ >= 0.0 && dist.hot_probability_ <= 1.0)) {
+        throw std::runtime_error("Hot set fraction must be in (0, 1], and "
+                                 "probability in [0, 1]\n");
+      }
+    } else {
+      throw std::runtime_error("Invalid key distribution `" + spec + "`\n");
+    }
+    return dist;
+  }
+
+  Type type() const { return type_; }
+
+  // Fills `indices` with ranks among `n` keys, drawn from the distribution
+  // using the given random number generator. Generating a zipfian sample
+  // takes O(n) time up front, and O(1) time per index.
+  template <typename RNG>
+  void generate(size_t n, std::vector<size_t> &indices, RNG &rng) const {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    switch (type_) {
+    case UNIFORM: {
+      std::uniform_int_distribution<size_t> any(0, n - 1);
+      for (size_t &ind : indices) {
+        ind = any(rng);
+      }
+      break;
+    }
+    case ZIPF: {
+      // Jim Gray et al., "Quickly Generating Billion-Record Synthetic
+      // Databases", SIGMOD 1994.
+      double zetan = 0;
+      for (size_t i = 1; i <= n; ++i) {
+        zetan += 1.0 / std::pow(static_cast<double>(i), theta_);
+      }
+      const double zeta2 = 1.0 + std::pow(0.5, theta_);
+      const double alpha = 1.0 / (1.0 - theta_);
+      const double eta = (1.0 - std::pow(2.0 / n, 1.0 - theta_)) /
+                         (1.0 - zeta2 / zetan);
+      for (size_t &ind : indices) {
+        const double u = unit(rng);
+        const double uz = u * zetan;
+        if (uz < 1.0) {
+          ind = 0;
+        } else if (uz < zeta2) {
+          ind = 1;
+        } else {
+          ind = static_cast<size_t>(n * std::pow(eta * u - eta + 1.0, alpha));
+        }
+        if (ind >= n) {
+          ind = n - 1;
+        }
+      }
+      break;
+    }
+    case HOTSET: {
+      size_t num_hot = static_cast<size_t>(hot_fraction_ * n);
+      if (num_hot == 0) {
+        num_hot = 1;
+      }
+      std::uniform_int_distribution<size_t> hot(0, num_hot - 1);
+      std::uniform_int_distribution<size_t> cold(num_hot < n ? num_hot : 0,
+                                                 n - 1);
+      for (size_t &ind : indices) {
+        ind = (unit(rng) < hot_probability_) ? hot(rng) : cold(rng);
+      }
+      break;
+    }
+    }
+  }
+
+private:
+  static double parse_double(const std::string &str, const std::string &spec) {
+    char *end;
+    const double val = std::strtod(str.c_str(), &end);
+    if (str.empty() || *end != '\0') {
+      throw std::runtime_error("Invalid number in key distribution `" + spec +
+                               "`\n");
+    }
+    return val;
+  }
+
+  Type type_;
+  double theta_;
+  double hot_fraction_;
+  double hot_probability_;
+};
+
+#endif // _UNIVERSAL_DISTRIBUTION_HH
@@ -1,54 +1,271 @@
 #ifndef _UNIVERSAL_GEN_HH
 #define _UNIVERSAL_GEN_HH
 
+#include <algorithm>
 #include <bitset>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
+
+#include <pcg/pcg_random.hpp>
+
+/* Describes the lengths of generated strings. A length distribution is
+ * specified on the command line as one of
+ *
+ * fixed:<n>                    every string is <n> bytes
+ * uniform:<min>:<max>          lengths are uniform between <min> and <max>,
+ *                              inclusive
+ * lognormal:<median>:<sigma>   lengths are lognormally distributed around
+ *                              <median>, with shape <sigma>, which gives the
+ *                              long tail typical of real keys and values
+ *
+ * Lengths are capped at 1MiB. */
+
+class LengthDistribution {
+public:
+  enum Type {
+    FIXED,
+    UNIFORM,
+    LOGNORMAL,
+  };
+
+  static constexpr size_t MAX_LENGTH = 1UL << 20;
+
+  explicit LengthDistribution(size_t length = 0)
+      : type_(FIXED), min_(length), max_(length), sigma_(0) {}
+
+  // Parses a length distribution specification, throwing std::runtime_error
+  // if it is malformed
+  static LengthDistribution parse(const std::string &spec) {
+    std::vector<std::string> parts;
+    std::stringstream ss(spec);
+    std::string part;
+    while (std::getline(ss, part, ':')) {
+      parts.push_back(part);
+    }
+    LengthDistribution dist;
+    if (parts.size() == 2 && parts[0] == "fixed") {
+      dist.type_ = FIXED;
+      dist.min_ = dist.max_ = parse_length(parts[1], spec);
+    } else if (parts.size() == 3 && parts[0] == "uniform") {
+      dist.type_ = UNIFORM;
+      dist.min_ = parse_length(parts[1], spec);
+      dist.max_ = parse_length(parts[2], spec);
+      if (dist.min_ > dist.max_) {
+        throw std::runtime_error("Minimum length must not exceed the maximum "
+                                 "in `" +
+                                 spec + "`\n");
+      }
+    } else if (parts.size() == 3 && parts[0] == "lognormal") {
+      dist.type_ = LOGNORMAL;
+      dist.min_ = dist.max_ = parse_length(parts[1], spec);
+      char *end;
+      dist.sigma_ = std::strtod(parts[2].c_str(), &end);
+      if (parts[2].empty() || *end != '\0' || !(dist.sigma_ > 0.0) ||
+          dist.min_ == 0) {
+        throw std::runtime_error("Lognormal median and sigma must be positive "
+                                 "in `" +
+                                 spec + "`\n");
+      }
+    } else {
+      throw std::runtime_error("Invalid length distribution `" + spec + "`\n");
+    }
+    return dist;
+  }
+
+  Type type() const { return type_; }
+
+  // Draws a length from the distribution
+  template <typename RNG> size_t sample(RNG &rng) const {
+    switch (type_) {
+    case UNIFORM:
+      return std::uniform_int_distribution<size_t>(min_, max_)(rng);
+    case LOGNORMAL: {
+      const double length = std::lognormal_distribution<double>(
+          std::log(static_cast<double>(min_)), sigma_)(rng);
+      return std::min(static_cast<size_t>(std::llround(length)),
+                      static_cast<size_t>(MAX_LENGTH));
+    }
+    default:
+      return min_;
+    }
+  }
+
+private:
+  static size_t parse_length(const std::string &str, const std::string &spec) {
+    char *end;
+    const unsigned long long length = std::strtoull(str.c_str(), &end, 10);
+    if (str.empty() || *end != '\0' || length > MAX_LENGTH) {
+      throw std::runtime_error("Invalid length in `" + spec + "`\n");
+    }
+    return length;
+  }
+
+  Type type_;
+  // The fixed length, the bounds of a uniform distribution, or the median of
+  // a lognormal one
+  size_t min_;
+  size_t max_;
+  double sigma_;
+};
+
+/* Describes the shape of generated string keys: their length distribution,
+ * and a set of prefixes that they share. Each key is made of one of
+ * `prefix_count` prefixes of `prefix_length` bytes, then filler bytes, then
+ * the 8 bytes of the number it was generated from, so keys of the same length
+ * and prefix differ only in their last bytes, and comparing them has to scan
+ * the whole key. Since the number is always included, keys are never shorter
+ * than the prefix plus 8 bytes. The length and the prefix of a key are drawn
+ * from a generator seeded by its number, so the same number always gives the
+ * same key, which keeps recorded traces replayable. */
+
+struct StringKeyShape {
+  StringKeyShape() : enabled(false), prefix_count(1), prefix_length(0) {}
+
+  // Parses the `--key-length` and `--key-prefix` flags. Either may be empty,
+  // and if both are, keys keep their default shape.
+  static StringKeyShape parse(const std::string &length,
+                              const std::string &prefix) {
+    StringKeyShape shape;
+    shape.enabled = !length.empty() || !prefix.empty();
+    if (!length.empty()) {
+      shape.length = LengthDistribution::parse(length);
+    }
+    if (!prefix.empty()) {
+      const size_t colon = prefix.find(':');
+      char *count_end;
+      char *length_end;
+      shape.prefix_count = std::strtoull(prefix.c_str(), &count_end, 10);
+      shape.prefix_length =
+          colon == std::string::npos
+              ? 0
+              : std::strtoull(prefix.c_str() + colon + 1, &length_end, 10);
+      if (colon == std::string::npos || count_end != prefix.c_str() + colon ||
+          *length_end != '\0' || shape.prefix_count == 0 ||
+          shape.prefix_length > LengthDistribution::MAX_LENGTH) {
+        throw std::runtime_error("Invalid key prefix `" + prefix + "`\n");
+      }
+    }
+    return shape;
+  }
+
+  std::string key(uint64_t num) const {
+    pcg32 rng(num);
+    const size_t key_length =
+        std::max(length.sample(rng), prefix_length + sizeof(num));
+    const size_t prefix =
+        std::uniform_int_distribution<size_t>(0, prefix_count - 1)(rng);
+    // Prefix `i` is `prefix_length` bytes ending in the digits of `i`
+    std::string key(key_length, '_');
+    const std::string digits = std::to_string(prefix);
+    std::fill(key.begin(), key.begin() + prefix_length, 'k');
+    if (digits.size() <= prefix_length) {
+      std::copy(digits.begin(), digits.end(),
+                key.begin() + prefix_length - digits.size());
+    }
+    std::memcpy(&key[key_length - sizeof(num)], &num, sizeof(num));
+    return key;
+  }
+
+  bool enabled;
+  LengthDistribution length;
+  size_t prefix_count;
+  size_t prefix_length;
+};
 
 /* A specialized functor for generating unique keys and values for various
  * types. Must define one for each type we want to use. These keys and values
- * are meant to be copied into the table (not moved). */
+ * are meant to be copied into the table (not moved). Values are generated
+ * from a number as well, so that types whose size varies can vary it, but
+ * they need not be unique. */
 
 template <typename T> class Gen {
+  // static std::string name() // the name used to select the type at run time
   // using storage_type = ...
   // static storage_type storage_key(uint64_t num)
-  // static storage_type storage_value()
+  // static storage_type storage_value(uint64_t num)
+  // static storage_type storage_value_of_size(uint64_t num, size_t bytes)
+  //     // a value of `bytes` bytes, for types whose size varies
   // static T get(storage_type&)
+  // static size_t size(const storage_type&) // the size of the data, in bytes
   // static constexpr size_t key_size
   // static constexpr size_t value_size
 };
 
 template <> class Gen<uint64_t> {
 public:
+  static std::string name() { return "uint64_t"; }
+
   using storage_type = uint64_t;
 
   static storage_type storage_key(uint64_t num) { return num; }
 
-  static storage_type storage_value() { return 0; }
+  static storage_type storage_value(uint64_t) { return 0; }
+
+  static storage_type storage_value_of_size(uint64_t num, size_t) {
+    return storage_value(num);
+  }
 
   static uint64_t get(const storage_type &st) { return st; }
 
+  static size_t size(const storage_type &) { return sizeof(uint64_t); }
+
   static constexpr size_t key_size = sizeof(uint64_t);
   static constexpr size_t value_size = sizeof(uint64_t);
 };
 
+/* By default, string keys are the 8 bytes of their number, and values are 100
+ * bytes. Both can be reshaped from the command line through `key_shape` and
+ * `value_length`, which must be set before any keys or values are generated.
+ * `key_size` and `value_size` always report the defaults. */
+
 template <> class Gen<std::string> {
   static constexpr size_t STRING_SIZE = 100;
 
 public:
+  static std::string name() { return "std::string"; }
+
   using storage_type = std::string;
 
+  static StringKeyShape &key_shape() {
+    static StringKeyShape shape;
+    return shape;
+  }
+
+  static LengthDistribution &value_length() {
+    static LengthDistribution length(STRING_SIZE);
+    return length;
+  }
+
   static storage_type storage_key(uint64_t num) {
+    if (key_shape().enabled) {
+      return key_shape().key(num);
+    }
     return std::string(
         static_cast<const char *>(static_cast<const void *>(&num)),
         sizeof(num));
   }
 
-  static storage_type storage_value() { return std::string(STRING_SIZE, '0'); }
+  static storage_type storage_value(uint64_t num) {
+    pcg32 rng(num);
+    return std::string(value_length().sample(rng), '0');
+  }
+
+  static storage_type storage_value_of_size(uint64_t, size_t bytes) {
+    return std::string(bytes, '0');
+  }
 
   static std::string get(const storage_type &st) { return st; }
 
+  static size_t size(const storage_type &st) { return st.size(); }
+
   static constexpr size_t key_size = sizeof(uint64_t);
   static constexpr size_t value_size = 100;
 };
@@ -58,16 +275,24 @@ using MediumBlob = std::bitset<2048>;
 
 template <> class Gen<MediumBlob> {
 public:
+  static std::string name() { return "MediumBlob"; }
+
   using storage_type = MediumBlob;
 
   static storage_type storage_key(uint64_t num) {
     return MediumBlob(Gen<uint64_t>::storage_key(num));
   }
 
-  static storage_type storage_value() { return MediumBlob(); }
+  static storage_type storage_value(uint64_t) { return MediumBlob(); }
+
+  static storage_type storage_value_of_size(uint64_t num, size_t) {
+    return storage_value(num);
+  }
 
   static MediumBlob get(const storage_type &st) { return st; }
 
+  static size_t size(const storage_type &) { return sizeof(MediumBlob); }
+
   static constexpr size_t key_size = sizeof(MediumBlob);
   static constexpr size_t value_size = sizeof(MediumBlob);
 };
@@ -77,34 +302,50 @@ using BigBlob = std::bitset<4096>;
 
 template <> class Gen<BigBlob> {
 public:
+  static std::string name() { return "BigBlob"; }
+
   using storage_type = BigBlob;
 
   static storage_type storage_key(uint64_t num) {
     return BigBlob(Gen<uint64_t>::storage_key(num));
   }
 
-  static storage_type storage_value() { return BigBlob(); }
+  static storage_type storage_value(uint64_t) { return BigBlob(); }
+
+  static storage_type storage_value_of_size(uint64_t num, size_t) {
+    return storage_value(num);
+  }
 
   static BigBlob get(const storage_type &st) { return st; }
 
+  static size_t size(const storage_type &) { return sizeof(BigBlob); }
+
   static constexpr size_t key_size = sizeof(BigBlob);
   static constexpr size_t value_size = sizeof(BigBlob);
 };
 
 template <typename T> class Gen<T *> {
 public:
+  static std::string name() { return Gen<T>::name() + "*"; }
+
   using storage_type = std::unique_ptr<T>;
 
   static storage_type storage_key(uint64_t num) {
     return storage_type(new T(Gen<T>::storage_key(num)));
   }
 
-  static storage_type storage_value() {
-    return storage_type(new T(Gen<T>::storage_value()));
+  static storage_type storage_value(uint64_t num) {
+    return storage_type(new T(Gen<T>::storage_value(num)));
+  }
+
+  static storage_type storage_value_of_size(uint64_t num, size_t bytes) {
+    return storage_type(new T(Gen<T>::storage_value_of_size(num, bytes)));
   }
 
   static T *get(const storage_type &st) { return st.get(); }
 
+  static size_t size(const storage_type &st) { return Gen<T>::size(*st); }
+
   static constexpr size_t key_size = Gen<T>::key_size;
   static constexpr size_t value_size = Gen<T>::value_size;
 };
@@ -0,0 +1,147 @@
+#ifndef _UNIVERSAL_LATENCY_HH
+#define _UNIVERSAL_LATENCY_HH
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* A log-linear histogram in the style of HdrHistogram. Values below
+ * 2^SUB_BUCKET_BITS are counted exactly. Above that, every power-of-two range
+ * is split into 2^(SUB_BUCKET_BITS - 1) equally-sized sub-buckets, so any
+ * recorded value is off by at most 1 / 2^(SUB_BUCKET_BITS - 1) of itself
+ * (about 1.6%). Recording is a handful of shifts and an increment, and
+ * histograms from different threads can be merged by adding their counts. */
+
+class Histogram {
+public:
+  Histogram() : counts_(NUM_BUCKETS, 0), total_count_(0), max_(0) {}
+
+  void record(uint64_t value) {
+    ++counts_[bucket_index(value)];
+    ++total_count_;
+    if (value > max_) {
+      max_ = value;
+    }
+  }
+
+  void merge(const Histogram &other) {
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_count_ += other.total_count_;
+    if (other.max_ > max_) {
+      max_ = other.max_;
+    }
+  }
+
+  uint64_t total_count() const { return total_count_; }
+
+  uint64_t max() const { return max_; }
+
+  // Returns the smallest value v such that at least `percentile` percent of
+  // the recorded values are <= v, up to the precision of the histogram.
+  uint64_t percentile(double percentile) const {
+    if (total_count_ == 0) {
+      return 0;
+    }
+    uint64_t rank =
+        static_cast<uint64_t>(percentile / 100.0 * total_count_ + 0.5);
+    if (rank == 0) {
+      rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        const uint64_t upper = bucket_upper_bound(i);
+        return upper < max_ ? upper : max_;
+      }
+    }
+    return max_;
+  }
+
+private:
+  static constexpr size_t SUB_BUCKET_BITS = 7;
+  static constexpr uint64_t SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+  static constexpr uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+  // One exact range, followed by one half-range for every remaining bit of a
+  // 64-bit value.
+  static constexpr size_t NUM_BUCKETS =
+      SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+
+  static size_t bucket_index(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+      return static_cast<size_t>(value);
+    }
+    size_t shift = 1;
+    while ((value >> shift) >= SUB_BUCKET_COUNT) {
+      ++shift;
+    }
+    return static_cast<size_t>(SUB_BUCKET_COUNT +
+                               (shift - 1) * SUB_BUCKET_HALF +
+                               ((value >> shift) - SUB_BUCKET_HALF));
+  }
+
+  static uint64_t bucket_upper_bound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+      return index;
+    }
+    const size_t offset = index - SUB_BUCKET_COUNT;
+    const size_t shift = offset / SUB_BUCKET_HALF + 1;
+    const uint64_t sub_bucket = offset % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+    return ((sub_bucket + 1) << shift) - 1;
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_count_;
+  uint64_t max_;
+};
+
+/* Records the latency of every `sample_period`-th operation a thread runs into
+ * one histogram per operation type. A sample period of 0 disables recording
+ * entirely, in which case no histograms are allocated. Each benchmark thread
+ * owns one recorder, and the recorders are merged once the threads finish. */
+
+class LatencyRecorder {
+public:
+  using clock = std::chrono::steady_clock;
+
+  LatencyRecorder(size_t num_op_types, size_t sample_period)
+      : sample_period_(sample_period), countdown_(sample_period),
+        histograms_(sample_period == 0 ? 0 : num_op_types) {}
+
+  bool enabled() const { return sample_period_ != 0; }
+
+  // Returns true if the upcoming operation should be timed
+  bool sample() {
+    if (sample_period_ == 0 || --countdown_ != 0) {
+      return false;
+    }
+    countdown_ = sample_period_;
+    return true;
+  }
+
+  void record(size_t op_type, clock::duration elapsed) {
+    histograms_[op_type].record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+            .count()));
+  }
+
+  void merge(const LatencyRecorder &other) {
+    for (size_t i = 0; i < histograms_.size(); ++i) {
+      histograms_[i].merge(other.histograms_[i]);
+    }
+  }
+
+  const Histogram &histogram(size_t op_type) const {
+    return histograms_[op_type];
+  }
+
+private:
+  const size_t sample_period_;
+  size_t countdown_;
+  std::vector<Histogram> histograms_;
+};
+
+#endif // _UNIVERSAL_LATENCY_HH
@@ -0,0 +1,314 @@
+#ifndef _UNIVERSAL_MEMORY_HH
+#define _UNIVERSAL_MEMORY_HH
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+
+/* Returns the number of bytes the process currently has allocated from the C
+ * library's heap, including large allocations served directly by mmap, or 0 if
+ * the C library doesn't provide this. Unlike the tracking allocator, this also
+ * counts memory that the table's elements allocate themselves (e.g. the
+ * contents of long strings), and it works with any table. */
+
+inline size_t heap_bytes_in_use() {
+#if defined(__GLIBC__) &&                                                      \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  const struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+  const struct mallinfo info = mallinfo();
+  return static_cast<unsigned int>(info.uordblks) +
+         static_cast<unsigned int>(info.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+// Reads a small file from /proc into `buf`, which is null-terminated, without
+// allocating, so that sampling doesn't disturb the heap measurements. Returns
+// false if the file couldn't be read.
+inline bool read_proc_file(const char *path, char *buf, size_t size) {
+#ifdef __linux__
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  size_t total = 0;
+  ssize_t n;
+  while (total + 1 < size &&
+         (n = read(fd, buf + total, size - 1 - total)) > 0) {
+    total += n;
+  }
+  close(fd);
+  buf[total] = '\0';
+  return total > 0;
+#else
+  (void)path;
+  (void)buf;
+  (void)size;
+  return false;
+#endif
+}
+
+/* Samples the memory use of the whole process on a timer thread: its resident
+ * set size, its minor and major page faults so far, the bytes in use on the C
+ * library's heap, the bytes allocated through the tracking allocator (if it is
+ * enabled), and the bytes of anonymous memory backed by transparent huge
+ * pages. Unlike the tracking allocator's samples, which are taken by the
+ * benchmark threads every so many operations, these are taken at regular
+ * intervals of time, so they also show page faults, huge pages, and memory
+ * that is freed late, such as the old bucket array kept until a lazy
+ * migration finishes.
+ *
+ * The first sample is taken when the sampler starts, and is the baseline the
+ * growth in memory is measured from. Sample storage is reserved up front, so
+ * the sampler doesn't allocate while running. Once it is full, every other
+ * sample is dropped and the interval is doubled, so long runs are covered at a
+ * coarser resolution. Peaks are tracked over every sample taken, including the
+ * dropped ones. The resident set size and huge pages are only available on
+ * Linux, and page faults only on Unix-like systems; elsewhere they read as 0.
+ *
+ * An interval of 0 disables the sampler. */
+
+class MemorySampler {
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct Sample {
+    // Time since the sampler started
+    long long elapsed_ns;
+    size_t rss_bytes;
+    size_t heap_bytes;
+    size_t tracked_bytes;
+    size_t anon_huge_bytes;
+    size_t minor_faults;
+    size_t major_faults;
+  };
+
+  MemorySampler(size_t interval_ms)
+      : interval_(interval_ms), done_(false), run_start_ns_(0) {
+    if (enabled()) {
+      samples_.reserve(kMaxSamples);
+    }
+  }
+
+  ~MemorySampler() { stop(); }
+
+  bool enabled() const { return interval_.count() != 0; }
+
+  // Takes the baseline sample and starts the timer thread. `tracked_fn`
+  // returns the bytes currently allocated through the tracking allocator, and
+  // is called from the timer thread.
+  template <typename TrackedFn> void start(TrackedFn tracked_fn) {
+    if (!enabled()) {
+      return;
+    }
+    start_time_ = clock::now();
+    add_sample(take_sample(tracked_fn));
+    done_.store(false, std::memory_order_release);
+    monitor_ = std::thread([this, tracked_fn]() {
+      clock::time_point next_time = start_time_ + interval_;
+      bool last_sample = false;
+      while (!last_sample) {
+        std::this_thread::sleep_until(next_time);
+        // Take one final sample after being stopped, so the memory in use at
+        // the end of the run is included
+        last_sample = done_.load(std::memory_order_acquire);
+        add_sample(take_sample(tracked_fn));
+        next_time += interval_;
+        const clock::time_point now = clock::now();
+        if (next_time <= now) {
+          next_time = now + interval_;
+        }
+      }
+    });
+  }
+
+  // Marks the end of the setup (e.g. generating keys and prefilling the
+  // table) and the start of the timed run
+  void mark_run_start() {
+    if (enabled()) {
+      run_start_ns_ = elapsed_ns(clock::now());
+    }
+  }
+
+  // Stops the timer thread, if it is running
+  void stop() {
+    if (monitor_.joinable()) {
+      done_.store(true, std::memory_order_release);
+      monitor_.join();
+    }
+  }
+
+  // The first and last samples, and the peak of each measure over all
+  // samples. Only valid once the sampler has been started and stopped.
+  const Sample &baseline() const { return samples_.front(); }
+  const Sample &last() const { return samples_.back(); }
+  const Sample &peak() const { return peak_; }
+
+  // The peak growth of a measure over the baseline, divided by `elements`
+  static double per_item(size_t peak, size_t baseline, size_t elements) {
+    return elements == 0 || peak < baseline
+               ? 0.0
+               : static_cast<double>(peak - baseline) / elements;
+  }
+
+  // Prints a summary of the samples to stderr, and returns them formatted as
+  // an entry of the JSON output. `elements` is the number of elements in the
+  // table at the end of the run, used to compute the memory used per item.
+  std::string report(size_t elements) const {
+    if (!enabled()) {
+      return std::string();
+    }
+    const double rss_per_item =
+        per_item(peak_.rss_bytes, baseline().rss_bytes, elements);
+    const double heap_per_item =
+        per_item(peak_.heap_bytes, baseline().heap_bytes, elements);
+    const size_t minor_faults =
+        last().minor_faults - baseline().minor_faults;
+    const size_t major_faults =
+        last().major_faults - baseline().major_faults;
+    std::cerr << "Memory: peak RSS " << peak_.rss_bytes << " bytes ("
+              << rss_per_item << " per item), peak heap " << peak_.heap_bytes
+              << " bytes (" << heap_per_item << " per item), " << minor_faults
+              << " minor and " << major_faults << " major faults, peak "
+              << peak_.anon_huge_bytes << " bytes in huge pages\n";
+    std::stringstream json;
+    json << ",\n        \"memory\": {"
+         << "\n            \"name\": \"Memory Timeline\","
+         << "\n            \"units\": \"bytes\","
+         << "\n            \"interval_ms\": " << final_interval_.count() << ","
+         << "\n            \"run_start_ms\": " << run_start_ns_ / 1e6 << ","
+         << "\n            \"elements\": " << elements << ","
+         << "\n            \"peak_rss\": " << peak_.rss_bytes << ","
+         << "\n            \"peak_heap\": " << peak_.heap_bytes << ","
+         << "\n            \"peak_tracked\": " << peak_.tracked_bytes << ","
+         << "\n            \"peak_anon_huge\": " << peak_.anon_huge_bytes
+         << ","
+         << "\n            \"rss_per_item\": " << rss_per_item << ","
+         << "\n            \"heap_per_item\": " << heap_per_item << ","
+         << "\n            \"minor_faults\": " << minor_faults << ","
+         << "\n            \"major_faults\": " << major_faults << ","
+         << "\n            \"value\": [";
+    const char *separator = "";
+    for (const Sample &sample : samples_) {
+      json << separator << "\n                {\"ms\": "
+           << sample.elapsed_ns / 1e6 << ", \"rss\": " << sample.rss_bytes
+           << ", \"heap\": " << sample.heap_bytes
+           << ", \"tracked\": " << sample.tracked_bytes
+           << ", \"anon_huge\": " << sample.anon_huge_bytes
+           << ", \"minor_faults\": " << sample.minor_faults
+           << ", \"major_faults\": " << sample.major_faults << "}";
+      separator = ",";
+    }
+    json << "\n            ]\n        }";
+    return json.str();
+  }
+
+private:
+  // Enough for 40 seconds of samples at the default interval before they are
+  // thinned out
+  static constexpr size_t kMaxSamples = 4096;
+
+  long long elapsed_ns(clock::time_point now) const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now -
+                                                                start_time_)
+        .count();
+  }
+
+  template <typename TrackedFn> Sample take_sample(TrackedFn &tracked_fn) {
+    Sample sample;
+    sample.elapsed_ns = elapsed_ns(clock::now());
+    sample.rss_bytes = 0;
+    sample.anon_huge_bytes = 0;
+    sample.minor_faults = 0;
+    sample.major_faults = 0;
+    char buf[4096];
+#ifdef __linux__
+    // The second field of statm is the resident set size, in pages
+    if (read_proc_file("/proc/self/statm", buf, sizeof(buf))) {
+      char *end;
+      std::strtoull(buf, &end, 10);
+      sample.rss_bytes = std::strtoull(end, nullptr, 10) *
+                         static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+    // smaps_rollup sums smaps over every mapping, in kilobytes
+    if (read_proc_file("/proc/self/smaps_rollup", buf, sizeof(buf))) {
+      const char *field = std::strstr(buf, "AnonHugePages:");
+      if (field != nullptr) {
+        sample.anon_huge_bytes =
+            std::strtoull(field + std::strlen("AnonHugePages:"), nullptr, 10) *
+            1024;
+      }
+    }
+#else
+    (void)buf;
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+      sample.minor_faults = usage.ru_minflt;
+      sample.major_faults = usage.ru_majflt;
+    }
+#endif
+    sample.heap_bytes = heap_bytes_in_use();
+    sample.tracked_bytes = tracked_fn();
+    return sample;
+  }
+
+  void add_sample(const Sample &sample) {
+    if (samples_.empty()) {
+      peak_ = sample;
+      final_interval_ = interval_;
+    }
+    peak_.rss_bytes = std::max(peak_.rss_bytes, sample.rss_bytes);
+    peak_.heap_bytes = std::max(peak_.heap_bytes, sample.heap_bytes);
+    peak_.tracked_bytes = std::max(peak_.tracked_bytes, sample.tracked_bytes);
+    peak_.anon_huge_bytes =
+        std::max(peak_.anon_huge_bytes, sample.anon_huge_bytes);
+    if (samples_.size() == kMaxSamples) {
+      // Keep the even-numbered samples, which include the baseline
+      for (size_t i = 0; i < kMaxSamples / 2; ++i) {
+        samples_[i] = samples_[2 * i];
+      }
+      samples_.resize(kMaxSamples / 2);
+      final_interval_ *= 2;
+    }
+    samples_.push_back(sample);
+  }
+
+  const std::chrono::milliseconds interval_;
+  // The interval between the samples that were kept, which grows as samples
+  // are thinned out
+  std::chrono::milliseconds final_interval_;
+  std::atomic<bool> done_;
+  std::thread monitor_;
+  clock::time_point start_time_;
+  long long run_start_ns_;
+  std::vector<Sample> samples_;
+  Sample peak_;
+};
+
+#endif // _UNIVERSAL_MEMORY_HH
@@ -1,7 +1,10 @@
-/* For each table to support, we define a wrapper class which holds the table
- * and implements all of the benchmarked operations. Below we list all the
- * methods each wrapper must implement.
+/* For each table to support, we define a wrapper class template, parameterized
+ * on the key type and the value type (and, for libcuckoo, the number of slots
+ * per bucket), which holds the table and implements all of the benchmarked
+ * operations. Below we list all the methods each wrapper must implement.
  *
+ * static const char *name() // the name used to select the table at run time
+ * static const char *type() // the type of the underlying table
  * constructor(size_t n) // n is the initial capacity
  * template <typename K, typename V>
  * bool read(const K& k, V& v) const
@@ -13,23 +16,21 @@
  * bool update(const K& k, const V& v)
  * template <typename K, typename V>
  * void upsert(const K& k, Updater fn, const V& v)
+ * size_t hashpower() const // must be safe to call concurrently with the above
+ * size_t size() const // the number of elements, only called between runs
  */
 
 #ifndef _UNIVERSAL_TABLE_WRAPPER_HH
 #define _UNIVERSAL_TABLE_WRAPPER_HH
 
+#include <array>
 #include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
 
-#ifndef KEY
-#error Must define KEY symbol as valid key type
-#endif
-
-#ifndef VALUE
-#error Must define VALUE symbol as valid value type
-#endif
-
 #ifdef TRACKING_ALLOCATOR
 std::atomic<size_t> universal_benchmark_current_bytes_allocated =
     ATOMIC_VAR_INIT(0);
@@ -121,6 +122,11 @@ private:
   std::vector<size_t> samples;
 };
 
+inline size_t tracked_bytes_allocated() {
+  return universal_benchmark_current_bytes_allocated.load(
+      std::memory_order_acquire);
+}
+
 #else
 template <template <typename> class WrappedAlloc, typename T>
 using Allocator = WrappedAlloc<T>;
@@ -135,16 +141,19 @@ private:
   std::vector<size_t> samples;
 };
 
+inline size_t tracked_bytes_allocated() { return 0; }
+
 #endif
 
-#ifdef LIBCUCKOO
-#define TABLE "LIBCUCKOO"
-#define TABLE_TYPE "cuckoohash_map"
 #include <libcuckoo/cuckoohash_map.hh>
 
-class Table {
+template <typename Key, typename Value, size_t SlotPerBucket>
+class LibcuckooTable {
 public:
-  Table(size_t n) : tbl(n) {}
+  static const char *name() { return "LIBCUCKOO"; }
+  static const char *type() { return "cuckoohash_map"; }
+
+  LibcuckooTable(size_t n) : tbl(n) {}
 
   template <typename K, typename V> bool read(const K &k, V &v) const {
     return tbl.find(k, v);
@@ -165,14 +174,336 @@ public:
     tbl.upsert(k, fn, v);
   }
 
+  size_t hashpower() const { return tbl.hashpower(); }
+
+  size_t size() const { return tbl.size(); }
+
 private:
-  libcuckoo::cuckoohash_map<KEY, VALUE, std::hash<KEY>, std::equal_to<KEY>,
-                 Allocator<std::allocator, std::pair<const KEY, VALUE>>>
+  libcuckoo::cuckoohash_map<
+      Key, Value, std::hash<Key>, std::equal_to<Key>,
+      Allocator<std::allocator, std::pair<const Key, Value>>, SlotPerBucket>
       tbl;
 };
 
-#else
-#error Must define LIBCUCKOO
-#endif
+/* A cuckoohash_map accessed entirely through a locked_table, which holds all
+ * of the table's locks for as long as the wrapper exists. No locks are taken
+ * per operation, so this measures the single-threaded performance of the
+ * table, and may only be used by one thread. */
+
+template <typename Key, typename Value> class LockedTable {
+public:
+  static const char *name() { return "LOCKED_TABLE"; }
+  static const char *type() { return "cuckoohash_map::locked_table"; }
+
+  LockedTable(size_t n) : tbl(n), lt(tbl.lock_table()) {}
+
+  template <typename K, typename V> bool read(const K &k, V &v) const {
+    const auto it = lt.find(k);
+    if (it == lt.end()) {
+      return false;
+    }
+    v = it->second;
+    return true;
+  }
+
+  template <typename K, typename V> bool insert(const K &k, const V &v) {
+    return lt.insert(k, v).second;
+  }
+
+  template <typename K> bool erase(const K &k) { return lt.erase(k) == 1; }
+
+  template <typename K, typename V> bool update(const K &k, const V &v) {
+    auto it = lt.find(k);
+    if (it == lt.end()) {
+      return false;
+    }
+    it->second = v;
+    return true;
+  }
+
+  template <typename K, typename Updater, typename V>
+  void upsert(const K &k, Updater fn, const V &v) {
+    auto res = lt.insert(k, v);
+    if (!res.second) {
+      fn(res.first->second);
+    }
+  }
+
+  size_t hashpower() const { return lt.hashpower(); }
+
+  size_t size() const { return lt.size(); }
+
+private:
+  using map_type = libcuckoo::cuckoohash_map<
+      Key, Value, std::hash<Key>, std::equal_to<Key>,
+      Allocator<std::allocator, std::pair<const Key, Value>>>;
+
+  map_type tbl;
+  typename map_type::locked_table lt;
+};
+
+/* The remaining wrappers are baselines built on std::unordered_map. They don't
+ * have a hashpower, so they always report 0, and the throughput timeline won't
+ * show their resizes. */
+
+template <typename Key, typename Value>
+using unordered_map_type =
+    std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>,
+                       Allocator<std::allocator, std::pair<const Key, Value>>>;
+
+// A std::unordered_map guarded by a single global mutex
+template <typename Key, typename Value> class UnorderedMapTable {
+public:
+  static const char *name() { return "UNORDERED_MAP"; }
+  static const char *type() { return "std::unordered_map"; }
+
+  UnorderedMapTable(size_t n) { tbl.reserve(n); }
+
+  template <typename K, typename V> bool read(const K &k, V &v) const {
+    std::lock_guard<std::mutex> guard(lock);
+    const auto it = tbl.find(k);
+    if (it == tbl.end()) {
+      return false;
+    }
+    v = it->second;
+    return true;
+  }
+
+  template <typename K, typename V> bool insert(const K &k, const V &v) {
+    std::lock_guard<std::mutex> guard(lock);
+    return tbl.emplace(k, v).second;
+  }
+
+  template <typename K> bool erase(const K &k) {
+    std::lock_guard<std::mutex> guard(lock);
+    return tbl.erase(k) == 1;
+  }
+
+  template <typename K, typename V> bool update(const K &k, const V &v) {
+    std::lock_guard<std::mutex> guard(lock);
+    const auto it = tbl.find(k);
+    if (it == tbl.end()) {
+      return false;
+    }
+    it->second = v;
+    return true;
+  }
+
+  template <typename K, typename Updater, typename V>
+  void upsert(const K &k, Updater fn, const V &v) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto res = tbl.emplace(k, v);
+    if (!res.second) {
+      fn(res.first->second);
+    }
+  }
+
+  size_t hashpower() const { return 0; }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return tbl.size();
+  }
+
+private:
+  mutable std::mutex lock;
+  unordered_map_type<Key, Value> tbl;
+};
+
+// A mutex on its own cache line, so that neighboring stripes or shards don't
+// falsely share
+struct alignas(64) PaddedMutex {
+  std::mutex m;
+};
+
+/* A single std::unordered_map guarded by an array of lock stripes. Reads and
+ * updates only touch an existing element, so they lock just the stripe their
+ * key hashes to, and can run concurrently with each other. Inserts and erases
+ * change the structure of the map, and may rehash it or relink the nodes of
+ * other keys, so they lock every stripe. */
+
+template <typename Key, typename Value> class StripedUnorderedMapTable {
+public:
+  static const char *name() { return "STRIPED_UNORDERED_MAP"; }
+  static const char *type() { return "std::unordered_map"; }
+
+  StripedUnorderedMapTable(size_t n) { tbl.reserve(n); }
+
+  template <typename K, typename V> bool read(const K &k, V &v) const {
+    std::lock_guard<std::mutex> guard(stripe(k));
+    const auto it = tbl.find(k);
+    if (it == tbl.end()) {
+      return false;
+    }
+    v = it->second;
+    return true;
+  }
+
+  template <typename K, typename V> bool insert(const K &k, const V &v) {
+    all_stripes_guard guard(locks);
+    return tbl.emplace(k, v).second;
+  }
+
+  template <typename K> bool erase(const K &k) {
+    all_stripes_guard guard(locks);
+    return tbl.erase(k) == 1;
+  }
+
+  template <typename K, typename V> bool update(const K &k, const V &v) {
+    std::lock_guard<std::mutex> guard(stripe(k));
+    const auto it = tbl.find(k);
+    if (it == tbl.end()) {
+      return false;
+    }
+    it->second = v;
+    return true;
+  }
+
+  template <typename K, typename Updater, typename V>
+  void upsert(const K &k, Updater fn, const V &v) {
+    {
+      std::lock_guard<std::mutex> guard(stripe(k));
+      const auto it = tbl.find(k);
+      if (it != tbl.end()) {
+        fn(it->second);
+        return;
+      }
+    }
+    // The key wasn't there, so we need to insert it, but another thread may
+    // have done so since we released the stripe
+    all_stripes_guard guard(locks);
+    auto res = tbl.emplace(k, v);
+    if (!res.second) {
+      fn(res.first->second);
+    }
+  }
+
+  size_t hashpower() const { return 0; }
+
+  // Inserts and erases hold every stripe, so holding any one of them keeps
+  // the size from changing
+  size_t size() const {
+    std::lock_guard<std::mutex> guard(locks[0].m);
+    return tbl.size();
+  }
+
+private:
+  static constexpr size_t kNumStripes = 64;
+  using locks_type = std::array<PaddedMutex, kNumStripes>;
+
+  // Locks every stripe in order, and unlocks them in reverse order
+  class all_stripes_guard {
+  public:
+    all_stripes_guard(locks_type &locks) : locks_(locks) {
+      for (PaddedMutex &lock : locks_) {
+        lock.m.lock();
+      }
+    }
+
+    ~all_stripes_guard() {
+      for (size_t i = kNumStripes; i > 0; --i) {
+        locks_[i - 1].m.unlock();
+      }
+    }
+
+  private:
+    locks_type &locks_;
+  };
+
+  template <typename K> std::mutex &stripe(const K &k) const {
+    return locks[std::hash<Key>()(k) % kNumStripes].m;
+  }
+
+  mutable locks_type locks;
+  unordered_map_type<Key, Value> tbl;
+};
+
+/* Splits the keys between a fixed number of independent std::unordered_maps,
+ * each guarded by its own mutex */
+
+template <typename Key, typename Value> class ShardedUnorderedMapTable {
+public:
+  static const char *name() { return "SHARDED_UNORDERED_MAP"; }
+  static const char *type() { return "std::unordered_map"; }
+
+  ShardedUnorderedMapTable(size_t n) {
+    for (shard_type &shard : shards) {
+      shard.tbl.reserve(n / kNumShards);
+    }
+  }
+
+  template <typename K, typename V> bool read(const K &k, V &v) const {
+    const shard_type &shard = get_shard(k);
+    std::lock_guard<std::mutex> guard(shard.lock.m);
+    const auto it = shard.tbl.find(k);
+    if (it == shard.tbl.end()) {
+      return false;
+    }
+    v = it->second;
+    return true;
+  }
+
+  template <typename K, typename V> bool insert(const K &k, const V &v) {
+    shard_type &shard = get_shard(k);
+    std::lock_guard<std::mutex> guard(shard.lock.m);
+    return shard.tbl.emplace(k, v).second;
+  }
+
+  template <typename K> bool erase(const K &k) {
+    shard_type &shard = get_shard(k);
+    std::lock_guard<std::mutex> guard(shard.lock.m);
+    return shard.tbl.erase(k) == 1;
+  }
+
+  template <typename K, typename V> bool update(const K &k, const V &v) {
+    shard_type &shard = get_shard(k);
+    std::lock_guard<std::mutex> guard(shard.lock.m);
+    const auto it = shard.tbl.find(k);
+    if (it == shard.tbl.end()) {
+      return false;
+    }
+    it->second = v;
+    return true;
+  }
+
+  template <typename K, typename Updater, typename V>
+  void upsert(const K &k, Updater fn, const V &v) {
+    shard_type &shard = get_shard(k);
+    std::lock_guard<std::mutex> guard(shard.lock.m);
+    auto res = shard.tbl.emplace(k, v);
+    if (!res.second) {
+      fn(res.first->second);
+    }
+  }
+
+  size_t hashpower() const { return 0; }
+
+  size_t size() const {
+    size_t total = 0;
+    for (const shard_type &shard : shards) {
+      std::lock_guard<std::mutex> guard(shard.lock.m);
+      total += shard.tbl.size();
+    }
+    return total;
+  }
+
+private:
+  static constexpr size_t kNumShards = 64;
+
+  struct shard_type {
+    mutable PaddedMutex lock;
+    unordered_map_type<Key, Value> tbl;
+  };
+
+  template <typename K> shard_type &get_shard(const K &k) {
+    return shards[std::hash<Key>()(k) % kNumShards];
+  }
+
+  template <typename K> const shard_type &get_shard(const K &k) const {
+    return shards[std::hash<Key>()(k) % kNumShards];
+  }
+
+  std::array<shard_type, kNumShards> shards;
+};
 
 #endif // _UNIVERSAL_TABLE_WRAPPER_HH
@@ -0,0 +1,261 @@
+#ifndef _UNIVERSAL_TIMELINE_HH
+#define _UNIVERSAL_TIMELINE_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Records how many operations each benchmark thread completes in every
+ * fixed-length interval of the run, along with the table's hashpower at the
+ * end of the interval. Benchmark threads publish their progress with a relaxed
+ * store to a counter on its own cache line, and a separate monitor thread
+ * wakes up once per interval to read all the counters and poll the hashpower.
+ * An interval in which the hashpower changed is marked as containing a resize,
+ * so stalls caused by a resize, and any slowdown during the lazy migration
+ * that follows it, line up with the resize on the timeline.
+ *
+ * Sample storage is reserved up front, so the monitor doesn't allocate while
+ * the run is timed. Once it is full, each pair of neighbouring intervals is
+ * merged into one and the interval is doubled, so long runs are covered at a
+ * coarser resolution.
+ *
+ * An interval of 0 disables the timeline, in which case no monitor thread is
+ * started and publishing progress costs a single store per call. */
+
+class Timeline {
+public:
+  using clock = std::chrono::steady_clock;
+
+  Timeline(size_t num_threads, size_t interval_ms)
+      : interval_(interval_ms), final_interval_(interval_ms),
+        progress_(num_threads), done_(false), last_ops_(num_threads, 0) {
+    if (enabled()) {
+      samples_.reserve(kMaxSamples);
+      sample_ops_.reserve(kMaxSamples * num_threads);
+    }
+  }
+
+  ~Timeline() { stop(); }
+
+  bool enabled() const { return interval_.count() != 0; }
+
+  // Called by benchmark thread `thread` to report that it has completed `ops`
+  // operations so far
+  void publish(size_t thread, size_t ops) {
+    progress_[thread].ops.store(ops, std::memory_order_relaxed);
+  }
+
+  // Starts the monitor thread. `hashpower_fn` is called from the monitor
+  // thread, concurrently with the benchmark threads, so it must be safe to
+  // call while the table is being modified.
+  template <typename HashpowerFn> void start(HashpowerFn hashpower_fn) {
+    if (!enabled()) {
+      return;
+    }
+    done_.store(false, std::memory_order_release);
+    monitor_ = std::thread([this, hashpower_fn]() {
+      const clock::time_point start_time = clock::now();
+      size_t last_hashpower = hashpower_fn();
+      clock::time_point last_time = start_time;
+      clock::time_point next_time = start_time + interval_;
+      bool last_sample = false;
+      while (!last_sample) {
+        std::this_thread::sleep_until(next_time);
+        // Take one final sample after being stopped, so the tail end of the
+        // run is included
+        last_sample = done_.load(std::memory_order_acquire);
+        Sample sample;
+        const clock::time_point now = clock::now();
+        // If we woke up late, skip the intervals we missed rather than
+        // taking a burst of tiny samples to catch up
+        next_time += final_interval_;
+        if (next_time <= now) {
+          next_time = now + final_interval_;
+        }
+        sample.end_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            now - start_time)
+                            .count();
+        sample.length_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now -
+                                                                 last_time)
+                .count();
+        last_time = now;
+        if (samples_.size() == kMaxSamples) {
+          halve_samples();
+        }
+        for (size_t i = 0; i < progress_.size(); ++i) {
+          const size_t ops =
+              progress_[i].ops.load(std::memory_order_relaxed);
+          sample_ops_.push_back(ops - last_ops_[i]);
+          last_ops_[i] = ops;
+        }
+        // The benchmark never shrinks the table, but while a resize is
+        // swapping in the new bucket array, the table can briefly report the
+        // hashpower of the array it is about to discard. If we see the
+        // hashpower go down, we caught a resize in progress, so we mark the
+        // interval as resizing and keep the previous hashpower.
+        const size_t hashpower = hashpower_fn();
+        sample.resize = hashpower != last_hashpower;
+        sample.hashpower = hashpower < last_hashpower ? last_hashpower
+                                                       : hashpower;
+        last_hashpower = sample.hashpower;
+        samples_.push_back(sample);
+      }
+    });
+  }
+
+  // Stops the monitor thread, if it is running
+  void stop() {
+    if (monitor_.joinable()) {
+      done_.store(true, std::memory_order_release);
+      monitor_.join();
+    }
+  }
+
+  // Writes the timeline as CSV, one row per interval, with the number of
+  // operations completed by each thread, the total throughput over the
+  // interval, the hashpower at the end of the interval, and whether a resize
+  // happened during the interval.
+  void write_csv(const std::string &path) const {
+    std::ofstream out(path.c_str());
+    if (!out) {
+      throw std::runtime_error("Could not open timeline file `" + path +
+                               "`\n");
+    }
+    out << "end_ms,length_ms";
+    for (size_t i = 0; i < progress_.size(); ++i) {
+      out << ",thread_" << i;
+    }
+    out << ",throughput,hashpower,resize\n";
+    for (size_t s = 0; s < samples_.size(); ++s) {
+      const Sample &sample = samples_[s];
+      out << sample.end_ns / 1e6 << "," << sample.length_ns / 1e6;
+      for (size_t i = 0; i < progress_.size(); ++i) {
+        out << "," << ops(s, i);
+      }
+      out << "," << throughput(s) << "," << sample.hashpower << ","
+          << (sample.resize ? 1 : 0) << "\n";
+    }
+  }
+
+  // Returns the timeline formatted as an entry of the JSON output
+  std::string json(size_t initial_hashpower) const {
+    // Resizes are listed separately as well, so they're easy to find
+    std::stringstream json;
+    json << ",\n        \"timeline\": {"
+         << "\n            \"name\": \"Throughput Timeline\","
+         << "\n            \"units\": \"count/seconds\","
+         << "\n            \"interval_ms\": " << final_interval_.count() << ","
+         << "\n            \"value\": [";
+    std::stringstream resizes;
+    const char *resize_separator = "";
+    size_t hashpower = initial_hashpower;
+    const char *separator = "";
+    for (size_t s = 0; s < samples_.size(); ++s) {
+      const Sample &sample = samples_[s];
+      json << separator << "\n                {\"end_ms\": "
+           << sample.end_ns / 1e6 << ", \"throughput\": " << throughput(s)
+           << ", \"hashpower\": " << sample.hashpower
+           << ", \"resize\": " << (sample.resize ? "true" : "false")
+           << ", \"thread_ops\": [";
+      for (size_t i = 0; i < progress_.size(); ++i) {
+        json << (i == 0 ? "" : ", ") << ops(s, i);
+      }
+      json << "]}";
+      separator = ",";
+      if (sample.resize) {
+        resizes << resize_separator << "\n                {\"end_ms\": "
+                << sample.end_ns / 1e6 << ", \"from\": " << hashpower
+                << ", \"to\": " << sample.hashpower << "}";
+        resize_separator = ",";
+      }
+      hashpower = sample.hashpower;
+    }
+    json << "\n            ],"
+         << "\n            \"resizes\": [" << resizes.str()
+         << "\n            ]\n        }";
+    return json.str();
+  }
+
+private:
+  // Enough for over two and a half minutes of samples at 10ms intervals
+  // before they are merged
+  static constexpr size_t kMaxSamples = 16384;
+
+  // Keep each thread's counter on its own cache line, so that publishing
+  // progress doesn't cause false sharing between benchmark threads
+  struct alignas(64) Progress {
+    Progress() : ops(0) {}
+    std::atomic<size_t> ops;
+  };
+
+  struct Sample {
+    // Time since the start of the run at the end of the interval, and the
+    // actual length of the interval, which may be longer than requested if
+    // the monitor thread woke up late
+    long long end_ns;
+    long long length_ns;
+    size_t hashpower;
+    bool resize;
+  };
+
+  // The operations completed by thread `thread` in sample `sample`
+  size_t ops(size_t sample, size_t thread) const {
+    return sample_ops_[sample * progress_.size() + thread];
+  }
+
+  double throughput(size_t sample) const {
+    size_t total = 0;
+    for (size_t i = 0; i < progress_.size(); ++i) {
+      total += ops(sample, i);
+    }
+    const long long length_ns = samples_[sample].length_ns;
+    return length_ns == 0 ? 0.0 : total * 1e9 / length_ns;
+  }
+
+  // Merges each pair of neighbouring samples into one covering both
+  // intervals, freeing half of the reserved storage
+  void halve_samples() {
+    const size_t n = progress_.size();
+    for (size_t s = 0; s < samples_.size() / 2; ++s) {
+      const Sample &first = samples_[2 * s];
+      const Sample &second = samples_[2 * s + 1];
+      Sample merged;
+      merged.end_ns = second.end_ns;
+      merged.length_ns = first.length_ns + second.length_ns;
+      merged.hashpower = second.hashpower;
+      merged.resize = first.resize || second.resize;
+      samples_[s] = merged;
+      for (size_t i = 0; i < n; ++i) {
+        sample_ops_[s * n + i] =
+            sample_ops_[2 * s * n + i] + sample_ops_[(2 * s + 1) * n + i];
+      }
+    }
+    samples_.resize(samples_.size() / 2);
+    sample_ops_.resize(samples_.size() * n);
+    final_interval_ *= 2;
+  }
+
+  const std::chrono::milliseconds interval_;
+  // The interval between the samples that were kept, which grows as samples
+  // are merged
+  std::chrono::milliseconds final_interval_;
+  std::vector<Progress> progress_;
+  std::atomic<bool> done_;
+  std::thread monitor_;
+  std::vector<Sample> samples_;
+  // The operations completed by each thread in each sample, one row of
+  // progress_.size() counts per sample
+  std::vector<size_t> sample_ops_;
+  // Each thread's count at the end of the last sample, only used by the
+  // monitor thread
+  std::vector<size_t> last_ops_;
+};
+
+#endif // _UNIVERSAL_TIMELINE_HH
@@ -0,0 +1,190 @@
+#ifndef _UNIVERSAL_TRACE_HH
+#define _UNIVERSAL_TRACE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* A compact binary format for traces of table operations. A trace file is a
+ * TraceHeader followed by `num_records` fixed-size TraceRecords, all in host
+ * byte order. Keys are stored as 64-bit numbers, either an application's key
+ * hash or the first 8 bytes of the key, which the benchmark turns into a key
+ * of the table's key type the same way it generates synthetic keys. Records
+ * are grouped by the thread that issued them, and each thread's records
+ * appear in the order that thread issued them. */
+
+struct TraceHeader {
+  static constexpr char MAGIC[8] = {'C', 'U', 'C', 'K', 'T', 'R', 'C', '1'};
+  static constexpr uint32_t VERSION = 1;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t num_records;
+};
+
+constexpr char TraceHeader::MAGIC[8];
+constexpr uint32_t TraceHeader::VERSION;
+
+struct TraceRecord {
+  // Set on operations that were issued to fill the table before the timed
+  // part of the workload. Replay runs them first, untimed.
+  static constexpr uint8_t PREFILL = 1;
+
+  // The operation, numbered as in the benchmark's `Ops` enum: read, insert,
+  // erase, update, upsert
+  uint8_t op;
+  uint8_t flags;
+  uint16_t thread;
+  // The size of the value written by the operation, or 0 if it doesn't write
+  // one. Replay writes values of this size if the table's value type varies
+  // in size, like std::string, and ignores it otherwise.
+  uint32_t value_size;
+  uint64_t key;
+};
+
+static_assert(sizeof(TraceHeader) == 24, "TraceHeader must be packed");
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord must be packed");
+
+/* Collects the records issued by one benchmark thread. A disabled recorder
+ * doesn't store anything, so recording costs only a branch. */
+
+class TraceRecorder {
+public:
+  TraceRecorder(bool enabled, uint16_t thread)
+      : enabled_(enabled), thread_(thread) {}
+
+  bool enabled() const { return enabled_; }
+
+  void reserve(size_t n) {
+    if (enabled_) {
+      records_.reserve(n);
+    }
+  }
+
+  void record(uint8_t op, uint64_t key, uint32_t value_size, uint8_t flags) {
+    if (enabled_) {
+      TraceRecord record;
+      record.op = op;
+      record.flags = flags;
+      record.thread = thread_;
+      record.value_size = value_size;
+      record.key = key;
+      records_.push_back(record);
+    }
+  }
+
+  const std::vector<TraceRecord> &records() const { return records_; }
+
+private:
+  bool enabled_;
+  uint16_t thread_;
+  std::vector<TraceRecord> records_;
+};
+
+// Writes the records of every recorder to a trace file, one thread after
+// another
+inline void write_trace(const std::string &path,
+                        const std::vector<TraceRecorder> &recorders) {
+  TraceHeader header;
+  std::memcpy(header.magic, TraceHeader::MAGIC, sizeof(header.magic));
+  header.version = TraceHeader::VERSION;
+  header.record_size = sizeof(TraceRecord);
+  header.num_records = 0;
+  for (const TraceRecorder &recorder : recorders) {
+    header.num_records += recorder.records().size();
+  }
+  FILE *out = std::fopen(path.c_str(), "wb");
+  if (out == nullptr) {
+    throw std::runtime_error("Could not open trace file `" + path + "`\n");
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+  for (const TraceRecorder &recorder : recorders) {
+    const std::vector<TraceRecord> &records = recorder.records();
+    ok = ok && std::fwrite(records.data(), sizeof(TraceRecord), records.size(),
+                           out) == records.size();
+  }
+  ok = std::fclose(out) == 0 && ok;
+  if (!ok) {
+    throw std::runtime_error("Could not write trace file `" + path + "`\n");
+  }
+}
+
+/* A read-only view of a trace file, which is memory-mapped rather than read
+ * into memory, so large traces can be replayed without copying them. */
+
+class TraceFile {
+public:
+  explicit TraceFile(const std::string &path)
+      : fd_(-1), map_(nullptr), map_size_(0), records_(nullptr),
+        num_records_(0) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      throw std::runtime_error("Could not open trace file `" + path + "`\n");
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+      close(fd_);
+      throw std::runtime_error("Could not stat trace file `" + path + "`\n");
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    if (map_size_ < sizeof(TraceHeader)) {
+      close(fd_);
+      throw std::runtime_error("Trace file `" + path + "` is too small\n");
+    }
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (map_ == MAP_FAILED) {
+      close(fd_);
+      throw std::runtime_error("Could not map trace file `" + path + "`\n");
+    }
+    TraceHeader header;
+    std::memcpy(&header, map_, sizeof(header));
+    if (std::memcmp(header.magic, TraceHeader::MAGIC, sizeof(header.magic)) !=
+            0 ||
+        header.version != TraceHeader::VERSION ||
+        header.record_size != sizeof(TraceRecord) ||
+        header.num_records >
+            (map_size_ - sizeof(TraceHeader)) / sizeof(TraceRecord)) {
+      munmap(map_, map_size_);
+      close(fd_);
+      throw std::runtime_error("Invalid trace file `" + path + "`\n");
+    }
+    // The records are only read sequentially, once per replay
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+    records_ = reinterpret_cast<const TraceRecord *>(
+        static_cast<const char *>(map_) + sizeof(TraceHeader));
+    num_records_ = header.num_records;
+  }
+
+  TraceFile(const TraceFile &) = delete;
+  TraceFile &operator=(const TraceFile &) = delete;
+
+  ~TraceFile() {
+    munmap(map_, map_size_);
+    close(fd_);
+  }
+
+  size_t size() const { return num_records_; }
+
+  const TraceRecord *begin() const { return records_; }
+
+  const TraceRecord *end() const { return records_ + num_records_; }
+
+private:
+  int fd_;
+  void *map_;
+  size_t map_size_;
+  const TraceRecord *records_;
+  size_t num_records_;
+};
+
+#endif // _UNIVERSAL_TRACE_HH